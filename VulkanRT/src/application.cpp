@@ -2,6 +2,16 @@
 #include "application.h"
 
 #include "commandPools.h"
+#include "cpuRayTracer.h"
+#include "deletionQueue.h"
+#include "imageCompare.h"
+#include "jobSystem.h"
+#include "latencyMonitor.h"
+#include "meshFile.h"
+#include "pipelineCache.h"
+#include "profiler.h"
+#include "scene.h"
+#include "vertexQuantization.h"
 
 #pragma warning(push, 0)
 #define GLFW_INCLUDE_VULKAN
@@ -14,33 +24,51 @@
 #include "glm/mat4x4.hpp"
 #pragma warning(pop)
 
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <stdexcept>
+#include <string>
+#include <thread>
 
 #define API_DUMP 0
 #define VERBOSE  0
 #define INFO     0
 
-#define PI 3.1415926535897932384f
-
-#define WIDTH  1280
-#define HEIGHT 720
-#define FOV    glm::radians(100.0f)
-#define NEAR   0.001f
+#define NEAR 0.001f
 
 #define ACCELERATION_FACTOR 300.0f
 
-#define STAGING_BUFFER_SIZE 67'108'864 // 64MB
+#define MAX_TOP_LEVEL_INSTANCES 1024
+
+#define PIPELINE_CACHE_FILE "pipeline.cache"
 
-#define MAX_FRAMES_IN_FLIGHT    2
 #define FRAMERATE_UPDATE_PERIOD 500'000 // 0.5 seconds
 
+#define MIN_DRAWS_PER_SLICE 256 // Fewer draws aren't worth a secondary command buffer and a job of their own
+
 #define INDEX_RAYGEN      0
 #define INDEX_CLOSEST_HIT 1
 #define INDEX_MISS        2
 
+static VkPresentModeKHR getVkPresentMode(const PresentMode presentMode) {
+    switch (presentMode) {
+    case PresentMode::Immediate:
+        return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    case PresentMode::Mailbox:
+        return VK_PRESENT_MODE_MAILBOX_KHR;
+    case PresentMode::FifoRelaxed:
+        return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    default:
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+}
+
+Application::Application(const Settings& settings) : m_settings(settings) {}
+
 Application::~Application() {
 
     vkDeviceWaitIdle(m_device);
@@ -53,45 +81,52 @@ Application::~Application() {
         vkDestroySemaphore(m_device, semaphore, nullptr);
     }
 
-    for (VkFence& fence : m_inFlightFences) {
-        vkDestroyFence(m_device, fence, nullptr);
-    }
-
-    for (size_t i = 0; i < m_swapchainImageCount; ++i) {
+    for (size_t i = 0; i < m_commandPools.size(); ++i) {
         vkFreeCommandBuffers(m_device, m_commandPools[i], 1, &m_commandBuffers[i]);
         vkDestroyCommandPool(m_device, m_commandPools[i], nullptr);
     }
 
-    vkDestroyCommandPool(m_device, m_transferCommandPool, nullptr);
+    m_threadCommandPools.reset();
 
-    vkDestroyBuffer(m_device, m_shaderBindingTableBuffer.buffer, nullptr);
-    vkFreeMemory(m_device, m_shaderBindingTableBuffer.memory, nullptr);
+    m_latencyMonitor.reset();
+    m_frameTimeline.reset();
 
-    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    m_gpuProfiler.reset();
 
-    vkDestroyPipeline(m_device, m_rayTracingPipeline, nullptr);
-    vkDestroyPipelineLayout(m_device, m_rayTracingPipelineLayout, nullptr);
+    m_uploader.reset();
 
-    vkDestroyBuffer(m_device, m_topLevelAccelerationStructure.instanceBuffer.buffer, nullptr);
-    vkFreeMemory(m_device, m_topLevelAccelerationStructure.instanceBuffer.memory, nullptr);
+    destroyBuffer(m_device, *m_memoryAllocator, m_shaderBindingTableBuffer);
 
-    vkDestroyAccelerationStructureKHR(m_device, m_topLevelAccelerationStructure.accelerationStructure, nullptr);
-    vkFreeMemory(m_device, m_topLevelAccelerationStructure.memory, nullptr);
+    for (VkDescriptorPool& descriptorPool : m_descriptorPools) {
+        vkDestroyDescriptorPool(m_device, descriptorPool, nullptr);
+    }
+
+    vkDestroyPipeline(m_device, m_rayTracingPipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_rayTracingPipelineLayout, nullptr);
 
-    vkDestroyAccelerationStructureKHR(m_device, m_bottomLevelAccelerationStructure.accelerationStructure, nullptr);
-    vkFreeMemory(m_device, m_bottomLevelAccelerationStructure.memory, nullptr);
+    destroyTopAccelerationStructure(m_device, *m_memoryAllocator, m_topLevelAccelerationStructure);
+    for (AccelerationStructure& bottomLevelAccelerationStructure : m_bottomLevelAccelerationStructures) {
+        destroyAccelerationStructure(m_device, *m_memoryAllocator, bottomLevelAccelerationStructure);
+    }
 
     vkDestroyPipeline(m_device, m_rasterPipeline, nullptr);
     vkDestroyPipelineLayout(m_device, m_rasterPipelineLayout, nullptr);
+
+    if (m_pipelineCache != VK_NULL_HANDLE) {
+        savePipelineCache(m_device, m_pipelineCache, PIPELINE_CACHE_FILE);
+    }
     vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
 
     vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
 
-    vkDestroyBuffer(m_device, m_indexBuffer.buffer, nullptr);
-    vkFreeMemory(m_device, m_indexBuffer.memory, nullptr);
+    for (Buffer& cameraBuffer : m_cameraBuffers) {
+        destroyBuffer(m_device, *m_memoryAllocator, cameraBuffer);
+    }
 
-    vkDestroyBuffer(m_device, m_vertexBuffer.buffer, nullptr);
-    vkFreeMemory(m_device, m_vertexBuffer.memory, nullptr);
+    destroyBuffer(m_device, *m_memoryAllocator, m_meshInfoBuffer);
+    destroyBuffer(m_device, *m_memoryAllocator, m_normalBuffer);
+    destroyBuffer(m_device, *m_memoryAllocator, m_indexBuffer);
+    destroyBuffer(m_device, *m_memoryAllocator, m_vertexBuffer);
 
     for (VkFramebuffer& framebuffer : m_framebuffers) {
         vkDestroyFramebuffer(m_device, framebuffer, nullptr);
@@ -99,11 +134,19 @@ Application::~Application() {
 
     vkDestroyImageView(m_device, m_depthImageView, nullptr);
     vkDestroyImage(m_device, m_depthImage, nullptr);
-    vkFreeMemory(m_device, m_depthImageMemory, nullptr);
+    m_memoryAllocator->deallocate(m_depthImageAllocation);
 
     vkDestroyRenderPass(m_device, m_renderPass, nullptr);
 
+    for (size_t i = 0; i < m_offscreenImages.size(); ++i) {
+        vkDestroyImageView(m_device, m_offscreenImageViews[i], nullptr);
+        vkDestroyImage(m_device, m_offscreenImages[i], nullptr);
+        m_memoryAllocator->deallocate(m_offscreenImageAllocations[i]);
+    }
+
+    m_deletionQueue.reset();
     m_swapchain.reset();
+    m_memoryAllocator.reset();
 
     vkDestroyDevice(m_device, nullptr);
 
@@ -118,6 +161,44 @@ Application::~Application() {
     glfwTerminate();
 }
 
+struct SceneImportJob {
+    const Settings*        settings  = nullptr;
+    JobSystem*             jobSystem = nullptr; // The parallel phases of the import run as jobs next to it
+    std::unique_ptr<Scene> scene;
+    std::string            shaderVariant;
+};
+
+// Variants are suffixed with the defines they're built with, see the shader build commands in the project
+static void importScene(void* data) {
+    SceneImportJob& job = *static_cast<SceneImportJob*>(data);
+
+    job.scene         = std::make_unique<Scene>(*job.jobSystem, job.settings->meshFile, job.settings->splitMeshes);
+    job.shaderVariant = std::string(job.settings->quantizeVertices ? "Quantized" : "") + (job.scene->usesUint32Indices() ? "Uint32" : "");
+}
+
+struct ShaderLoadJob {
+    const Application* application  = nullptr;
+    const char*        name         = nullptr;
+    const std::string* variant      = nullptr; // Suffix picked by the scene import, only set for shaders with variants
+    VkShaderModule     shaderModule = VK_NULL_HANDLE;
+};
+
+struct PipelineJob {
+    const Application* application = nullptr;
+    ShaderLoadJob*     shaders     = nullptr; // Vertex and fragment, or raygen, closest hit and miss, destroyed once the pipeline is created
+    VkPipeline         pipeline    = VK_NULL_HANDLE;
+
+    std::chrono::high_resolution_clock::time_point finishTime;
+};
+
+struct RasterSliceJob {
+    const Application* application   = nullptr;
+    uint32_t           frameIndex    = 0;
+    uint32_t           firstMesh     = 0;
+    uint32_t           lastMesh      = 0; // Exclusive
+    VkCommandBuffer    commandBuffer = VK_NULL_HANDLE;
+};
+
 void key_callback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/) {
     Application* application = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
     KeyState&    keyState    = application->m_keyStates[key];
@@ -132,26 +213,36 @@ void key_callback(GLFWwindow* window, int key, int /*scancode*/, int action, int
 }
 
 void Application::run() {
-    if (!glfwInit()) {
-        throw std::runtime_error("Failed to initialize GLFW!");
-    }
+    m_jobSystem = std::make_unique<JobSystem>(std::max(1u, std::thread::hardware_concurrency()));
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    window = glfwCreateWindow(WIDTH, HEIGHT, "VulkanRT", NULL, NULL);
-    if (!window) {
-        throw std::runtime_error("Failed to create GLFW window!");
-    }
+    // The import only needs the CPU, so it runs while the window, the device and the render targets are created
+    SceneImportJob sceneImportJob = {&m_settings, m_jobSystem.get()};
 
-    glfwSetWindowUserPointer(window, this);
+    JobCounter importCounter;
+    m_jobSystem->run(importScene, &sceneImportJob, importCounter);
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    if (!glfwRawMouseMotionSupported()) {
-        throw std::runtime_error("Raw mouse motion not supported!");
-    }
+    if (!m_settings.headless) {
+        if (!glfwInit()) {
+            throw std::runtime_error("Failed to initialize GLFW!");
+        }
 
-    glfwSetKeyCallback(window, key_callback);
-    glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
-    glfwSetCursorPos(window, 0, 0);
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        window = glfwCreateWindow(static_cast<int>(m_settings.width), static_cast<int>(m_settings.height), "VulkanRT", NULL, NULL);
+        if (!window) {
+            throw std::runtime_error("Failed to create GLFW window!");
+        }
+
+        glfwSetWindowUserPointer(window, this);
+
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        if (!glfwRawMouseMotionSupported()) {
+            throw std::runtime_error("Raw mouse motion not supported!");
+        }
+
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+        glfwSetCursorPos(window, 0, 0);
+    }
 
     VK_CHECK(volkInitialize());
 
@@ -184,36 +275,96 @@ void Application::run() {
     VK_CHECK(vkCreateDebugUtilsMessengerEXT(m_instance, &debugUtilsMessengerCreateInfo, nullptr, &m_debugUtilsMessenger));
 #endif
 
-    VK_CHECK(glfwCreateWindowSurface(m_instance, window, nullptr, &m_surface));
+    if (!m_settings.headless) {
+        VK_CHECK(glfwCreateWindowSurface(m_instance, window, nullptr, &m_surface));
+    }
 
-    m_physicalDevice = pickPhysicalDevice();
+    m_physicalDevice       = pickPhysicalDevice();
+    m_rayTracingSupported  = rayTracingSupported(m_physicalDevice);
+    m_presentWaitSupported = !m_settings.headless && presentWaitSupported(m_physicalDevice);
 
     VkPhysicalDeviceRayTracingPropertiesKHR physicalDeviceRayTracingProperties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PROPERTIES_KHR};
     VkPhysicalDeviceProperties2             physicalDeviceProperties2          = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
-    physicalDeviceProperties2.pNext                                            = &physicalDeviceRayTracingProperties;
+    if (m_rayTracingSupported) {
+        physicalDeviceProperties2.pNext = &physicalDeviceRayTracingProperties;
+    }
     vkGetPhysicalDeviceProperties2(m_physicalDevice, &physicalDeviceProperties2);
 
     VkPhysicalDeviceProperties physicalDeviceProperties = physicalDeviceProperties2.properties;
 
     printf("Selected GPU: %s\n", physicalDeviceProperties.deviceName);
+    if (!m_rayTracingSupported) {
+        printf("Ray tracing not supported, falling back to rasterization\n");
+    }
 
-    m_queueFamilyIndex = getGraphicsQueueFamilyIndex(m_physicalDevice);
+    if (!m_settings.headless && !m_presentWaitSupported) {
+        printf("Present wait not supported, latency is measured up to the GPU finishing frames%s\n",
+               m_settings.justInTimeInput ? " and input is sampled right away" : "");
+    }
 
-    const float             queuePriorities       = 1.0f;
-    VkDeviceQueueCreateInfo deviceQueueCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
-    deviceQueueCreateInfo.queueCount              = 1;
-    deviceQueueCreateInfo.queueFamilyIndex        = m_queueFamilyIndex;
-    deviceQueueCreateInfo.pQueuePriorities        = &queuePriorities;
+    m_graphicsQueueFamilyIndex = getGraphicsQueueFamilyIndex(m_physicalDevice);
 
-    std::array<const char*, 4> deviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_RAY_TRACING_EXTENSION_NAME,
-        VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME, // Required for VK_KHR_ray_tracing
-        VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME          // Required for VK_KHR_ray_tracing
-    };
+    // Families without graphics let uploads and acceleration structure builds run next to rendering, fall back to the graphics family otherwise
+    m_computeQueueFamilyIndex  = getDedicatedQueueFamilyIndex(m_physicalDevice, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+    m_transferQueueFamilyIndex = getDedicatedQueueFamilyIndex(m_physicalDevice, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+
+    if (m_computeQueueFamilyIndex == UINT32_MAX) {
+        m_computeQueueFamilyIndex = m_graphicsQueueFamilyIndex;
+    }
+
+    if (m_transferQueueFamilyIndex == UINT32_MAX) {
+        m_transferQueueFamilyIndex = m_computeQueueFamilyIndex;
+    }
+
+    m_queueFamilyIndices = {m_graphicsQueueFamilyIndex};
+    for (uint32_t queueFamilyIndex : {m_computeQueueFamilyIndex, m_transferQueueFamilyIndex}) {
+        if (std::find(m_queueFamilyIndices.begin(), m_queueFamilyIndices.end(), queueFamilyIndex) == m_queueFamilyIndices.end()) {
+            m_queueFamilyIndices.push_back(queueFamilyIndex);
+        }
+    }
+
+    printf("Queue families: graphics %u, compute %u, transfer %u\n", m_graphicsQueueFamilyIndex, m_computeQueueFamilyIndex, m_transferQueueFamilyIndex);
+
+    uint32_t queueFamilyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, 0);
+
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    VkPhysicalDeviceFeatures physicalDeviceFeatures;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &physicalDeviceFeatures);
+
+    const float                          queuePriorities = 1.0f;
+    std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfos;
+    for (uint32_t queueFamilyIndex : m_queueFamilyIndices) {
+        VkDeviceQueueCreateInfo deviceQueueCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+        deviceQueueCreateInfo.queueCount              = 1;
+        deviceQueueCreateInfo.queueFamilyIndex        = queueFamilyIndex;
+        deviceQueueCreateInfo.pQueuePriorities        = &queuePriorities;
+        deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);
+    }
+
+    std::vector<const char*> deviceExtensions;
+    if (!m_settings.headless) {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    if (m_rayTracingSupported) {
+        deviceExtensions.push_back(VK_KHR_RAY_TRACING_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME); // Required for VK_KHR_ray_tracing
+        deviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);         // Required for VK_KHR_ray_tracing
+    }
+
+#ifdef VK_KHR_present_wait
+    if (m_presentWaitSupported) {
+        deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+#endif
 
     VkDeviceCreateInfo deviceCreateInfo      = {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
-    deviceCreateInfo.queueCreateInfoCount    = 1;
-    deviceCreateInfo.pQueueCreateInfos       = &deviceQueueCreateInfo;
+    deviceCreateInfo.queueCreateInfoCount    = static_cast<uint32_t>(deviceQueueCreateInfos.size());
+    deviceCreateInfo.pQueueCreateInfos       = deviceQueueCreateInfos.data();
     deviceCreateInfo.enabledExtensionCount   = static_cast<uint32_t>(deviceExtensions.size());
     deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -223,197 +374,391 @@ void Application::run() {
     VkPhysicalDeviceVulkan12Features physicalDeviceVulkan12Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
     physicalDeviceVulkan12Features.scalarBlockLayout                = VK_TRUE;
     physicalDeviceVulkan12Features.bufferDeviceAddress              = VK_TRUE;
-    physicalDeviceVulkan12Features.pNext                            = &physicalDeviceRayTracingFeatures;
-
-    VkPhysicalDeviceFeatures2 physicalDeviceFeatures2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
-    physicalDeviceFeatures2.pNext                     = &physicalDeviceVulkan12Features;
+    physicalDeviceVulkan12Features.timelineSemaphore                = VK_TRUE; // Uploads are waited on from other queues
+    physicalDeviceVulkan12Features.pNext                            = m_rayTracingSupported ? &physicalDeviceRayTracingFeatures : nullptr;
+
+    // Index buffers are read as uint16_t from storage buffers in the shaders
+    VkPhysicalDeviceVulkan11Features physicalDeviceVulkan11Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
+    physicalDeviceVulkan11Features.storageBuffer16BitAccess         = VK_TRUE;
+    physicalDeviceVulkan11Features.pNext                            = &physicalDeviceVulkan12Features;
+
+    // Optional, only the GPU profiler uses them. Raster passes are recorded into secondary command buffers, which have to inherit the statistics query.
+    const VkBool32 pipelineStatisticsSupported = physicalDeviceFeatures.pipelineStatisticsQuery && physicalDeviceFeatures.inheritedQueries;
+
+    VkPhysicalDeviceFeatures2 physicalDeviceFeatures2        = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    physicalDeviceFeatures2.features.pipelineStatisticsQuery = pipelineStatisticsSupported;
+    physicalDeviceFeatures2.features.inheritedQueries        = pipelineStatisticsSupported;
+    physicalDeviceFeatures2.pNext                            = &physicalDeviceVulkan11Features;
+
+#ifdef VK_KHR_present_wait
+    // Presents are tagged with the frame timeline value, so the latency monitor can wait for them
+    VkPhysicalDevicePresentWaitFeaturesKHR physicalDevicePresentWaitFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR};
+    physicalDevicePresentWaitFeatures.presentWait                            = VK_TRUE;
+
+    VkPhysicalDevicePresentIdFeaturesKHR physicalDevicePresentIdFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR};
+    physicalDevicePresentIdFeatures.presentId                            = VK_TRUE;
+    physicalDevicePresentIdFeatures.pNext                                = &physicalDevicePresentWaitFeatures;
+
+    if (m_presentWaitSupported) {
+        physicalDevicePresentWaitFeatures.pNext = physicalDeviceFeatures2.pNext;
+        physicalDeviceFeatures2.pNext           = &physicalDevicePresentIdFeatures;
+    }
+#endif
 
     deviceCreateInfo.pNext = &physicalDeviceFeatures2;
 
+    ProfileZone createDeviceZone("vkCreateDevice");
     VK_CHECK(vkCreateDevice(m_physicalDevice, &deviceCreateInfo, nullptr, &m_device));
+    createDeviceZone.end();
 
     volkLoadDevice(m_device);
 
     VkQueue queue = 0;
-    vkGetDeviceQueue(m_device, m_queueFamilyIndex, 0, &queue);
+    vkGetDeviceQueue(m_device, m_graphicsQueueFamilyIndex, 0, &queue);
 
-    VkSurfaceFormatKHR surfaceFormat = {};
-    surfaceFormat.format             = VK_FORMAT_B8G8R8A8_UNORM;
-    surfaceFormat.colorSpace         = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
+    VkQueue computeQueue = 0;
+    vkGetDeviceQueue(m_device, m_computeQueueFamilyIndex, 0, &computeQueue);
 
-    m_swapchain           = std::make_unique<Swapchain>(window, m_surface, m_physicalDevice, m_device, m_queueFamilyIndex, surfaceFormat);
-    m_surfaceExtent       = m_swapchain->getSurfaceExtent();
-    m_swapchainImageCount = m_swapchain->getImageCounts();
+    VkQueue transferQueue = 0;
+    vkGetDeviceQueue(m_device, m_transferQueueFamilyIndex, 0, &transferQueue);
 
-    m_physicalDeviceMemoryProperties;
     vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_physicalDeviceMemoryProperties);
+    m_memoryAllocator = std::make_unique<MemoryAllocator>(m_device, m_physicalDeviceMemoryProperties, physicalDeviceProperties.limits);
+    m_uploader        = std::make_unique<Uploader>(m_device, *m_memoryAllocator, transferQueue, m_transferQueueFamilyIndex);
+
+    if (m_settings.headless) {
+        m_colorFormat            = VK_FORMAT_R8G8B8A8_UNORM;
+        m_targetImageFinalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        m_surfaceExtent          = {m_settings.width, m_settings.height};
+        m_renderTargetCount      = m_settings.framesInFlight;
+    } else {
+        VkSurfaceFormatKHR surfaceFormat = {};
+        surfaceFormat.format             = VK_FORMAT_B8G8R8A8_UNORM;
+        surfaceFormat.colorSpace         = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
+
+        PROFILE_ZONE("createSwapchain");
+
+        m_swapchain              = std::make_unique<Swapchain>(window, m_surface, m_physicalDevice, m_device, m_graphicsQueueFamilyIndex, surfaceFormat,
+                                                  getVkPresentMode(m_settings.presentMode), m_settings.swapchainImageCount);
+        m_colorFormat            = surfaceFormat.format;
+        m_targetImageFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        m_surfaceExtent          = m_swapchain->getSurfaceExtent();
+        m_renderTargetCount      = m_swapchain->getImageCounts();
+    }
+
+    m_gpuProfiler = std::make_unique<GpuProfiler>(m_device, m_renderTargetCount, physicalDeviceProperties.limits.timestampPeriod,
+                                                  queueFamilies[m_graphicsQueueFamilyIndex].timestampValidBits,
+                                                  pipelineStatisticsSupported == VK_TRUE);
+
+    if (isProfilingEnabled()) {
+        m_gpuProfiler->calibrate(queue, m_graphicsQueueFamilyIndex);
+    }
 
-    m_depthImage = createImage(m_device, m_surfaceExtent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_FORMAT_D32_SFLOAT_S8_UINT);
-    VkMemoryRequirements depthImageMemoryRequirements;
-    vkGetImageMemoryRequirements(m_device, m_depthImage, &depthImageMemoryRequirements);
-    m_depthImageMemory =
-        allocateVulkanObjectMemory(m_device, depthImageMemoryRequirements, m_physicalDeviceMemoryProperties, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (m_settings.headless) {
+        createOffscreenImages();
+    }
 
-    vkBindImageMemory(m_device, m_depthImage, m_depthImageMemory, 0);
+    m_depthImage           = createImage(m_device, m_surfaceExtent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_FORMAT_D32_SFLOAT_S8_UINT);
+    m_depthImageAllocation = allocateImageMemory(m_device, *m_memoryAllocator, m_depthImage);
 
     m_depthImageView = createImageView(m_device, m_depthImage, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_IMAGE_ASPECT_DEPTH_BIT);
 
     m_renderPass   = createRenderPass();
     m_framebuffers = createFramebuffers();
 
-    Buffer stagingBuffer =
-        createBuffer(m_device, STAGING_BUFFER_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, m_physicalDeviceMemoryProperties, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-    m_transferCommandPool = createCommandPool(m_device, m_queueFamilyIndex);
-
-    // clang-format off
-    std::vector<float> cubeVertices = {
-            0.5, -0.5, -0.5,
-            0.5, -0.5, 0.5,
-            -0.5, -0.5, 0.5,
-            -0.5, -0.5, -0.5,
-            0.5, 0.5, -0.5,
-            0.5, 0.5, 0.5,
-            -0.5, 0.5, 0.5,
-            -0.5, 0.5, -0.5
-    };
-    // clang-format on
-
-    VkBufferUsageFlags bufferUsageFlags =
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR;
-
-    uint32_t vertexBufferSize = sizeof(float) * static_cast<uint32_t>(cubeVertices.size());
-    m_vertexBuffer = createBuffer(m_device, vertexBufferSize, bufferUsageFlags, m_physicalDeviceMemoryProperties, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                  VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
-
-    uploadToDeviceLocalBuffer(m_device, cubeVertices, stagingBuffer.buffer, stagingBuffer.memory, m_vertexBuffer.buffer, m_transferCommandPool, queue);
-
-    // clang-format off
-    std::vector<uint16_t> cubeIndices = {
-            0, 1, 3, 3, 1, 2,
-            1, 5, 2, 2, 5, 6,
-            5, 4, 6, 6, 4, 7,
-            4, 0, 7, 7, 0, 3,
-            3, 2, 7, 7, 2, 6,
-            4, 5, 0, 0, 5, 1
-    };
-    // clang-format on
-
-    uint32_t indexBufferSize = sizeof(uint16_t) * static_cast<uint32_t>(cubeIndices.size());
-    m_indexBuffer            = createBuffer(m_device, indexBufferSize, bufferUsageFlags, m_physicalDeviceMemoryProperties, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                 VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
-
-    uploadToDeviceLocalBuffer(m_device, cubeIndices, stagingBuffer.buffer, stagingBuffer.memory, m_indexBuffer.buffer, m_transferCommandPool, queue);
+    bool pipelineCacheLoaded = false;
+    m_pipelineCache          = createPipelineCache(m_device, physicalDeviceProperties, PIPELINE_CACHE_FILE, pipelineCacheLoaded);
 
-    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
-    pipelineCacheCreateInfo.initialDataSize           = 0;
-    VK_CHECK(vkCreatePipelineCache(m_device, &pipelineCacheCreateInfo, nullptr, &m_pipelineCache));
-
-    std::array<VkDescriptorSetLayoutBinding, 4> descriptorSetLayoutBindings;
-    descriptorSetLayoutBindings.fill({});
+    std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindings(m_rayTracingSupported ? 7 : 5, VkDescriptorSetLayoutBinding{});
+    const size_t                              meshInfoBindingIndex = descriptorSetLayoutBindings.size() - 3;
+    const size_t                              normalBindingIndex   = descriptorSetLayoutBindings.size() - 2;
 
     // Vertex buffer
     descriptorSetLayoutBindings[0].binding         = 0;
     descriptorSetLayoutBindings[0].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     descriptorSetLayoutBindings[0].descriptorCount = 1;
-    descriptorSetLayoutBindings[0].stageFlags      = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+    descriptorSetLayoutBindings[0].stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
 
     // Index buffer
     descriptorSetLayoutBindings[1].binding         = 1;
     descriptorSetLayoutBindings[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     descriptorSetLayoutBindings[1].descriptorCount = 1;
-    descriptorSetLayoutBindings[1].stageFlags      = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-
-    // Acceleration structure
-    descriptorSetLayoutBindings[2].binding         = 2;
-    descriptorSetLayoutBindings[2].descriptorType  = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
-    descriptorSetLayoutBindings[2].descriptorCount = 1;
-    descriptorSetLayoutBindings[2].stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
-
-    // Ray tracing image
-    descriptorSetLayoutBindings[3].binding         = 3;
-    descriptorSetLayoutBindings[3].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    descriptorSetLayoutBindings[3].descriptorCount = 1;
-    descriptorSetLayoutBindings[3].stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    descriptorSetLayoutBindings[1].stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
+
+    // Mesh table, it, the normal buffer and the camera come after the ray tracing bindings so raster only layouts stay dense
+    descriptorSetLayoutBindings[meshInfoBindingIndex].binding         = 4;
+    descriptorSetLayoutBindings[meshInfoBindingIndex].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorSetLayoutBindings[meshInfoBindingIndex].descriptorCount = 1;
+    descriptorSetLayoutBindings[meshInfoBindingIndex].stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
+
+    // Normal buffer
+    descriptorSetLayoutBindings[normalBindingIndex].binding         = 5;
+    descriptorSetLayoutBindings[normalBindingIndex].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorSetLayoutBindings[normalBindingIndex].descriptorCount = 1;
+    descriptorSetLayoutBindings[normalBindingIndex].stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
+
+    // Camera
+    descriptorSetLayoutBindings.back().binding         = 6;
+    descriptorSetLayoutBindings.back().descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorSetLayoutBindings.back().descriptorCount = 1;
+    descriptorSetLayoutBindings.back().stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
+
+    if (m_rayTracingSupported) {
+        descriptorSetLayoutBindings[0].stageFlags |= VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+        descriptorSetLayoutBindings[1].stageFlags |= VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+        descriptorSetLayoutBindings[meshInfoBindingIndex].stageFlags |= VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+        descriptorSetLayoutBindings[normalBindingIndex].stageFlags |= VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+        descriptorSetLayoutBindings.back().stageFlags |= VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+
+        // Acceleration structure
+        descriptorSetLayoutBindings[2].binding         = 2;
+        descriptorSetLayoutBindings[2].descriptorType  = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        descriptorSetLayoutBindings[2].descriptorCount = 1;
+        descriptorSetLayoutBindings[2].stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+
+        // Ray tracing image
+        descriptorSetLayoutBindings[3].binding         = 3;
+        descriptorSetLayoutBindings[3].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorSetLayoutBindings[3].descriptorCount = 1;
+        descriptorSetLayoutBindings[3].stageFlags      = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    }
 
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
     descriptorSetLayoutCreateInfo.bindingCount                    = static_cast<uint32_t>(descriptorSetLayoutBindings.size());
     descriptorSetLayoutCreateInfo.pBindings                       = descriptorSetLayoutBindings.data();
     VK_CHECK(vkCreateDescriptorSetLayout(m_device, &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout));
 
-    VkPushConstantRange rasterPushConstantRange = {};
-    rasterPushConstantRange.offset              = 0;
-    rasterPushConstantRange.size                = sizeof(RasterPushData);
-    rasterPushConstantRange.stageFlags          = VK_SHADER_STAGE_VERTEX_BIT;
-
     VkPipelineLayoutCreateInfo rasterPipelineLayoutCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-    rasterPipelineLayoutCreateInfo.pushConstantRangeCount     = 1;
-    rasterPipelineLayoutCreateInfo.pPushConstantRanges        = &rasterPushConstantRange;
     rasterPipelineLayoutCreateInfo.setLayoutCount             = 1;
     rasterPipelineLayoutCreateInfo.pSetLayouts                = &m_descriptorSetLayout;
     VK_CHECK(vkCreatePipelineLayout(m_device, &rasterPipelineLayoutCreateInfo, nullptr, &m_rasterPipelineLayout));
 
-    VkShaderModule vertexShader   = loadShader("src/shaders/spirv/vertexShader.spv");
-    VkShaderModule fragmentShader = loadShader("src/shaders/spirv/fragmentShader.spv");
+    if (m_rayTracingSupported) {
+        VkPipelineLayoutCreateInfo rayTracePipelineLayoutCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        rayTracePipelineLayoutCreateInfo.setLayoutCount             = 1;
+        rayTracePipelineLayoutCreateInfo.pSetLayouts                = &m_descriptorSetLayout;
+        VK_CHECK(vkCreatePipelineLayout(m_device, &rayTracePipelineLayoutCreateInfo, nullptr, &m_rayTracingPipelineLayout));
+    }
 
-    m_rasterPipeline = createRasterPipeline(vertexShader, fragmentShader);
+    // Shader loads and pipeline compiles run on the job system while the geometry is uploaded and the acceleration structures are built.
+    // Shaders with variants wait for the import, which picks the variant, and pipelines wait for their shaders.
+    std::array<ShaderLoadJob, 2> rasterShaderJobs     = {{{this, "vertexShader", &sceneImportJob.shaderVariant}, {this, "fragmentShader"}}};
+    std::array<ShaderLoadJob, 3> rayTracingShaderJobs = {
+        {{this, "raygenShader"}, {this, "closestHitShader", &sceneImportJob.shaderVariant}, {this, "missShader"}}};
 
-    vkDestroyShaderModule(m_device, fragmentShader, nullptr);
-    vkDestroyShaderModule(m_device, vertexShader, nullptr);
+    PipelineJob rasterPipelineJob     = {this, rasterShaderJobs.data()};
+    PipelineJob rayTracingPipelineJob = {this, rayTracingShaderJobs.data()};
 
-    m_bottomLevelAccelerationStructure = createBottomAccelerationStructure(
-        m_device, static_cast<uint32_t>(cubeVertices.size() / 3), static_cast<uint32_t>(cubeIndices.size() / 3), m_vertexBuffer.deviceAddress,
-        m_indexBuffer.deviceAddress, m_physicalDeviceMemoryProperties, queue, m_queueFamilyIndex);
+    JobCounter rasterShaderCounter;
+    JobCounter rayTracingShaderCounter;
+    JobCounter pipelineCounter;
 
-    m_topLevelAccelerationStructure =
-        createTopAccelerationStructure(m_device, m_bottomLevelAccelerationStructure, m_physicalDeviceMemoryProperties, queue, m_queueFamilyIndex);
+    // The pipelines compile in parallel and wait on their shaders, so only the wall clock time until the last one finishes means anything
+    const std::chrono::high_resolution_clock::time_point pipelineStartTime = std::chrono::high_resolution_clock::now();
 
-    VkPushConstantRange rayTracePushConstantRange = {};
-    rayTracePushConstantRange.offset              = 0;
-    rayTracePushConstantRange.size                = sizeof(RayTracingPushData);
-    rayTracePushConstantRange.stageFlags          = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    for (ShaderLoadJob& shaderJob : rasterShaderJobs) {
+        m_jobSystem->run(loadShaderJob, &shaderJob, rasterShaderCounter, shaderJob.variant ? &importCounter : nullptr);
+    }
+    m_jobSystem->run(createRasterPipelineJob, &rasterPipelineJob, pipelineCounter, &rasterShaderCounter);
 
-    VkPipelineLayoutCreateInfo rayTracePipelineLayoutCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-    rayTracePipelineLayoutCreateInfo.pushConstantRangeCount     = 1;
-    rayTracePipelineLayoutCreateInfo.pPushConstantRanges        = &rayTracePushConstantRange;
-    rayTracePipelineLayoutCreateInfo.setLayoutCount             = 1;
-    rayTracePipelineLayoutCreateInfo.pSetLayouts                = &m_descriptorSetLayout;
-    VK_CHECK(vkCreatePipelineLayout(m_device, &rayTracePipelineLayoutCreateInfo, nullptr, &m_rayTracingPipelineLayout));
+    if (m_rayTracingSupported) {
+        for (ShaderLoadJob& shaderJob : rayTracingShaderJobs) {
+            m_jobSystem->run(loadShaderJob, &shaderJob, rayTracingShaderCounter, shaderJob.variant ? &importCounter : nullptr);
+        }
+        m_jobSystem->run(createRayTracingPipelineJob, &rayTracingPipelineJob, pipelineCounter, &rayTracingShaderCounter);
+    }
 
-    VkShaderModule raygenShader     = loadShader("src/shaders/spirv/raygenShader.spv");
-    VkShaderModule closestHitShader = loadShader("src/shaders/spirv/closestHitShader.spv");
-    VkShaderModule missShader       = loadShader("src/shaders/spirv/missShader.spv");
+    m_jobSystem->wait(importCounter);
 
-    m_rayTracingPipeline = createRayTracingPipeline(raygenShader, closestHitShader, missShader);
+    // Kept mapped until the uploads are flushed, the uploader copies straight out of the mapping into its staging ring
+    std::unique_ptr<Scene>&      scene     = sceneImportJob.scene;
+    const std::vector<MeshView>& meshViews = scene->getMeshViews();
 
-    vkDestroyShaderModule(m_device, missShader, nullptr);
-    vkDestroyShaderModule(m_device, closestHitShader, nullptr);
-    vkDestroyShaderModule(m_device, raygenShader, nullptr);
+    // Every mesh goes into one shared vertex and one shared index buffer, indexed through the mesh table.
+    // A single shader variant reads all of them, so 16 bit meshes are widened whenever another mesh needs 32 bit indices.
+    const bool uint32Indices = scene->usesUint32Indices();
+    uint64_t   vertexCount   = 0;
+    uint64_t   indexCount    = 0;
+    for (const MeshView& meshView : meshViews) {
+        vertexCount += meshView.entry->vertexCount;
+        indexCount += meshView.entry->indexCount;
+    }
 
-    // clang-format off
-    std::array<VkDescriptorPoolSize, 3> descriptorPoolSizes = {{
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2},
-        {VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1},
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1}
-    }};
-    // clang-format on
+    if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX) {
+        throw std::runtime_error("Mesh file " + m_settings.meshFile + " is too large to render!");
+    }
 
-    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-    descriptorPoolCreateInfo.poolSizeCount              = static_cast<uint32_t>(descriptorPoolSizes.size());
-    descriptorPoolCreateInfo.pPoolSizes                 = descriptorPoolSizes.data();
-    descriptorPoolCreateInfo.maxSets                    = m_swapchainImageCount;
-    VK_CHECK(vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool));
+    const VkIndexType  indexType = uint32Indices ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+    const VkDeviceSize indexSize = uint32Indices ? sizeof(uint32_t) : sizeof(uint16_t);
 
-    // Allocating one descriptor set for each swapchain image, all with the same layout
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts(m_swapchainImageCount, m_descriptorSetLayout);
+    printf("Loaded %zu meshes: %llu vertices, %llu triangles, %s bit indices\n", meshViews.size(), static_cast<unsigned long long>(vertexCount),
+           static_cast<unsigned long long>(indexCount / 3), uint32Indices ? "32" : "16");
 
-    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    descriptorSetAllocateInfo.descriptorPool              = m_descriptorPool;
-    descriptorSetAllocateInfo.descriptorSetCount          = m_swapchainImageCount;
-    descriptorSetAllocateInfo.pSetLayouts                 = descriptorSetLayouts.data();
+    // Quantized meshes get 16 bit SNORM positions, which bottom level builds read as R16G16B16A16_SNORM, and octahedral normals
+    const bool         quantizeVertices = m_settings.quantizeVertices;
+    const VkFormat     vertexFormat     = quantizeVertices ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+    const VkDeviceSize vertexStride     = quantizeVertices ? QUANTIZED_POSITION_STRIDE : MESH_VERTEX_STRIDE;
+    const VkDeviceSize normalStride     = quantizeVertices ? QUANTIZED_NORMAL_STRIDE : MESH_NORMAL_STRIDE;
+
+    // The entries have to outlive the mapping
+    std::vector<MeshFileEntry> meshEntries(meshViews.size());
+    m_meshInfos = std::vector<MeshInfo>(meshViews.size());
+
+    uint32_t firstVertex = 0;
+    uint32_t firstIndex  = 0;
+    for (size_t i = 0; i < meshViews.size(); ++i) {
+        meshEntries[i]             = *meshViews[i].entry;
+        m_meshInfos[i].firstVertex = firstVertex;
+        m_meshInfos[i].firstIndex  = firstIndex;
+        m_meshInfos[i].indexCount  = meshEntries[i].indexCount;
+
+        // Identity dequantization, replaced with the mesh's own when it's quantized
+        m_meshInfos[i].positionScale  = glm::vec3(1.0f);
+        m_meshInfos[i].positionOffset = glm::vec3(0.0f);
 
-    m_descriptorSets = std::vector<VkDescriptorSet>(m_swapchainImageCount);
-    vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, m_descriptorSets.data());
+        firstVertex += meshEntries[i].vertexCount;
+        firstIndex += meshEntries[i].indexCount;
+    }
+
+    VkBufferUsageFlags bufferUsageFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    if (m_rayTracingSupported) {
+        bufferUsageFlags |= VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR;
+    }
+
+    // Geometry is written by the transfer queue and read by both the compute and the graphics queue, so it's shared instead of transferred
+    VkDeviceSize vertexBufferSize = vertexCount * vertexStride;
+    m_vertexBuffer =
+        createBuffer(m_device, *m_memoryAllocator, vertexBufferSize, bufferUsageFlags, MemoryUsage::DeviceAddressBuffer, m_queueFamilyIndices);
+
+    VkDeviceSize indexBufferSize = indexCount * indexSize;
+    m_indexBuffer =
+        createBuffer(m_device, *m_memoryAllocator, indexBufferSize, bufferUsageFlags, MemoryUsage::DeviceAddressBuffer, m_queueFamilyIndices);
+
+    VkDeviceSize meshInfoBufferSize = sizeof(MeshInfo) * m_meshInfos.size();
+    m_meshInfoBuffer =
+        createBuffer(m_device, *m_memoryAllocator, meshInfoBufferSize, bufferUsageFlags, MemoryUsage::DeviceAddressBuffer, m_queueFamilyIndices);
+
+    // Only normals are uploaded, UVs and tangents stay in the mesh file until a shader samples textures
+    VkDeviceSize normalBufferSize = vertexCount * normalStride;
+    m_normalBuffer =
+        createBuffer(m_device, *m_memoryAllocator, normalBufferSize, bufferUsageFlags, MemoryUsage::DeviceAddressBuffer, m_queueFamilyIndices);
+
+    QuantizationError     quantizationError = {};
+    std::vector<uint32_t> widenedIndices;
+    for (size_t i = 0; i < meshViews.size(); ++i) {
+        const MeshView& meshView = meshViews[i];
+
+        // The uploader copies into its staging ring right away, so every quantized mesh is freed before the next one is built
+        if (quantizeVertices) {
+            QuantizedMesh quantizedMesh = quantizeMesh(meshView, quantizationError);
+            m_uploader->upload(quantizedMesh.positions, m_vertexBuffer.buffer, m_meshInfos[i].firstVertex * vertexStride);
+            m_uploader->upload(quantizedMesh.normals, m_normalBuffer.buffer, m_meshInfos[i].firstVertex * normalStride);
+
+            m_meshInfos[i].positionScale  = glm::vec3(quantizedMesh.positionScale[0], quantizedMesh.positionScale[1], quantizedMesh.positionScale[2]);
+            m_meshInfos[i].positionOffset = glm::vec3(quantizedMesh.positionOffset[0], quantizedMesh.positionOffset[1], quantizedMesh.positionOffset[2]);
+        } else {
+            const VkDeviceSize normalSize = meshView.entry->vertexCount * normalStride;
+            m_uploader->upload(meshView.vertices, meshView.vertexSize, m_vertexBuffer.buffer, m_meshInfos[i].firstVertex * vertexStride);
+            m_uploader->upload(meshView.normals, normalSize, m_normalBuffer.buffer, m_meshInfos[i].firstVertex * normalStride);
+        }
+
+        if (uint32Indices && meshView.entry->indexType == MESH_INDEX_TYPE_UINT16) {
+            const uint16_t* indices = reinterpret_cast<const uint16_t*>(meshView.indices);
+            widenedIndices.assign(indices, indices + meshView.entry->indexCount);
+            m_uploader->upload(widenedIndices, m_indexBuffer.buffer, m_meshInfos[i].firstIndex * indexSize);
+        } else {
+            m_uploader->upload(meshView.indices, meshView.indexSize, m_indexBuffer.buffer, m_meshInfos[i].firstIndex * indexSize);
+        }
+    }
+
+    m_uploader->upload(m_meshInfos, m_meshInfoBuffer.buffer);
+
+    if (quantizeVertices) {
+        printQuantizationReport(quantizationError);
+    }
+
+    // Acceleration structure builds wait on the uploader timeline before reading the geometry
+    m_uploader->flush();
+
+    // Validation traces its CPU reference straight from the scene's meshes, everything else is done with them once they're uploaded
+    if (!m_settings.validate) {
+        scene.reset();
+    }
+
+    VkStridedBufferRegionKHR raygenStridedBufferRegion     = {};
+    VkStridedBufferRegionKHR closestHitStridedBufferRegion = {};
+    VkStridedBufferRegionKHR missStridedBufferRegion       = {};
+    VkStridedBufferRegionKHR callableStridedBufferRegion   = {};
+
+    if (m_rayTracingSupported) {
+        std::vector<BottomLevelGeometry> meshGeometries(meshEntries.size());
+        for (size_t i = 0; i < meshEntries.size(); ++i) {
+            const MeshFileEntry& meshEntry    = meshEntries[i];
+            BottomLevelGeometry& meshGeometry = meshGeometries[i];
+
+            meshGeometry.vertexCount         = meshEntry.vertexCount;
+            meshGeometry.primitiveCount      = meshEntry.indexCount / 3;
+            meshGeometry.vertexBufferAddress = m_vertexBuffer.deviceAddress + m_meshInfos[i].firstVertex * vertexStride;
+            meshGeometry.indexBufferAddress  = m_indexBuffer.deviceAddress + m_meshInfos[i].firstIndex * indexSize;
+            meshGeometry.vertexFormat        = vertexFormat;
+            meshGeometry.vertexStride        = vertexStride;
+            meshGeometry.indexType           = indexType;
+
+            // Fast build wins over fast trace when a mesh asks for both
+            if (meshEntry.buildHints & MESH_BUILD_PREFER_FAST_BUILD) {
+                meshGeometry.buildFlags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR;
+            } else if (meshEntry.buildHints & MESH_BUILD_PREFER_FAST_TRACE) {
+                meshGeometry.buildFlags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+            } else {
+                meshGeometry.buildFlags = 0;
+            }
+
+            if (meshEntry.buildHints & MESH_BUILD_LOW_MEMORY) {
+                meshGeometry.buildFlags |= VK_BUILD_ACCELERATION_STRUCTURE_LOW_MEMORY_BIT_KHR;
+            }
+        }
+
+        m_bottomLevelAccelerationStructures = createBottomAccelerationStructures(m_device, meshGeometries, m_settings.compactAccelerationStructures,
+                                                                                 *m_memoryAllocator, *m_uploader, computeQueue, m_computeQueueFamilyIndex);
+
+        if (m_settings.compactAccelerationStructures) {
+            compactBottomAccelerationStructures(m_device, m_bottomLevelAccelerationStructures, *m_memoryAllocator, computeQueue, m_computeQueueFamilyIndex);
+        }
+
+        // One instance per mesh, the closest hit shader finds the mesh through the custom index. Built by the first ray traced frame.
+        m_topLevelInstances = std::vector<TopLevelInstance>(meshEntries.size());
+        for (uint32_t i = 0; i < static_cast<uint32_t>(m_topLevelInstances.size()); ++i) {
+            m_topLevelInstances[i].bottomLevelIndex = i;
+            m_topLevelInstances[i].customIndex      = i;
+        }
+
+        // Writes the dequantization of every mesh into its instance transform
+        animateTopLevelInstances(0.0f);
+
+        const uint32_t maxTopLevelInstances = std::max<uint32_t>(MAX_TOP_LEVEL_INSTANCES, static_cast<uint32_t>(m_topLevelInstances.size()));
+
+        m_topLevelInstancesChanged      = true;
+        m_topLevelAccelerationStructure = createTopAccelerationStructure(m_device, maxTopLevelInstances, m_renderTargetCount, *m_memoryAllocator);
+    }
+
+    m_jobSystem->wait(pipelineCounter);
+
+    m_rasterPipeline     = rasterPipelineJob.pipeline;
+    m_rayTracingPipeline = rayTracingPipelineJob.pipeline;
+
+    const std::chrono::high_resolution_clock::time_point pipelineFinishTime =
+        m_rayTracingSupported ? std::max(rasterPipelineJob.finishTime, rayTracingPipelineJob.finishTime) : rasterPipelineJob.finishTime;
+
+    printf("Pipeline cache %s, shaders loaded and pipelines created in %.2fms\n", pipelineCacheLoaded ? "hit" : "miss",
+           std::chrono::duration<float, std::milli>(pipelineFinishTime - pipelineStartTime).count());
+
+    // Written before every submission of their render target, so command buffers never have to carry camera data
+    m_cameraBuffers = std::vector<Buffer>(m_renderTargetCount);
+    for (Buffer& cameraBuffer : m_cameraBuffers) {
+        cameraBuffer = createBuffer(m_device, *m_memoryAllocator, sizeof(CameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, MemoryUsage::Staging);
+    }
+
+    allocateDescriptorSets(m_renderTargetCount);
 
     std::array<VkDescriptorBufferInfo, 2> descriptorBufferInfos;
     descriptorBufferInfos[0].buffer = m_vertexBuffer.buffer;
@@ -424,14 +769,30 @@ void Application::run() {
     descriptorBufferInfos[1].offset = 0;
     descriptorBufferInfos[1].range  = indexBufferSize;
 
+    VkDescriptorBufferInfo meshInfoDescriptorBufferInfo = {};
+    meshInfoDescriptorBufferInfo.buffer                 = m_meshInfoBuffer.buffer;
+    meshInfoDescriptorBufferInfo.offset                 = 0;
+    meshInfoDescriptorBufferInfo.range                  = meshInfoBufferSize;
+
+    VkDescriptorBufferInfo normalDescriptorBufferInfo = {};
+    normalDescriptorBufferInfo.buffer                 = m_normalBuffer.buffer;
+    normalDescriptorBufferInfo.offset                 = 0;
+    normalDescriptorBufferInfo.range                  = normalBufferSize;
+
+    VkDescriptorBufferInfo cameraDescriptorBufferInfo = {};
+    cameraDescriptorBufferInfo.offset                 = 0;
+    cameraDescriptorBufferInfo.range                  = sizeof(CameraData);
+
+    const VkAccelerationStructureKHR topLevelAccelerationStructure = m_topLevelAccelerationStructure.accelerationStructure.accelerationStructure;
+
     VkWriteDescriptorSetAccelerationStructureKHR writeDescriptorSetAccelerationStructure = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR};
     writeDescriptorSetAccelerationStructure.accelerationStructureCount                   = 1;
-    writeDescriptorSetAccelerationStructure.pAccelerationStructures                      = &m_topLevelAccelerationStructure.accelerationStructure;
+    writeDescriptorSetAccelerationStructure.pAccelerationStructures                      = &topLevelAccelerationStructure;
 
-    VkDescriptorImageInfo descriptorSwapchainImageInfo = {};
-    descriptorSwapchainImageInfo.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
+    VkDescriptorImageInfo descriptorTargetImageInfo = {};
+    descriptorTargetImageInfo.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
 
-    std::array<VkWriteDescriptorSet, 3> writeDescriptorSets;
+    std::array<VkWriteDescriptorSet, 6> writeDescriptorSets;
     writeDescriptorSets.fill({VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET});
 
     writeDescriptorSets[0].dstBinding      = 0; // 0 for vertex and 1 for index buffer
@@ -440,132 +801,177 @@ void Application::run() {
     writeDescriptorSets[0].descriptorCount = static_cast<uint32_t>(descriptorBufferInfos.size());
     writeDescriptorSets[0].pBufferInfo     = descriptorBufferInfos.data();
 
-    writeDescriptorSets[1].dstBinding      = 2;
+    writeDescriptorSets[1].dstBinding      = 4;
     writeDescriptorSets[1].dstArrayElement = 0;
-    writeDescriptorSets[1].descriptorType  = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+    writeDescriptorSets[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     writeDescriptorSets[1].descriptorCount = 1;
-    writeDescriptorSets[1].pNext           = &writeDescriptorSetAccelerationStructure;
+    writeDescriptorSets[1].pBufferInfo     = &meshInfoDescriptorBufferInfo;
 
-    writeDescriptorSets[2].dstBinding      = 3;
+    writeDescriptorSets[2].dstBinding      = 5;
     writeDescriptorSets[2].dstArrayElement = 0;
-    writeDescriptorSets[2].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writeDescriptorSets[2].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     writeDescriptorSets[2].descriptorCount = 1;
-    writeDescriptorSets[2].pImageInfo      = &descriptorSwapchainImageInfo;
-
-    const std::vector<VkImageView>& swapchainImageViews = m_swapchain->getImageViews();
-    for (size_t i = 0; i < m_swapchainImageCount; ++i) {
-        descriptorSwapchainImageInfo.imageView = swapchainImageViews[i];
-
-        writeDescriptorSets[0].dstSet = m_descriptorSets[i];
-        writeDescriptorSets[1].dstSet = m_descriptorSets[i];
-        writeDescriptorSets[2].dstSet = m_descriptorSets[i];
+    writeDescriptorSets[2].pBufferInfo     = &normalDescriptorBufferInfo;
+
+    writeDescriptorSets[3].dstBinding      = 6;
+    writeDescriptorSets[3].dstArrayElement = 0;
+    writeDescriptorSets[3].descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    writeDescriptorSets[3].descriptorCount = 1;
+    writeDescriptorSets[3].pBufferInfo     = &cameraDescriptorBufferInfo;
+
+    writeDescriptorSets[4].dstBinding      = 2;
+    writeDescriptorSets[4].dstArrayElement = 0;
+    writeDescriptorSets[4].descriptorType  = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+    writeDescriptorSets[4].descriptorCount = 1;
+    writeDescriptorSets[4].pNext           = &writeDescriptorSetAccelerationStructure;
+
+    writeDescriptorSets[5].dstBinding      = 3;
+    writeDescriptorSets[5].dstArrayElement = 0;
+    writeDescriptorSets[5].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writeDescriptorSets[5].descriptorCount = 1;
+    writeDescriptorSets[5].pImageInfo      = &descriptorTargetImageInfo;
+
+    const uint32_t writeDescriptorSetCount = m_rayTracingSupported ? static_cast<uint32_t>(writeDescriptorSets.size()) : 4;
+
+    const std::vector<VkImageView>& targetImageViews = getRenderTargetImageViews();
+    for (size_t i = 0; i < m_renderTargetCount; ++i) {
+        cameraDescriptorBufferInfo.buffer   = m_cameraBuffers[i].buffer;
+        descriptorTargetImageInfo.imageView = targetImageViews[i];
+
+        for (uint32_t j = 0; j < writeDescriptorSetCount; ++j) {
+            writeDescriptorSets[j].dstSet = m_descriptorSets[i];
+        }
 
-        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+        vkUpdateDescriptorSets(m_device, writeDescriptorSetCount, writeDescriptorSets.data(), 0, nullptr);
     }
 
-    const uint32_t shaderGroupCount = 3;
+    if (m_rayTracingSupported) {
+        const uint32_t shaderGroupCount = 3;
 
-    const VkDeviceSize baseGroupAlignment    = physicalDeviceRayTracingProperties.shaderGroupBaseAlignment;
-    const VkDeviceSize shaderGroupHandleSize = physicalDeviceRayTracingProperties.shaderGroupHandleSize;
+        const VkDeviceSize baseGroupAlignment    = physicalDeviceRayTracingProperties.shaderGroupBaseAlignment;
+        const VkDeviceSize shaderGroupHandleSize = physicalDeviceRayTracingProperties.shaderGroupHandleSize;
 
-    const VkDeviceSize   shaderHandleStorageSize = shaderGroupHandleSize * shaderGroupCount;
-    std::vector<uint8_t> shaderHandleStorage(shaderHandleStorageSize);
-    vkGetRayTracingShaderGroupHandlesKHR(m_device, m_rayTracingPipeline, 0, shaderGroupCount, shaderHandleStorageSize, shaderHandleStorage.data());
-    uint8_t* shaderHandlesStoragePtr = shaderHandleStorage.data();
+        const VkDeviceSize   shaderHandleStorageSize = shaderGroupHandleSize * shaderGroupCount;
+        std::vector<uint8_t> shaderHandleStorage(shaderHandleStorageSize);
+        vkGetRayTracingShaderGroupHandlesKHR(m_device, m_rayTracingPipeline, 0, shaderGroupCount, shaderHandleStorageSize, shaderHandleStorage.data());
+        uint8_t* shaderHandlesStoragePtr = shaderHandleStorage.data();
 
-    const VkDeviceSize   alignedShaderHandlesSize = baseGroupAlignment * shaderGroupCount;
-    std::vector<uint8_t> alignedShaderHandles(alignedShaderHandlesSize);
-    uint8_t*             alignedShaderHandlesPtr = alignedShaderHandles.data();
+        const VkDeviceSize   alignedShaderHandlesSize = baseGroupAlignment * shaderGroupCount;
+        std::vector<uint8_t> alignedShaderHandles(alignedShaderHandlesSize);
+        uint8_t*             alignedShaderHandlesPtr = alignedShaderHandles.data();
 
-    for (size_t i = 0; i < 3; ++i) {
-        memcpy(alignedShaderHandlesPtr, shaderHandlesStoragePtr, shaderGroupHandleSize);
-        shaderHandlesStoragePtr += shaderGroupHandleSize;
-        alignedShaderHandlesPtr += baseGroupAlignment;
-    }
+        for (size_t i = 0; i < 3; ++i) {
+            memcpy(alignedShaderHandlesPtr, shaderHandlesStoragePtr, shaderGroupHandleSize);
+            shaderHandlesStoragePtr += shaderGroupHandleSize;
+            alignedShaderHandlesPtr += baseGroupAlignment;
+        }
 
-    m_shaderBindingTableBuffer = createBuffer(m_device, alignedShaderHandlesSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR,
-                                              m_physicalDeviceMemoryProperties, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    uploadToDeviceLocalBuffer(m_device, alignedShaderHandles, stagingBuffer.buffer, stagingBuffer.memory, m_shaderBindingTableBuffer.buffer,
-                              m_transferCommandPool, queue);
+        m_shaderBindingTableBuffer = createBuffer(m_device, *m_memoryAllocator, alignedShaderHandlesSize,
+                                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR, MemoryUsage::DeviceAddressBuffer);
+        m_uploader->upload(alignedShaderHandles, m_shaderBindingTableBuffer.buffer, 0, m_graphicsQueueFamilyIndex);
 
-    vkFreeMemory(m_device, stagingBuffer.memory, nullptr);
-    vkDestroyBuffer(m_device, stagingBuffer.buffer, nullptr);
+        raygenStridedBufferRegion.buffer = m_shaderBindingTableBuffer.buffer;
+        raygenStridedBufferRegion.offset = static_cast<VkDeviceSize>(baseGroupAlignment * INDEX_RAYGEN);
+        raygenStridedBufferRegion.size   = shaderGroupHandleSize;
+        raygenStridedBufferRegion.stride = shaderGroupHandleSize;
 
-    VkStridedBufferRegionKHR raygenStridedBufferRegion = {};
-    raygenStridedBufferRegion.buffer                   = m_shaderBindingTableBuffer.buffer;
-    raygenStridedBufferRegion.offset                   = static_cast<VkDeviceSize>(baseGroupAlignment * INDEX_RAYGEN);
-    raygenStridedBufferRegion.size                     = shaderGroupHandleSize;
-    raygenStridedBufferRegion.stride                   = shaderGroupHandleSize;
+        closestHitStridedBufferRegion.buffer = m_shaderBindingTableBuffer.buffer;
+        closestHitStridedBufferRegion.offset = static_cast<VkDeviceSize>(baseGroupAlignment * INDEX_CLOSEST_HIT);
+        closestHitStridedBufferRegion.size   = shaderGroupHandleSize;
+        closestHitStridedBufferRegion.stride = shaderGroupHandleSize;
 
-    VkStridedBufferRegionKHR closestHitStridedBufferRegion = {};
-    closestHitStridedBufferRegion.buffer                   = m_shaderBindingTableBuffer.buffer;
-    closestHitStridedBufferRegion.offset                   = static_cast<VkDeviceSize>(baseGroupAlignment * INDEX_CLOSEST_HIT);
-    closestHitStridedBufferRegion.size                     = shaderGroupHandleSize;
-    closestHitStridedBufferRegion.stride                   = shaderGroupHandleSize;
+        missStridedBufferRegion.buffer = m_shaderBindingTableBuffer.buffer;
+        missStridedBufferRegion.offset = static_cast<VkDeviceSize>(baseGroupAlignment * INDEX_MISS);
+        missStridedBufferRegion.size   = shaderGroupHandleSize;
+        missStridedBufferRegion.stride = shaderGroupHandleSize;
+    }
 
-    VkStridedBufferRegionKHR missStridedBufferRegion = {};
-    missStridedBufferRegion.buffer                   = m_shaderBindingTableBuffer.buffer;
-    missStridedBufferRegion.offset                   = static_cast<VkDeviceSize>(baseGroupAlignment * INDEX_MISS);
-    missStridedBufferRegion.size                     = shaderGroupHandleSize;
-    missStridedBufferRegion.stride                   = shaderGroupHandleSize;
+    m_uploader->flush();
 
-    VkStridedBufferRegionKHR callableStridedBufferRegion = {};
+    m_memoryAllocator->printStats();
 
     VkCommandPoolCreateInfo commandPoolCreateInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
     commandPoolCreateInfo.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-    commandPoolCreateInfo.queueFamilyIndex        = m_queueFamilyIndex;
+    commandPoolCreateInfo.queueFamilyIndex        = m_graphicsQueueFamilyIndex;
 
     VkCommandBufferAllocateInfo commandBufferAllocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
     commandBufferAllocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     commandBufferAllocateInfo.commandBufferCount          = 1;
 
-    m_commandPools   = std::vector<VkCommandPool>(m_swapchainImageCount);
-    m_commandBuffers = std::vector<VkCommandBuffer>(m_swapchainImageCount);
-    for (size_t i = 0; i < m_swapchainImageCount; ++i) {
+    m_commandPools   = std::vector<VkCommandPool>(m_renderTargetCount);
+    m_commandBuffers = std::vector<VkCommandBuffer>(m_renderTargetCount);
+    for (size_t i = 0; i < m_renderTargetCount; ++i) {
         VK_CHECK(vkCreateCommandPool(m_device, &commandPoolCreateInfo, nullptr, &m_commandPools[i]));
         commandBufferAllocateInfo.commandPool = m_commandPools[i];
         VK_CHECK(vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &m_commandBuffers[i]));
     }
 
-    m_imageAvailableSemaphores = std::vector<VkSemaphore>(MAX_FRAMES_IN_FLIGHT);
-    m_renderFinishedSemaphores = std::vector<VkSemaphore>(MAX_FRAMES_IN_FLIGHT);
-    m_inFlightFences           = std::vector<VkFence>(MAX_FRAMES_IN_FLIGHT);
-    std::vector<VkFence> imagesInFlight(m_swapchainImageCount, VK_NULL_HANDLE);
+    m_commandBuffersReusable = std::vector<bool>(m_renderTargetCount, false);
 
-    VkSemaphoreCreateInfo semaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-    VkFenceCreateInfo     fenceCreateInfo     = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-    fenceCreateInfo.flags                     = VK_FENCE_CREATE_SIGNALED_BIT;
+    m_threadCommandPools = std::make_unique<ThreadCommandPools>(m_device, m_graphicsQueueFamilyIndex, m_renderTargetCount, m_jobSystem->getThreadCount());
+
+    m_frameTimeline                = std::make_unique<FrameTimeline>(m_device, m_settings.framesInFlight);
+    m_deletionQueue                = std::make_unique<DeletionQueue>(m_device, *m_memoryAllocator);
+    m_renderTargetFrameValues      = std::vector<uint64_t>(m_renderTargetCount, 0);
+    m_renderTargetDescriptorsStale = std::vector<bool>(m_renderTargetCount, false);
+
+    // Presentation only works with binary semaphores. Acquires are paced by the frame timeline, so there is one per frame in flight,
+    // presents are waited on per image.
+    if (!m_settings.headless) {
+        m_imageAvailableSemaphores = std::vector<VkSemaphore>(m_settings.framesInFlight);
+        m_renderFinishedSemaphores = std::vector<VkSemaphore>(m_renderTargetCount);
+
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+
+        for (VkSemaphore& semaphore : m_imageAvailableSemaphores) {
+            VK_CHECK(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &semaphore));
+        }
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        VK_CHECK(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_imageAvailableSemaphores[i]));
-        VK_CHECK(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_renderFinishedSemaphores[i]));
-        VK_CHECK(vkCreateFence(m_device, &fenceCreateInfo, nullptr, &m_inFlightFences[i]));
+        for (VkSemaphore& semaphore : m_renderFinishedSemaphores) {
+            VK_CHECK(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &semaphore));
+        }
+
+        m_latencyMonitor = std::make_unique<LatencyMonitor>(m_device, m_frameTimeline->getSemaphore(), m_presentWaitSupported, m_settings.justInTimeInput);
     }
 
     m_camera.orientation = glm::vec2(0.0f, 0.0f);
-    m_camera.position    = glm::vec3(0.0f, 0.0f, 2.5f);
+    m_camera.position    = glm::vec3(0.0f, 0.0f, ORBIT_CAMERA_RADIUS);
 
-    m_rasterPushData.oneOverTanOfHalfFov = 1.0f / tan(0.5f * FOV);
-    m_rasterPushData.oneOverAspectRatio  = static_cast<float>(m_surfaceExtent.height) / static_cast<float>(m_surfaceExtent.width);
-    m_rasterPushData.near                = NEAR;
+    m_cameraData.raster.oneOverTanOfHalfFov = 1.0f / tan(0.5f * FOV);
+    m_cameraData.raster.oneOverAspectRatio  = static_cast<float>(m_surfaceExtent.height) / static_cast<float>(m_surfaceExtent.width);
+    m_cameraData.raster.near                = NEAR;
 
-    m_rayTracingPushData.oneOverTanOfHalfFov = 1.0f / tan(0.5f * FOV);
+    m_cameraData.rayTracing.oneOverTanOfHalfFov = 1.0f / tan(0.5f * FOV);
 
-    uint32_t currentFrame = 0;
-    bool     rayTracing   = true;
-    bool     updatedUI    = false;
+    if (m_settings.validate) {
+        runValidation(queue, raygenStridedBufferRegion, closestHitStridedBufferRegion, missStridedBufferRegion, callableStridedBufferRegion, *scene);
+        return;
+    }
 
-    std::chrono::high_resolution_clock::time_point oldTime = std::chrono::high_resolution_clock::now();
-    uint32_t                                       time    = 0;
+    if (m_settings.headless) {
+        runHeadless(queue, raygenStridedBufferRegion, closestHitStridedBufferRegion, missStridedBufferRegion, callableStridedBufferRegion);
+        return;
+    }
+
+    bool rayTracing = m_settings.rayTracing && m_rayTracingSupported;
+    bool updatedUI  = false;
+
+    std::chrono::high_resolution_clock::time_point oldTime        = std::chrono::high_resolution_clock::now();
+    uint32_t                                       time           = 0;
+    float                                          animationAngle = 0.0f;
 
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        PROFILE_ZONE("frame");
+
+        m_frameTimeline->waitForLatency();
+        m_deletionQueue->collect(m_frameTimeline->getCompletedValue(), m_latencyMonitor->getWaitedSwapchain());
 
-        vkWaitForFences(m_device, 1, &m_inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        const VkSemaphore imageAvailableSemaphore = m_imageAvailableSemaphores[m_frameTimeline->getNextSlot()];
 
-        uint32_t imageIndex;
-        VkResult acquireResult =
-            vkAcquireNextImageKHR(m_device, m_swapchain->get(), UINT64_MAX, m_imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        ProfileZone acquireZone("vkAcquireNextImageKHR");
+        uint32_t    imageIndex;
+        VkResult    acquireResult = vkAcquireNextImageKHR(m_device, m_swapchain->get(), UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+        acquireZone.end();
         if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
             updateSurfaceDependantStructures();
             continue;
@@ -573,26 +979,37 @@ void Application::run() {
             VK_CHECK(acquireResult);
         }
 
-        if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-            vkWaitForFences(m_device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+        // Images can come back out of order, so the last frame rendered into this one may still be in flight within the latency depth
+        ProfileZone renderTargetZone("waitForRenderTarget");
+        m_frameTimeline->wait(m_renderTargetFrameValues[imageIndex]);
+        renderTargetZone.end();
+
+        if (m_renderTargetDescriptorsStale[imageIndex]) {
+            writeRenderTargetDescriptor(imageIndex);
         }
-        imagesInFlight[imageIndex] = m_inFlightFences[currentFrame];
 
-        vkResetCommandPool(m_device, m_commandPools[imageIndex], VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+        m_gpuProfiler->collect(imageIndex);
+
+        // Input is sampled only once the frame is ready to be recorded, as late as the latency monitor expects it to make the present
+        m_latencyMonitor->waitForInput();
+        glfwPollEvents();
 
         std::chrono::high_resolution_clock::time_point newTime = std::chrono::high_resolution_clock::now();
         uint32_t frameTime = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(newTime - oldTime).count());
         oldTime            = newTime;
         time += frameTime;
 
-        if (m_keyStates[GLFW_KEY_P].pressed && m_keyStates[GLFW_KEY_P].transitions % 2 == 1) {
+        if (m_keyStates[GLFW_KEY_P].pressed && m_keyStates[GLFW_KEY_P].transitions % 2 == 1 && m_rayTracingSupported) {
             rayTracing = !rayTracing;
             updatedUI  = true;
+
+            m_commandBuffersReusable.assign(m_commandBuffersReusable.size(), false);
         }
 
         if (time > FRAMERATE_UPDATE_PERIOD || updatedUI) {
             char title[256];
-            sprintf_s(title, "Frametime: %.2fms, RTX %s", frameTime / 1'000.0f, rayTracing ? "ON" : "OFF");
+            sprintf_s(title, "Frametime: %.2fms, GPU: %.2fms, latency: %.2fms, RTX %s", frameTime / 1'000.0f,
+                      m_gpuProfiler->getStats(GpuPass::Frame).average, m_latencyMonitor->getStats().inputToPresent, rayTracing ? "ON" : "OFF");
             glfwSetWindowTitle(window, title);
             time      = 0;
             updatedUI = false;
@@ -600,40 +1017,44 @@ void Application::run() {
 
         m_keyStates[GLFW_KEY_P].transitions = 0;
 
-        updateCameraAndPushData(frameTime);
+        updateCamera(frameTime);
 
-        if (rayTracing) {
-            recordRayTracingCommandBuffer(imageIndex, raygenStridedBufferRegion, closestHitStridedBufferRegion, missStridedBufferRegion,
-                                          callableStridedBufferRegion);
-        } else {
-            recordRasterCommandBuffer(imageIndex, static_cast<uint32_t>(cubeIndices.size()));
+        if (m_settings.animateInstances && m_rayTracingSupported) {
+            animationAngle += INSTANCE_ROTATION_SPEED * static_cast<float>(frameTime) / 1'000'000.0f;
+            animateTopLevelInstances(animationAngle);
         }
 
-        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-
-        VkSubmitInfo submitInfo         = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-        submitInfo.waitSemaphoreCount   = 1;
-        submitInfo.pWaitSemaphores      = &m_imageAvailableSemaphores[currentFrame];
-        submitInfo.pWaitDstStageMask    = &waitStage;
-        submitInfo.commandBufferCount   = 1;
-        submitInfo.pCommandBuffers      = &m_commandBuffers[imageIndex];
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores    = &m_renderFinishedSemaphores[currentFrame];
+        prepareCommandBuffer(imageIndex, rayTracing, raygenStridedBufferRegion, closestHitStridedBufferRegion, missStridedBufferRegion,
+                             callableStridedBufferRegion);
+        writeCameraData(imageIndex);
 
-        vkResetFences(m_device, 1, &m_inFlightFences[currentFrame]);
+        submitFrame(queue, imageIndex, 1, &m_commandBuffers[imageIndex], imageAvailableSemaphore, m_renderFinishedSemaphores[imageIndex]);
 
-        VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, m_inFlightFences[currentFrame]));
+        std::chrono::high_resolution_clock::time_point submitTime = std::chrono::high_resolution_clock::now();
 
-        const VkSwapchainKHR& swapchain = m_swapchain->get();
+        const VkSwapchainKHR& swapchain  = m_swapchain->get();
+        const uint64_t        frameValue = m_renderTargetFrameValues[imageIndex];
 
         VkPresentInfoKHR presentInfo   = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores    = &m_renderFinishedSemaphores[currentFrame];
+        presentInfo.pWaitSemaphores    = &m_renderFinishedSemaphores[imageIndex];
         presentInfo.swapchainCount     = 1;
         presentInfo.pSwapchains        = &swapchain;
         presentInfo.pImageIndices      = &imageIndex;
 
-        VkResult presentResult = vkQueuePresentKHR(queue, &presentInfo);
+#ifdef VK_KHR_present_wait
+        VkPresentIdKHR presentId = {VK_STRUCTURE_TYPE_PRESENT_ID_KHR};
+        presentId.swapchainCount = 1;
+        presentId.pPresentIds    = &frameValue;
+
+        if (m_presentWaitSupported) {
+            presentInfo.pNext = &presentId;
+        }
+#endif
+
+        ProfileZone presentZone("vkQueuePresentKHR");
+        VkResult    presentResult = vkQueuePresentKHR(queue, &presentInfo);
+        presentZone.end();
         if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
             updateSurfaceDependantStructures();
             continue;
@@ -641,11 +1062,202 @@ void Application::run() {
             VK_CHECK(presentResult);
         }
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        m_latencyMonitor->addFrame(frameValue, swapchain, newTime, submitTime);
     }
+
+    m_gpuProfiler->printStats();
+    m_latencyMonitor->printStats();
+}
+
+void Application::runHeadless(const VkQueue& queue, const VkStridedBufferRegionKHR& raygenStridedBufferRegion,
+                              const VkStridedBufferRegionKHR& closestHitStridedBufferRegion, const VkStridedBufferRegionKHR& missStridedBufferRegion,
+                              const VkStridedBufferRegionKHR& callableBufferRegion) {
+    const std::vector<CameraKeyframe> cameraPath = m_settings.cameraPathFile.empty()
+                                                       ? createOrbitCameraPath(m_settings.frameCount, ORBIT_CAMERA_RADIUS)
+                                                       : loadCameraPath(m_settings.cameraPathFile.c_str());
+
+    const bool rayTracing = m_settings.rayTracing && m_rayTracingSupported;
+
+    std::vector<FrameTiming> frameTimings(m_settings.frameCount);
+
+    printf("Rendering %u frames headless at %ux%u, RTX %s\n", m_settings.frameCount, m_surfaceExtent.width, m_surfaceExtent.height,
+           rayTracing ? "ON" : "OFF");
+
+    std::chrono::high_resolution_clock::time_point oldTime = std::chrono::high_resolution_clock::now();
+
+    // Frames are retired one full cycle of render targets later, when their target is waited on for reuse
+    for (uint32_t frame = 0; frame < m_settings.frameCount + m_renderTargetCount; ++frame) {
+        PROFILE_ZONE("frame");
+
+        const uint32_t targetIndex = frame % m_renderTargetCount;
+
+        ProfileZone renderTargetZone("waitForRenderTarget");
+        m_frameTimeline->wait(m_renderTargetFrameValues[targetIndex]);
+        renderTargetZone.end();
+
+        float gpuTime = m_gpuProfiler->collect(targetIndex);
+        if (frame >= m_renderTargetCount) {
+            frameTimings[frame - m_renderTargetCount].gpuTime = gpuTime;
+        }
+
+        if (frame >= m_settings.frameCount) {
+            continue;
+        }
+
+        std::chrono::high_resolution_clock::time_point frameStartTime = std::chrono::high_resolution_clock::now();
+
+        m_camera = sampleCameraPath(cameraPath, frame);
+        updateCameraData();
+
+        if (m_settings.animateInstances && rayTracing) {
+            animateTopLevelInstances(INSTANCE_ROTATION_SPEED * HEADLESS_FRAME_TIME * static_cast<float>(frame));
+        }
+
+        prepareCommandBuffer(targetIndex, rayTracing, raygenStridedBufferRegion, closestHitStridedBufferRegion, missStridedBufferRegion, callableBufferRegion);
+        writeCameraData(targetIndex);
+
+        submitFrame(queue, targetIndex, 1, &m_commandBuffers[targetIndex], VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+        std::chrono::high_resolution_clock::time_point submitTime = std::chrono::high_resolution_clock::now();
+
+        FrameTiming& frameTiming  = frameTimings[frame];
+        frameTiming.frame         = frame;
+        frameTiming.cpuFrameTime  = std::chrono::duration<float, std::milli>(frameStartTime - oldTime).count();
+        frameTiming.cpuRecordTime = std::chrono::duration<float, std::milli>(submitTime - frameStartTime).count();
+
+        oldTime = frameStartTime;
+    }
+
+    writeFrameTimings(m_settings.timingsFile.c_str(), frameTimings);
+    m_gpuProfiler->printStats();
+}
+
+void Application::runValidation(const VkQueue& queue, const VkStridedBufferRegionKHR& raygenStridedBufferRegion,
+                                const VkStridedBufferRegionKHR& closestHitStridedBufferRegion, const VkStridedBufferRegionKHR& missStridedBufferRegion,
+                                const VkStridedBufferRegionKHR& callableBufferRegion, const Scene& scene) {
+    if (!m_rayTracingSupported) {
+        throw std::runtime_error("Validation needs a device with ray tracing support!");
+    }
+
+    const std::vector<CameraKeyframe> cameraPath = m_settings.cameraPathFile.empty()
+                                                       ? createOrbitCameraPath(m_settings.frameCount, ORBIT_CAMERA_RADIUS)
+                                                       : loadCameraPath(m_settings.cameraPathFile.c_str());
+
+    const CpuRayTracer cpuRayTracer(*m_jobSystem, scene.getMeshViews());
+
+    const VkDeviceSize imageSize = 4 * static_cast<VkDeviceSize>(m_surfaceExtent.width) * m_surfaceExtent.height;
+
+    Buffer readbackBuffer = createBuffer(m_device, *m_memoryAllocator, imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::Staging);
+
+    VkCommandPool readbackCommandPool = createCommandPool(m_device, m_graphicsQueueFamilyIndex);
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    commandBufferAllocateInfo.commandPool                 = readbackCommandPool;
+    commandBufferAllocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount          = 1;
+
+    VkCommandBuffer readbackCommandBuffer = 0;
+    VK_CHECK(vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &readbackCommandBuffer));
+
+    std::vector<uint8_t> referencePixels(imageSize);
+
+    const float    maxMismatchedPixels = m_settings.validationMaxMismatch * 0.01f * static_cast<float>(imageSize / 4);
+    const uint32_t poseCount           = std::min(m_settings.validationPoseCount, m_settings.frameCount);
+    uint32_t       failedPoseCount     = 0;
+
+    printf("Validating %u poses at %ux%u against the CPU ray tracer, tolerance %u, at most %.3f%% mismatched pixels, PSNR at least %.1fdB\n", poseCount,
+           m_surfaceExtent.width, m_surfaceExtent.height, m_settings.validationPixelTolerance, m_settings.validationMaxMismatch,
+           m_settings.validationMinPsnr);
+
+    // Every pose is rendered into the first render target and read back before the next one, validation doesn't care about throughput
+    for (uint32_t pose = 0; pose < poseCount; ++pose) {
+        const uint32_t frame = static_cast<uint32_t>(static_cast<uint64_t>(pose) * m_settings.frameCount / poseCount);
+
+        m_frameTimeline->wait(m_renderTargetFrameValues[0]);
+        m_gpuProfiler->collect(0);
+
+        vkResetCommandPool(m_device, m_commandPools[0], VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+        vkResetCommandPool(m_device, readbackCommandPool, 0);
+
+        m_camera = sampleCameraPath(cameraPath, frame);
+        updateCameraData();
+
+        const float instanceAngle = m_settings.animateInstances ? INSTANCE_ROTATION_SPEED * HEADLESS_FRAME_TIME * static_cast<float>(frame) : 0.0f;
+        if (m_settings.animateInstances) {
+            animateTopLevelInstances(instanceAngle);
+        }
+
+        recordRayTracingCommandBuffer(0, raygenStridedBufferRegion, closestHitStridedBufferRegion, missStridedBufferRegion, callableBufferRegion);
+        writeCameraData(0);
+
+        VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        commandBufferBeginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        VK_CHECK(vkBeginCommandBuffer(readbackCommandBuffer, &commandBufferBeginInfo));
+
+        // The ray tracing command buffer leaves the image in the transfer source layout, only its writes need to be made visible
+        VkMemoryBarrier traceToCopy = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        traceToCopy.srcAccessMask   = VK_ACCESS_MEMORY_WRITE_BIT;
+        traceToCopy.dstAccessMask   = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(readbackCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &traceToCopy, 0, nullptr, 0,
+                             nullptr);
+
+        VkBufferImageCopy copyRegion = {};
+        copyRegion.imageSubresource  = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        copyRegion.imageExtent       = {m_surfaceExtent.width, m_surfaceExtent.height, 1};
+        vkCmdCopyImageToBuffer(readbackCommandBuffer, m_offscreenImages[0], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer.buffer, 1, &copyRegion);
+
+        VkMemoryBarrier copyToHost = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        copyToHost.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        copyToHost.dstAccessMask   = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(readbackCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &copyToHost, 0, nullptr, 0, nullptr);
+
+        VK_CHECK(vkEndCommandBuffer(readbackCommandBuffer));
+
+        std::array<VkCommandBuffer, 2> commandBuffers = {m_commandBuffers[0], readbackCommandBuffer};
+
+        submitFrame(queue, 0, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data(), VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+        // The CPU reference renders while the GPU traces the same pose
+        cpuRayTracer.render(*m_jobSystem, m_cameraData.rayTracing, instanceAngle, m_surfaceExtent.width, m_surfaceExtent.height, referencePixels.data());
+
+        m_frameTimeline->wait(m_renderTargetFrameValues[0]);
+
+        const uint8_t*        pixels     = static_cast<const uint8_t*>(readbackBuffer.allocation.mappedData);
+        const ImageComparison comparison = compareImages(pixels, referencePixels.data(), m_surfaceExtent.width, m_surfaceExtent.height,
+                                                         m_settings.validationPixelTolerance);
+
+        const bool passed = static_cast<float>(comparison.mismatchedPixelCount) <= maxMismatchedPixels && comparison.psnr >= m_settings.validationMinPsnr;
+
+        printf("Pose %u (frame %u): %s, %u mismatched pixels, max difference %u, PSNR %.2fdB\n", pose, frame, passed ? "passed" : "FAILED",
+               comparison.mismatchedPixelCount, comparison.maxDifference, comparison.psnr);
+
+        if (!passed) {
+            ++failedPoseCount;
+
+            const std::string prefix = "validation_pose" + std::to_string(pose);
+            writeImage((prefix + "_gpu.ppm").c_str(), pixels, m_surfaceExtent.width, m_surfaceExtent.height);
+            writeImage((prefix + "_cpu.ppm").c_str(), referencePixels.data(), m_surfaceExtent.width, m_surfaceExtent.height);
+            writeDiffImage((prefix + "_diff.ppm").c_str(), pixels, referencePixels.data(), m_surfaceExtent.width, m_surfaceExtent.height,
+                           m_settings.validationPixelTolerance);
+        }
+    }
+
+    vkFreeCommandBuffers(m_device, readbackCommandPool, 1, &readbackCommandBuffer);
+    vkDestroyCommandPool(m_device, readbackCommandPool, nullptr);
+    destroyBuffer(m_device, *m_memoryAllocator, readbackBuffer);
+
+    if (failedPoseCount > 0) {
+        throw std::runtime_error("Validation failed for " + std::to_string(failedPoseCount) + " of " + std::to_string(poseCount) +
+                                 " poses, see the validation_pose images!");
+    }
+
+    printf("Validation passed\n");
 }
 
 const VkInstance Application::createInstance() const {
+    PROFILE_ZONE("createInstance");
+
     VkApplicationInfo applicationInfo  = {VK_STRUCTURE_TYPE_APPLICATION_INFO};
     applicationInfo.apiVersion         = VK_API_VERSION_1_2;
     applicationInfo.applicationVersion = 0;
@@ -670,10 +1282,13 @@ const VkInstance Application::createInstance() const {
     createInfo.ppEnabledLayerNames = layers.data();
 #endif
 
-    uint32_t     glfwExtensionCount;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char*> extensions;
+    if (!m_settings.headless) {
+        uint32_t     glfwExtensionCount;
+        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
 #ifdef VALIDATION_ENABLED
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -696,9 +1311,9 @@ const uint32_t Application::getGraphicsQueueFamilyIndex(const VkPhysicalDevice&
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
 
     uint32_t     queueFamilyIndex = UINT32_MAX;
-    VkQueueFlags queueFlags       = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+    VkQueueFlags queueFlags       = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT; // Both imply transfer support
     for (size_t i = 0; i < queueFamilyCount; ++i) {
-        if (queueFamilies[i].queueFlags & queueFlags) {
+        if ((queueFamilies[i].queueFlags & queueFlags) == queueFlags) {
             queueFamilyIndex = static_cast<uint32_t>(i);
             break;
         }
@@ -707,13 +1322,100 @@ const uint32_t Application::getGraphicsQueueFamilyIndex(const VkPhysicalDevice&
     return queueFamilyIndex;
 }
 
+const uint32_t Application::getDedicatedQueueFamilyIndex(const VkPhysicalDevice& physicalDevice, const VkQueueFlags& requiredFlags,
+                                                         const VkQueueFlags& excludedFlags) const {
+    uint32_t queueFamilyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, 0);
+
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    for (size_t i = 0; i < queueFamilyCount; ++i) {
+        if ((queueFamilies[i].queueFlags & requiredFlags) == requiredFlags && (queueFamilies[i].queueFlags & excludedFlags) == 0) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+const bool Application::rayTracingSupported(const VkPhysicalDevice& physicalDevice) const {
+    uint32_t extensionPropertyCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionPropertyCount, nullptr);
+
+    std::vector<VkExtensionProperties> extensionPropertiess(extensionPropertyCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionPropertyCount, extensionPropertiess.data());
+
+    bool rayTracingSupported             = false;
+    bool defferedHostOperationsSupported = false; // Required for VK_KHR_ray_tracing
+    bool pipelineLibrarySupported        = false; // Required for VK_KHR_ray_tracing
+    for (VkExtensionProperties extensionProperties : extensionPropertiess) {
+        if (strcmp(extensionProperties.extensionName, VK_KHR_RAY_TRACING_EXTENSION_NAME) == 0) {
+            rayTracingSupported = true;
+        } else if (strcmp(extensionProperties.extensionName, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME) == 0) {
+            defferedHostOperationsSupported = true;
+        } else if (strcmp(extensionProperties.extensionName, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) == 0) {
+            pipelineLibrarySupported = true;
+        }
+
+        if (rayTracingSupported && defferedHostOperationsSupported && pipelineLibrarySupported) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Frames can only be waited on until they are presented with both present IDs and present wait, headers without them never support it
+const bool Application::presentWaitSupported(const VkPhysicalDevice& physicalDevice) const {
+#ifdef VK_KHR_present_wait
+    uint32_t extensionPropertyCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionPropertyCount, nullptr);
+
+    std::vector<VkExtensionProperties> extensionPropertiess(extensionPropertyCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionPropertyCount, extensionPropertiess.data());
+
+    bool presentIdSupported   = false;
+    bool presentWaitSupported = false;
+    for (VkExtensionProperties extensionProperties : extensionPropertiess) {
+        if (strcmp(extensionProperties.extensionName, VK_KHR_PRESENT_ID_EXTENSION_NAME) == 0) {
+            presentIdSupported = true;
+        } else if (strcmp(extensionProperties.extensionName, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0) {
+            presentWaitSupported = true;
+        }
+    }
+
+    if (!presentIdSupported || !presentWaitSupported) {
+        return false;
+    }
+
+    VkPhysicalDevicePresentWaitFeaturesKHR physicalDevicePresentWaitFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR};
+    VkPhysicalDevicePresentIdFeaturesKHR   physicalDevicePresentIdFeatures   = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR};
+    physicalDevicePresentIdFeatures.pNext                                    = &physicalDevicePresentWaitFeatures;
+
+    VkPhysicalDeviceFeatures2 physicalDeviceFeatures2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    physicalDeviceFeatures2.pNext                     = &physicalDevicePresentIdFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &physicalDeviceFeatures2);
+
+    return physicalDevicePresentIdFeatures.presentId && physicalDevicePresentWaitFeatures.presentWait;
+#else
+    (void)physicalDevice;
+    return false;
+#endif
+}
+
 const VkPhysicalDevice Application::pickPhysicalDevice() const {
+    PROFILE_ZONE("pickPhysicalDevice");
+
     uint32_t physicalDeviceCount;
     VK_CHECK(vkEnumeratePhysicalDevices(m_instance, &physicalDeviceCount, 0));
 
     std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
     VK_CHECK(vkEnumeratePhysicalDevices(m_instance, &physicalDeviceCount, physicalDevices.data()));
 
+    // Headless runs accept any device, including software implementations without ray tracing support
+    VkPhysicalDevice headlessFallback = VK_NULL_HANDLE;
+
     uint32_t graphicsQueueIndex = UINT32_MAX;
     for (size_t i = 0; i < physicalDeviceCount; ++i) {
         VkPhysicalDevice physicalDevice = physicalDevices[i];
@@ -727,13 +1429,25 @@ const VkPhysicalDevice Application::pickPhysicalDevice() const {
             continue;
         }
 
-        if (physicalDeviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+        graphicsQueueIndex = getGraphicsQueueFamilyIndex(physicalDevice);
+
+        if (graphicsQueueIndex == UINT32_MAX) {
             continue;
         }
 
-        graphicsQueueIndex = getGraphicsQueueFamilyIndex(physicalDevice);
+        if (m_settings.headless) {
+            if (rayTracingSupported(physicalDevice)) {
+                return physicalDevice;
+            }
 
-        if (graphicsQueueIndex == UINT32_MAX) {
+            if (headlessFallback == VK_NULL_HANDLE || physicalDeviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+                headlessFallback = physicalDevice;
+            }
+
+            continue;
+        }
+
+        if (physicalDeviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
             continue;
         }
 
@@ -744,49 +1458,51 @@ const VkPhysicalDevice Application::pickPhysicalDevice() const {
             continue;
         }
 
-        uint32_t extensionPropertyCount = 0;
-        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionPropertyCount, nullptr);
-
-        std::vector<VkExtensionProperties> extensionPropertiess(extensionPropertyCount);
-        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionPropertyCount, extensionPropertiess.data());
-
-        bool rayTracingSupported             = false;
-        bool defferedHostOperationsSupported = false; // Required for VK_KHR_ray_tracing
-        bool pipelineLibrarySupported        = false; // Required for VK_KHR_ray_tracing
-        for (VkExtensionProperties extensionProperties : extensionPropertiess) {
-            if (strcmp(extensionProperties.extensionName, VK_KHR_RAY_TRACING_EXTENSION_NAME) == 0) {
-                rayTracingSupported = true;
-            } else if (strcmp(extensionProperties.extensionName, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME) == 0) {
-                defferedHostOperationsSupported = true;
-            } else if (strcmp(extensionProperties.extensionName, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) == 0) {
-                pipelineLibrarySupported = true;
-            }
-
-            if (rayTracingSupported && defferedHostOperationsSupported && pipelineLibrarySupported) {
-                break;
-            }
-        }
-
-        if (!rayTracingSupported || !defferedHostOperationsSupported || !pipelineLibrarySupported) {
+        if (!rayTracingSupported(physicalDevice)) {
             continue;
         }
 
         return physicalDevice;
     }
 
+    if (headlessFallback != VK_NULL_HANDLE) {
+        return headlessFallback;
+    }
+
     throw std::runtime_error("No suitable GPU found!");
 }
 
+void Application::createOffscreenImages() {
+    m_offscreenImages           = std::vector<VkImage>(m_renderTargetCount);
+    m_offscreenImageAllocations = std::vector<Allocation>(m_renderTargetCount);
+    m_offscreenImageViews       = std::vector<VkImageView>(m_renderTargetCount);
+
+    VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+    for (size_t i = 0; i < m_renderTargetCount; ++i) {
+        m_offscreenImages[i]           = createImage(m_device, m_surfaceExtent, imageUsageFlags, m_colorFormat);
+        m_offscreenImageAllocations[i] = allocateImageMemory(m_device, *m_memoryAllocator, m_offscreenImages[i]);
+
+        m_offscreenImageViews[i] = createImageView(m_device, m_offscreenImages[i], m_colorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+}
+
+const std::vector<VkImage>& Application::getRenderTargetImages() const { return m_swapchain ? m_swapchain->getImages() : m_offscreenImages; }
+
+const std::vector<VkImageView>& Application::getRenderTargetImageViews() const {
+    return m_swapchain ? m_swapchain->getImageViews() : m_offscreenImageViews;
+}
+
 const VkRenderPass Application::createRenderPass() const {
     std::array<VkAttachmentDescription, 2> attachments;
     attachments.fill({});
 
-    attachments[0].format        = m_swapchain->getSurfaceFormat().format;
+    attachments[0].format        = m_colorFormat;
     attachments[0].samples       = VK_SAMPLE_COUNT_1_BIT;
     attachments[0].loadOp        = VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachments[0].storeOp       = VK_ATTACHMENT_STORE_OP_STORE;
     attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[0].finalLayout   = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachments[0].finalLayout   = m_targetImageFinalLayout;
 
     attachments[1].format         = VK_FORMAT_D32_SFLOAT_S8_UINT;
     attachments[1].samples        = VK_SAMPLE_COUNT_1_BIT;
@@ -826,13 +1542,13 @@ const std::vector<VkFramebuffer> Application::createFramebuffers() const {
     framebufferCreateInfo.height                  = m_surfaceExtent.height;
     framebufferCreateInfo.layers                  = 1;
 
-    std::vector<VkFramebuffer> framebuffers(m_swapchainImageCount);
+    std::vector<VkFramebuffer> framebuffers(m_renderTargetCount);
     std::array<VkImageView, 2> attachments({});
     attachments[1] = m_depthImageView;
 
-    const std::vector<VkImageView>& swapchainImageViews = m_swapchain->getImageViews();
-    for (size_t i = 0; i < m_swapchainImageCount; ++i) {
-        attachments[0]                     = swapchainImageViews[i];
+    const std::vector<VkImageView>& targetImageViews = getRenderTargetImageViews();
+    for (size_t i = 0; i < m_renderTargetCount; ++i) {
+        attachments[0]                     = targetImageViews[i];
         framebufferCreateInfo.pAttachments = attachments.data();
         VK_CHECK(vkCreateFramebuffer(m_device, &framebufferCreateInfo, nullptr, &framebuffers[i]));
     }
@@ -841,6 +1557,8 @@ const std::vector<VkFramebuffer> Application::createFramebuffers() const {
 }
 
 const VkShaderModule Application::loadShader(const char* pathToSource) const {
+    PROFILE_ZONE("loadShader");
+
     FILE* source;
     fopen_s(&source, pathToSource, "rb");
     assert(source);
@@ -867,7 +1585,38 @@ const VkShaderModule Application::loadShader(const char* pathToSource) const {
     return shaderModule;
 }
 
+void Application::loadShaderJob(void* data) {
+    ShaderLoadJob& job = *static_cast<ShaderLoadJob*>(data);
+
+    const std::string path = std::string("src/shaders/spirv/") + job.name + (job.variant ? *job.variant : "") + ".spv";
+    job.shaderModule       = job.application->loadShader(path.c_str());
+}
+
+void Application::createRasterPipelineJob(void* data) {
+    PipelineJob& job = *static_cast<PipelineJob*>(data);
+
+    job.pipeline   = job.application->createRasterPipeline(job.shaders[0].shaderModule, job.shaders[1].shaderModule);
+    job.finishTime = std::chrono::high_resolution_clock::now();
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        vkDestroyShaderModule(job.application->m_device, job.shaders[i].shaderModule, nullptr);
+    }
+}
+
+void Application::createRayTracingPipelineJob(void* data) {
+    PipelineJob& job = *static_cast<PipelineJob*>(data);
+
+    job.pipeline   = job.application->createRayTracingPipeline(job.shaders[0].shaderModule, job.shaders[1].shaderModule, job.shaders[2].shaderModule);
+    job.finishTime = std::chrono::high_resolution_clock::now();
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        vkDestroyShaderModule(job.application->m_device, job.shaders[i].shaderModule, nullptr);
+    }
+}
+
 const VkPipeline Application::createRasterPipeline(const VkShaderModule& vertexShader, const VkShaderModule& fragmentShader) const {
+    PROFILE_ZONE("createRasterPipeline");
+
     VkGraphicsPipelineCreateInfo createInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
 
     std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
@@ -938,6 +1687,8 @@ const VkPipeline Application::createRasterPipeline(const VkShaderModule& vertexS
 
 const VkPipeline Application::createRayTracingPipeline(const VkShaderModule& raygenShaderModule, const VkShaderModule& closestHitShaderModule,
                                                        const VkShaderModule& missShaderModule) const {
+    PROFILE_ZONE("createRayTracingPipeline");
+
     std::array<VkPipelineShaderStageCreateInfo, 3> shaderStagesCreateInfos;
     shaderStagesCreateInfos.fill({VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO});
     shaderStagesCreateInfos[INDEX_RAYGEN].stage  = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
@@ -984,12 +1735,27 @@ const VkPipeline Application::createRayTracingPipeline(const VkShaderModule& ray
     return pipeline;
 }
 
-void Application::recordRasterCommandBuffer(const uint32_t& frameIndex, const uint32_t& indexCount) const {
+void Application::recordRasterSliceJob(void* data) {
+    PROFILE_ZONE("recordRasterSlice");
+
+    RasterSliceJob&    job         = *static_cast<RasterSliceJob*>(data);
+    const Application& application = *job.application;
+
+    job.commandBuffer = application.m_threadCommandPools->getSecondaryCommandBuffer(job.frameIndex, application.m_jobSystem->getThreadIndex());
+
+    VkCommandBufferInheritanceInfo commandBufferInheritanceInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    commandBufferInheritanceInfo.renderPass                     = application.m_renderPass;
+    commandBufferInheritanceInfo.subpass                        = 0;
+    commandBufferInheritanceInfo.framebuffer                    = application.m_framebuffers[job.frameIndex];
+    commandBufferInheritanceInfo.pipelineStatistics             = application.m_gpuProfiler->getInheritedPipelineStatistics();
+
     VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    commandBufferBeginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT; // Submitted again with the primary when it's reused
+    commandBufferBeginInfo.pInheritanceInfo         = &commandBufferInheritanceInfo;
 
     VkViewport viewport = {};
-    viewport.width      = static_cast<float>(m_surfaceExtent.width);
-    viewport.height     = static_cast<float>(m_surfaceExtent.height);
+    viewport.width      = static_cast<float>(application.m_surfaceExtent.width);
+    viewport.height     = static_cast<float>(application.m_surfaceExtent.height);
     viewport.x          = 0;
     viewport.y          = 0;
     viewport.minDepth   = 1.0f;
@@ -997,12 +1763,54 @@ void Application::recordRasterCommandBuffer(const uint32_t& frameIndex, const ui
 
     VkRect2D scissor = {};
     scissor.offset   = {0, 0};
-    scissor.extent   = m_surfaceExtent;
+    scissor.extent   = application.m_surfaceExtent;
+
+    VK_CHECK(vkBeginCommandBuffer(job.commandBuffer, &commandBufferBeginInfo));
+
+    // Secondary command buffers inherit no state from the primary or from each other
+    vkCmdSetViewport(job.commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(job.commandBuffer, 0, 1, &scissor);
+
+    vkCmdBindPipeline(job.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, application.m_rasterPipeline);
+    vkCmdBindDescriptorSets(job.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, application.m_rasterPipelineLayout, 0, 1,
+                            &application.m_descriptorSets[job.frameIndex], 0, nullptr);
+
+    // The first instance carries the mesh index, the vertex shader looks up the mesh's base vertex with it
+    for (uint32_t i = job.firstMesh; i < job.lastMesh; ++i) {
+        vkCmdDraw(job.commandBuffer, application.m_meshInfos[i].indexCount, 1, application.m_meshInfos[i].firstIndex, i);
+    }
+
+    VK_CHECK(vkEndCommandBuffer(job.commandBuffer));
+}
+
+// The draws are split into contiguous slices recorded on the job system while this thread records the rest of the frame.
+// Slices are executed in mesh order, so the frame comes out the same as with a single command buffer.
+// Returns whether the recording can be submitted again, which it can't once it acquired buffer ownership.
+const bool Application::recordRasterCommandBuffer(const uint32_t& frameIndex) const {
+    PROFILE_ZONE("recordRasterCommandBuffer");
+
+    m_threadCommandPools->reset(frameIndex);
+
+    const uint32_t meshCount  = static_cast<uint32_t>(m_meshInfos.size());
+    const uint32_t sliceCount = std::clamp((meshCount + MIN_DRAWS_PER_SLICE - 1) / MIN_DRAWS_PER_SLICE, 1u, m_jobSystem->getThreadCount());
+
+    std::vector<RasterSliceJob> sliceJobs(sliceCount);
+    JobCounter                  sliceCounter;
+    for (uint32_t i = 0; i < sliceCount; ++i) {
+        sliceJobs[i].application = this;
+        sliceJobs[i].frameIndex  = frameIndex;
+        sliceJobs[i].firstMesh   = static_cast<uint32_t>(static_cast<uint64_t>(meshCount) * i / sliceCount);
+        sliceJobs[i].lastMesh    = static_cast<uint32_t>(static_cast<uint64_t>(meshCount) * (i + 1) / sliceCount);
+        m_jobSystem->run(recordRasterSliceJob, &sliceJobs[i], sliceCounter);
+    }
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
 
     VK_CHECK(vkBeginCommandBuffer(m_commandBuffers[frameIndex], &commandBufferBeginInfo));
 
-    vkCmdSetViewport(m_commandBuffers[frameIndex], 0, 1, &viewport);
-    vkCmdSetScissor(m_commandBuffers[frameIndex], 0, 1, &scissor);
+    m_gpuProfiler->beginFrame(m_commandBuffers[frameIndex], frameIndex);
+
+    const bool acquired = m_uploader->recordAcquireBarriers(m_commandBuffers[frameIndex], m_graphicsQueueFamilyIndex, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
 
     VkRenderPassBeginInfo renderPassBeginInfo = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
     renderPassBeginInfo.renderPass            = m_renderPass;
@@ -1015,53 +1823,98 @@ void Application::recordRasterCommandBuffer(const uint32_t& frameIndex, const ui
     renderPassBeginInfo.clearValueCount              = static_cast<uint32_t>(imageClearColors.size());
     renderPassBeginInfo.pClearValues                 = imageClearColors.data();
     renderPassBeginInfo.framebuffer                  = m_framebuffers[frameIndex];
-    vkCmdBeginRenderPass(m_commandBuffers[frameIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    m_gpuProfiler->beginPass(m_commandBuffers[frameIndex], frameIndex, GpuPass::Raster);
 
-    vkCmdPushConstants(m_commandBuffers[frameIndex], m_rasterPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(RasterPushData), &m_rasterPushData);
+    vkCmdBeginRenderPass(m_commandBuffers[frameIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-    vkCmdBindPipeline(m_commandBuffers[frameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_rasterPipeline);
-    vkCmdBindDescriptorSets(m_commandBuffers[frameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_rasterPipelineLayout, 0, 1, &m_descriptorSets[frameIndex], 0,
-                            nullptr);
+    m_jobSystem->wait(sliceCounter);
 
-    vkCmdDraw(m_commandBuffers[frameIndex], indexCount, 1, 0, 0);
+    std::vector<VkCommandBuffer> sliceCommandBuffers(sliceCount);
+    for (uint32_t i = 0; i < sliceCount; ++i) {
+        sliceCommandBuffers[i] = sliceJobs[i].commandBuffer;
+    }
+
+    vkCmdExecuteCommands(m_commandBuffers[frameIndex], sliceCount, sliceCommandBuffers.data());
 
     vkCmdEndRenderPass(m_commandBuffers[frameIndex]);
 
+    m_gpuProfiler->endPass(m_commandBuffers[frameIndex], frameIndex, GpuPass::Raster);
+    m_gpuProfiler->endFrame(m_commandBuffers[frameIndex], frameIndex);
+
     VK_CHECK(vkEndCommandBuffer(m_commandBuffers[frameIndex]));
+
+    return !acquired;
 }
 
-void Application::recordRayTracingCommandBuffer(const uint32_t& frameIndex, const VkStridedBufferRegionKHR& raygenStridedBufferRegion,
+// Returns whether the recording can be submitted again, which it can't once it acquired buffer ownership or updated the top level structure
+const bool Application::recordRayTracingCommandBuffer(const uint32_t& frameIndex, const VkStridedBufferRegionKHR& raygenStridedBufferRegion,
                                                 const VkStridedBufferRegionKHR& closestHitStridedBufferRegion,
                                                 const VkStridedBufferRegionKHR& missStridedBufferRegion,
-                                                const VkStridedBufferRegionKHR& callableBufferRegion) const {
+                                                const VkStridedBufferRegionKHR& callableBufferRegion) {
+    PROFILE_ZONE("recordRayTracingCommandBuffer");
+
     VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
 
     VK_CHECK(vkBeginCommandBuffer(m_commandBuffers[frameIndex], &commandBufferBeginInfo));
 
-    const VkImage swapchainImage = m_swapchain->getImages()[frameIndex];
+    m_gpuProfiler->beginFrame(m_commandBuffers[frameIndex], frameIndex);
+
+    const bool acquired = m_uploader->recordAcquireBarriers(m_commandBuffers[frameIndex], m_graphicsQueueFamilyIndex, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+    const bool updatedTopLevel = m_topLevelInstancesChanged;
+    if (m_topLevelInstancesChanged) {
+        recordTopAccelerationStructureUpdate(m_commandBuffers[frameIndex], m_topLevelInstances, m_bottomLevelAccelerationStructures,
+                                             m_topLevelAccelerationStructure, frameIndex);
+        m_topLevelInstancesChanged = false;
+    }
+
+    const VkImage targetImage = getRenderTargetImages()[frameIndex];
 
-    VkImageMemoryBarrier undefinedToGeneral = createImageMemoryBarrier(swapchainImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    VkImageMemoryBarrier undefinedToGeneral = createImageMemoryBarrier(targetImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
     vkCmdPipelineBarrier(m_commandBuffers[frameIndex], VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
                          &undefinedToGeneral);
 
-    vkCmdPushConstants(m_commandBuffers[frameIndex], m_rayTracingPipelineLayout, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 0, sizeof(RayTracingPushData),
-                       &m_rayTracingPushData);
-
     vkCmdBindPipeline(m_commandBuffers[frameIndex], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rayTracingPipeline);
     vkCmdBindDescriptorSets(m_commandBuffers[frameIndex], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rayTracingPipelineLayout, 0, 1,
                             &m_descriptorSets[frameIndex], 0, nullptr);
 
+    m_gpuProfiler->beginPass(m_commandBuffers[frameIndex], frameIndex, GpuPass::RayTracing);
+
     vkCmdTraceRaysKHR(m_commandBuffers[frameIndex], &raygenStridedBufferRegion, &missStridedBufferRegion, &closestHitStridedBufferRegion, &callableBufferRegion,
                       m_surfaceExtent.width, m_surfaceExtent.height, 1);
 
-    VkImageMemoryBarrier generalToPresentSrc = createImageMemoryBarrier(swapchainImage, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    m_gpuProfiler->endPass(m_commandBuffers[frameIndex], frameIndex, GpuPass::RayTracing);
+
+    VkImageMemoryBarrier generalToFinal = createImageMemoryBarrier(targetImage, VK_IMAGE_LAYOUT_GENERAL, m_targetImageFinalLayout);
     vkCmdPipelineBarrier(m_commandBuffers[frameIndex], VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
-                         &generalToPresentSrc);
+                         &generalToFinal);
+
+    m_gpuProfiler->endFrame(m_commandBuffers[frameIndex], frameIndex);
 
     VK_CHECK(vkEndCommandBuffer(m_commandBuffers[frameIndex]));
+
+    return !acquired && !updatedTopLevel;
 }
 
-void Application::updateCameraAndPushData(const uint32_t& frameTime) {
+// Records the command buffer of frameIndex, unless the recording it already has can be submitted again
+void Application::prepareCommandBuffer(const uint32_t& frameIndex, const bool& rayTracing, const VkStridedBufferRegionKHR& raygenStridedBufferRegion,
+                                       const VkStridedBufferRegionKHR& closestHitStridedBufferRegion,
+                                       const VkStridedBufferRegionKHR& missStridedBufferRegion, const VkStridedBufferRegionKHR& callableBufferRegion) {
+    // Moved instances need a top level update, which only a new recording has
+    if (m_commandBuffersReusable[frameIndex] && !(rayTracing && m_topLevelInstancesChanged)) {
+        return;
+    }
+
+    vkResetCommandPool(m_device, m_commandPools[frameIndex], VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+
+    const bool reusable = rayTracing ? recordRayTracingCommandBuffer(frameIndex, raygenStridedBufferRegion, closestHitStridedBufferRegion,
+                                                                     missStridedBufferRegion, callableBufferRegion)
+                                     : recordRasterCommandBuffer(frameIndex);
+
+    m_commandBuffersReusable[frameIndex] = m_settings.reuseCommandBuffers && reusable;
+}
+
+void Application::updateCamera(const uint32_t& frameTime) {
     double mouseXInput;
     double mouseYInput;
 
@@ -1135,11 +1988,112 @@ void Application::updateCameraAndPushData(const uint32_t& frameTime) {
 
     m_camera.position += offset;
 
-    m_rasterPushData.cameraTransformation = glm::transpose(glm::translate(glm::identity<glm::mat4>(), -m_camera.position));
-    m_rasterPushData.cameraTransformation = glm::rotate(m_rasterPushData.cameraTransformation, static_cast<float>(m_camera.orientation.x), globalUp);
-    m_rasterPushData.cameraTransformation = glm::rotate(m_rasterPushData.cameraTransformation, static_cast<float>(m_camera.orientation.y), globalRight);
+    updateCameraData();
+}
+
+void Application::animateTopLevelInstances(const float& angle) {
+    const float cosine = std::cos(angle);
+    const float sine   = std::sin(angle);
+
+    // Instances hold the mesh's dequantization too, bottom level structures of quantized meshes are built from the raw SNORM positions.
+    // With rotation R, scale s and offset o, the transform is R * (s * p + o), so every column is scaled and the translation is R * o.
+    for (TopLevelInstance& instance : m_topLevelInstances) {
+        const glm::vec3& scale  = m_meshInfos[instance.customIndex].positionScale;
+        const glm::vec3& offset = m_meshInfos[instance.customIndex].positionOffset;
+
+        instance.transform = {{{cosine * scale.x, 0.0f, sine * scale.z, cosine * offset.x + sine * offset.z},
+                               {0.0f, scale.y, 0.0f, offset.y},
+                               {-sine * scale.x, 0.0f, cosine * scale.z, -sine * offset.x + cosine * offset.z}}};
+    }
+
+    m_topLevelInstancesChanged = true;
+}
+
+void Application::updateCameraData() {
+    m_cameraData.raster.cameraTransformation            = getCameraTransformation(m_camera);
+    m_cameraData.rayTracing.cameraTransformationInverse = glm::inverse(m_cameraData.raster.cameraTransformation);
+}
+
+// Only once the previous submission of the render target has retired, the buffer is host coherent
+void Application::writeCameraData(const uint32_t& frameIndex) const {
+    memcpy(m_cameraBuffers[frameIndex].allocation.mappedData, &m_cameraData, sizeof(CameraData));
+}
+
+// Frames wait on the uploads flushed so far and signal the next frame timeline value, the swapchain semaphores are only passed interactively
+void Application::submitFrame(const VkQueue& queue, const uint32_t& frameIndex, const uint32_t& commandBufferCount, const VkCommandBuffer* commandBuffers,
+                              const VkSemaphore& imageAvailableSemaphore, const VkSemaphore& renderFinishedSemaphore) {
+    const uint64_t frameValue = m_frameTimeline->getNextValue();
+
+    std::vector<VkSemaphore>          waitSemaphores = {m_uploader->getSemaphore()};
+    std::vector<VkPipelineStageFlags> waitStages     = {VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+    std::vector<uint64_t>             waitValues     = {m_uploader->getFlushedValue()};
+
+    std::vector<VkSemaphore> signalSemaphores = {m_frameTimeline->getSemaphore()};
+    std::vector<uint64_t>    signalValues     = {frameValue};
+
+    // Binary semaphore values are ignored
+    if (imageAvailableSemaphore != VK_NULL_HANDLE) {
+        waitSemaphores.push_back(imageAvailableSemaphore);
+        waitStages.push_back(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        waitValues.push_back(0);
+    }
+
+    if (renderFinishedSemaphore != VK_NULL_HANDLE) {
+        signalSemaphores.push_back(renderFinishedSemaphore);
+        signalValues.push_back(0);
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    timelineSemaphoreSubmitInfo.waitSemaphoreValueCount       = static_cast<uint32_t>(waitValues.size());
+    timelineSemaphoreSubmitInfo.pWaitSemaphoreValues          = waitValues.data();
+    timelineSemaphoreSubmitInfo.signalSemaphoreValueCount     = static_cast<uint32_t>(signalValues.size());
+    timelineSemaphoreSubmitInfo.pSignalSemaphoreValues        = signalValues.data();
+
+    VkSubmitInfo submitInfo         = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.pNext                = &timelineSemaphoreSubmitInfo;
+    submitInfo.waitSemaphoreCount   = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores      = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask    = waitStages.data();
+    submitInfo.commandBufferCount   = commandBufferCount;
+    submitInfo.pCommandBuffers      = commandBuffers;
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    submitInfo.pSignalSemaphores    = signalSemaphores.data();
+
+    ProfileZone submitZone("vkQueueSubmit");
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+    submitZone.end();
+
+    m_renderTargetFrameValues[frameIndex] = frameValue;
+    m_frameTimeline->markSubmitted();
+}
+
+// Appends setCount descriptor sets, all with the same layout, from a pool of their own
+void Application::allocateDescriptorSets(const uint32_t setCount) {
+    std::vector<VkDescriptorPoolSize> descriptorPoolSizes = {{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * setCount}, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setCount}};
+    if (m_rayTracingSupported) {
+        descriptorPoolSizes.push_back({VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, setCount});
+        descriptorPoolSizes.push_back({VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount});
+    }
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    descriptorPoolCreateInfo.poolSizeCount              = static_cast<uint32_t>(descriptorPoolSizes.size());
+    descriptorPoolCreateInfo.pPoolSizes                 = descriptorPoolSizes.data();
+    descriptorPoolCreateInfo.maxSets                    = setCount;
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, nullptr, &descriptorPool));
+    m_descriptorPools.push_back(descriptorPool);
+
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts(setCount, m_descriptorSetLayout);
 
-    m_rayTracingPushData.cameraTransformationInverse = glm::inverse(m_rasterPushData.cameraTransformation);
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    descriptorSetAllocateInfo.descriptorPool              = descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount          = setCount;
+    descriptorSetAllocateInfo.pSetLayouts                 = descriptorSetLayouts.data();
+
+    const size_t firstSet = m_descriptorSets.size();
+    m_descriptorSets.resize(firstSet + setCount);
+    VK_CHECK(vkAllocateDescriptorSets(m_device, &descriptorSetAllocateInfo, &m_descriptorSets[firstSet]));
 }
 
 void Application::updateSurfaceDependantStructures() {
@@ -1151,49 +2105,140 @@ void Application::updateSurfaceDependantStructures() {
         glfwWaitEvents();
     } while (width == 0 || height == 0);
 
-    vkDeviceWaitIdle(m_device);
+    m_latencyMonitor->retireSwapchain();
+
+    // Frames already submitted keep rendering into the old swapchain, depth image and framebuffers, so those are only destroyed once the last
+    // of them has completed. The render pass doesn't depend on the extent and is kept.
+    const uint64_t retireValue = m_frameTimeline->getSubmittedValue();
 
     for (VkFramebuffer& framebuffer : m_framebuffers) {
-        vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+        m_deletionQueue->retire(retireValue, framebuffer);
     }
 
-    vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+    for (const VkImageView& imageView : m_swapchain->getImageViews()) {
+        m_deletionQueue->retire(retireValue, imageView);
+    }
 
-    vkDestroyImageView(m_device, m_depthImageView, nullptr);
-    vkFreeMemory(m_device, m_depthImageMemory, nullptr);
-    vkDestroyImage(m_device, m_depthImage, nullptr);
+    m_deletionQueue->retire(retireValue, m_swapchain->get());
+    m_deletionQueue->retire(retireValue, m_depthImageView);
+    m_deletionQueue->retire(retireValue, m_depthImage, m_depthImageAllocation);
+
+    m_surfaceExtent                        = m_swapchain->update();
+    m_cameraData.raster.oneOverAspectRatio = static_cast<float>(m_surfaceExtent.height) / static_cast<float>(m_surfaceExtent.width);
+
+    m_commandBuffersReusable.assign(m_commandBuffersReusable.size(), false);
+    m_renderTargetDescriptorsStale.assign(m_renderTargetDescriptorsStale.size(), true);
+
+    addRenderTargets(m_swapchain->getImageCounts());
+
+    m_depthImage           = createImage(m_device, m_surfaceExtent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_FORMAT_D32_SFLOAT_S8_UINT);
+    m_depthImageAllocation = allocateImageMemory(m_device, *m_memoryAllocator, m_depthImage);
+    m_depthImageView = createImageView(m_device, m_depthImage, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    m_framebuffers = createFramebuffers();
+}
+
+// The swapchain image count can change with every resize. Targets beyond a smaller count are kept rather than destroyed, their last frames
+// may still be in flight and they come back into use when the count grows again. Added targets start with a stale render target descriptor.
+void Application::addRenderTargets(const uint32_t renderTargetCount) {
+    m_renderTargetCount = renderTargetCount;
+
+    const uint32_t firstTarget = static_cast<uint32_t>(m_descriptorSets.size());
+    if (renderTargetCount <= firstTarget) {
+        return;
+    }
 
-    m_surfaceExtent                     = m_swapchain->update();
-    m_rasterPushData.oneOverAspectRatio = static_cast<float>(m_surfaceExtent.height) / static_cast<float>(m_surfaceExtent.width);
+    allocateDescriptorSets(renderTargetCount - firstTarget);
 
-    VkDescriptorImageInfo descriptorSwapchainImageInfo = {};
-    descriptorSwapchainImageInfo.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
+    // Everything but the camera buffer is the same for every render target, so it's copied from the first set
+    std::array<VkCopyDescriptorSet, 4> copyDescriptorSets;
+    copyDescriptorSets.fill({VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET});
+
+    copyDescriptorSets[0].srcBinding      = 0; // 0 for vertex and 1 for index buffer
+    copyDescriptorSets[0].descriptorCount = 2;
+    copyDescriptorSets[1].srcBinding      = 4;
+    copyDescriptorSets[1].descriptorCount = 1;
+    copyDescriptorSets[2].srcBinding      = 5;
+    copyDescriptorSets[2].descriptorCount = 1;
+    copyDescriptorSets[3].srcBinding      = 2;
+    copyDescriptorSets[3].descriptorCount = 1;
+
+    for (VkCopyDescriptorSet& copyDescriptorSet : copyDescriptorSets) {
+        copyDescriptorSet.srcSet     = m_descriptorSets[0];
+        copyDescriptorSet.dstBinding = copyDescriptorSet.srcBinding;
+    }
+
+    const uint32_t copyDescriptorSetCount = m_rayTracingSupported ? static_cast<uint32_t>(copyDescriptorSets.size()) : 3;
+
+    VkDescriptorBufferInfo cameraDescriptorBufferInfo = {};
+    cameraDescriptorBufferInfo.offset                 = 0;
+    cameraDescriptorBufferInfo.range                  = sizeof(CameraData);
 
     VkWriteDescriptorSet writeDescriptorSet = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-    writeDescriptorSet.dstBinding           = 3;
+    writeDescriptorSet.dstBinding           = 6;
     writeDescriptorSet.dstArrayElement      = 0;
-    writeDescriptorSet.descriptorType       = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writeDescriptorSet.descriptorType       = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     writeDescriptorSet.descriptorCount      = 1;
-    writeDescriptorSet.pImageInfo           = &descriptorSwapchainImageInfo;
+    writeDescriptorSet.pBufferInfo          = &cameraDescriptorBufferInfo;
 
-    const std::vector<VkImageView>& swapchainImageViews = m_swapchain->getImageViews();
-    for (size_t i = 0; i < m_swapchainImageCount; ++i) {
-        descriptorSwapchainImageInfo.imageView = swapchainImageViews[i];
-        writeDescriptorSet.dstSet              = m_descriptorSets[i];
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    commandBufferAllocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount          = 1;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+
+    for (uint32_t i = firstTarget; i < renderTargetCount; ++i) {
+        m_cameraBuffers.push_back(createBuffer(m_device, *m_memoryAllocator, sizeof(CameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, MemoryUsage::Staging));
+
+        cameraDescriptorBufferInfo.buffer = m_cameraBuffers[i].buffer;
+        writeDescriptorSet.dstSet         = m_descriptorSets[i];
+        for (VkCopyDescriptorSet& copyDescriptorSet : copyDescriptorSets) {
+            copyDescriptorSet.dstSet = m_descriptorSets[i];
+        }
+
+        vkUpdateDescriptorSets(m_device, 1, &writeDescriptorSet, copyDescriptorSetCount, copyDescriptorSets.data());
+
+        m_commandPools.push_back(createCommandPool(m_device, m_graphicsQueueFamilyIndex));
+        commandBufferAllocateInfo.commandPool = m_commandPools[i];
 
-        vkUpdateDescriptorSets(m_device, 1, &writeDescriptorSet, 0, nullptr);
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VK_CHECK(vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &commandBuffer));
+        m_commandBuffers.push_back(commandBuffer);
+
+        VkSemaphore renderFinishedSemaphore = VK_NULL_HANDLE;
+        VK_CHECK(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &renderFinishedSemaphore));
+        m_renderFinishedSemaphores.push_back(renderFinishedSemaphore);
     }
 
-    m_depthImage = createImage(m_device, m_surfaceExtent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_FORMAT_D32_SFLOAT_S8_UINT);
-    VkMemoryRequirements depthImageMemoryRequirements;
-    vkGetImageMemoryRequirements(m_device, m_depthImage, &depthImageMemoryRequirements);
-    m_depthImageMemory =
-        allocateVulkanObjectMemory(m_device, depthImageMemoryRequirements, m_physicalDeviceMemoryProperties, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    vkBindImageMemory(m_device, m_depthImage, m_depthImageMemory, 0);
-    m_depthImageView = createImageView(m_device, m_depthImage, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_IMAGE_ASPECT_DEPTH_BIT);
+    m_commandBuffersReusable.resize(renderTargetCount, false);
+    m_renderTargetFrameValues.resize(renderTargetCount, 0);
+    m_renderTargetDescriptorsStale.resize(renderTargetCount, true);
 
-    m_renderPass   = createRenderPass();
-    m_framebuffers = createFramebuffers();
+    m_threadCommandPools->addRenderTargets(renderTargetCount);
+    m_gpuProfiler->addFrames(renderTargetCount);
+
+    if (m_rayTracingSupported) {
+        addTopAccelerationStructureFrames(m_device, *m_memoryAllocator, m_topLevelAccelerationStructure, renderTargetCount);
+    }
+}
+
+// The descriptor set of a render target may still be used by its last frame, so it's only pointed at the new image once that has completed
+void Application::writeRenderTargetDescriptor(const uint32_t& frameIndex) {
+    VkDescriptorImageInfo descriptorImageInfo = {};
+    descriptorImageInfo.imageView             = getRenderTargetImageViews()[frameIndex];
+    descriptorImageInfo.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet writeDescriptorSet = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    writeDescriptorSet.dstSet               = m_descriptorSets[frameIndex];
+    writeDescriptorSet.dstBinding           = 3;
+    writeDescriptorSet.dstArrayElement      = 0;
+    writeDescriptorSet.descriptorType       = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writeDescriptorSet.descriptorCount      = 1;
+    writeDescriptorSet.pImageInfo           = &descriptorImageInfo;
+
+    vkUpdateDescriptorSets(m_device, 1, &writeDescriptorSet, 0, nullptr);
+
+    m_renderTargetDescriptorsStale[frameIndex] = false;
 }
 
 #ifdef VALIDATION_ENABLED
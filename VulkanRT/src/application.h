@@ -2,10 +2,20 @@
 
 #include "common.h"
 
+#include "benchmark.h"
+#include "camera.h"
+#include "commandPools.h"
+#include "deletionQueue.h"
+#include "frameTimeline.h"
+#include "gpuProfiler.h"
+#include "jobSystem.h"
+#include "memoryAllocator.h"
 #include "rayTracing.h"
 #include "resources.h"
+#include "settings.h"
 #include "sharedStructures.h"
 #include "swapchain.h"
+#include "uploader.h"
 
 #pragma warning(push, 0)
 #define VK_ENABLE_BETA_EXTENSIONS
@@ -23,20 +33,18 @@
 #include <vector>
 
 struct GLFWwindow;
+class LatencyMonitor;
+class Scene;
 
 struct KeyState {
     bool    pressed     = false;
     uint8_t transitions = 0;
 };
 
-struct Camera {
-    glm::vec2 orientation = glm::vec2();
-    glm::vec3 position    = glm::vec3();
-    glm::vec3 velocity    = glm::vec3();
-};
-
 class Application {
   public:
+    Application(const Settings& settings);
+
     void run();
 
     std::map<int, KeyState> m_keyStates;
@@ -44,6 +52,8 @@ class Application {
     ~Application();
 
   private:
+    const Settings m_settings;
+
     GLFWwindow* window = nullptr;
 
     VkInstance               m_instance                 = VK_NULL_HANDLE;
@@ -52,59 +62,122 @@ class Application {
     VkPhysicalDevice         m_physicalDevice           = VK_NULL_HANDLE;
     VkDevice                 m_device                   = VK_NULL_HANDLE;
     VkRenderPass             m_renderPass               = VK_NULL_HANDLE;
-    VkDeviceMemory           m_depthImageMemory         = VK_NULL_HANDLE;
     VkImageView              m_depthImageView           = VK_NULL_HANDLE;
     VkImage                  m_depthImage               = VK_NULL_HANDLE;
-    VkDescriptorPool         m_descriptorPool           = VK_NULL_HANDLE;
     VkDescriptorSetLayout    m_descriptorSetLayout      = VK_NULL_HANDLE;
     VkPipelineCache          m_pipelineCache            = VK_NULL_HANDLE;
     VkPipelineLayout         m_rasterPipelineLayout     = VK_NULL_HANDLE;
     VkPipeline               m_rasterPipeline           = VK_NULL_HANDLE;
     VkPipelineLayout         m_rayTracingPipelineLayout = VK_NULL_HANDLE;
     VkPipeline               m_rayTracingPipeline       = VK_NULL_HANDLE;
-    VkCommandPool            m_transferCommandPool      = VK_NULL_HANDLE;
 
     VkExtent2D                       m_surfaceExtent                  = {};
+    VkFormat                         m_colorFormat                    = VK_FORMAT_UNDEFINED;
+    VkImageLayout                    m_targetImageFinalLayout         = VK_IMAGE_LAYOUT_UNDEFINED;
     VkPhysicalDeviceMemoryProperties m_physicalDeviceMemoryProperties = {};
 
-    std::unique_ptr<Swapchain> m_swapchain;
-
-    Buffer                m_vertexBuffer                     = {};
-    Buffer                m_indexBuffer                      = {};
-    Buffer                m_shaderBindingTableBuffer         = {};
-    AccelerationStructure m_topLevelAccelerationStructure    = {};
-    AccelerationStructure m_bottomLevelAccelerationStructure = {};
-
-    Camera             m_camera             = {};
-    RasterPushData     m_rasterPushData     = {};
-    RayTracingPushData m_rayTracingPushData = {};
-
-    std::vector<VkFramebuffer>   m_framebuffers;
-    std::vector<VkDescriptorSet> m_descriptorSets;
-    std::vector<VkCommandPool>   m_commandPools;
-    std::vector<VkCommandBuffer> m_commandBuffers;
-    std::vector<VkFence>         m_inFlightFences;
-    std::vector<VkSemaphore>     m_renderFinishedSemaphores;
-    std::vector<VkSemaphore>     m_imageAvailableSemaphores;
-
-    uint32_t m_queueFamilyIndex    = UINT32_MAX;
-    uint32_t m_swapchainImageCount = UINT32_MAX;
+    std::unique_ptr<Swapchain>          m_swapchain;
+    std::unique_ptr<MemoryAllocator>    m_memoryAllocator;
+    std::unique_ptr<Uploader>           m_uploader;
+    std::unique_ptr<GpuProfiler>        m_gpuProfiler;
+    std::unique_ptr<JobSystem>          m_jobSystem;
+    std::unique_ptr<ThreadCommandPools> m_threadCommandPools; // Raster passes are recorded into secondary command buffers on every thread
+    std::unique_ptr<FrameTimeline>      m_frameTimeline;
+    std::unique_ptr<LatencyMonitor>     m_latencyMonitor; // Only when presenting
+    std::unique_ptr<DeletionQueue>      m_deletionQueue;  // Objects replaced by a resize, until the frames using them have completed
+
+    Allocation                    m_depthImageAllocation          = {};
+    Buffer                        m_vertexBuffer                  = {};
+    Buffer                        m_indexBuffer                   = {};
+    Buffer                        m_meshInfoBuffer                = {};
+    Buffer                        m_normalBuffer                  = {};
+    Buffer                        m_shaderBindingTableBuffer      = {};
+    TopLevelAccelerationStructure m_topLevelAccelerationStructure = {};
+
+    Camera     m_camera     = {};
+    CameraData m_cameraData = {};
+
+    std::vector<AccelerationStructure> m_bottomLevelAccelerationStructures;
+    std::vector<TopLevelInstance>      m_topLevelInstances;
+    std::vector<MeshInfo>              m_meshInfos;
+    std::vector<VkImage>               m_offscreenImages;
+    std::vector<Allocation>            m_offscreenImageAllocations;
+    std::vector<VkImageView>           m_offscreenImageViews;
+    std::vector<VkFramebuffer>         m_framebuffers;
+    std::vector<VkDescriptorPool>      m_descriptorPools; // One for the first render targets, one more for the ones added by every resize
+    std::vector<VkDescriptorSet>       m_descriptorSets;
+    std::vector<Buffer>                m_cameraBuffers;
+    std::vector<VkCommandPool>         m_commandPools;
+    std::vector<VkCommandBuffer>       m_commandBuffers;
+    std::vector<bool>                  m_commandBuffersReusable; // Can be submitted again without being recorded, only with reuseCommandBuffers
+
+    std::vector<uint64_t>    m_renderTargetFrameValues;      // Frame timeline value of the last frame rendered into each target
+    std::vector<bool>        m_renderTargetDescriptorsStale; // The storage image binding still points at a retired swapchain image
+    std::vector<VkSemaphore> m_renderFinishedSemaphores;     // One per swapchain image
+    std::vector<VkSemaphore> m_imageAvailableSemaphores;     // One per frame in flight
+
+    std::vector<uint32_t> m_queueFamilyIndices; // Unique families with a queue, resources shared between queues are concurrent across these
+
+    uint32_t m_graphicsQueueFamilyIndex = UINT32_MAX;
+    uint32_t m_computeQueueFamilyIndex  = UINT32_MAX;
+    uint32_t m_transferQueueFamilyIndex = UINT32_MAX;
+    uint32_t m_renderTargetCount        = UINT32_MAX;
+    bool     m_rayTracingSupported      = false;
+    bool     m_presentWaitSupported     = false; // Presents are tagged with IDs and can be waited on
+    bool     m_topLevelInstancesChanged = false; // The next ray traced frame updates the top level structure
 
     const VkInstance                 createInstance() const;
     const uint32_t                   getGraphicsQueueFamilyIndex(const VkPhysicalDevice& physicalDevice) const;
+    const uint32_t                   getDedicatedQueueFamilyIndex(const VkPhysicalDevice& physicalDevice, const VkQueueFlags& requiredFlags,
+                                                                  const VkQueueFlags& excludedFlags) const;
+    const bool                       rayTracingSupported(const VkPhysicalDevice& physicalDevice) const;
+    const bool                       presentWaitSupported(const VkPhysicalDevice& physicalDevice) const;
     const VkPhysicalDevice           pickPhysicalDevice() const;
+    void                             createOffscreenImages();
+    const std::vector<VkImage>&      getRenderTargetImages() const;
+    const std::vector<VkImageView>&  getRenderTargetImageViews() const;
     const VkRenderPass               createRenderPass() const;
     const std::vector<VkFramebuffer> createFramebuffers() const;
     const VkShaderModule             loadShader(const char* pathToSource) const;
     const VkPipeline                 createRasterPipeline(const VkShaderModule& vertexShader, const VkShaderModule& fragmentShader) const;
     const VkPipeline                 createRayTracingPipeline(const VkShaderModule& raygenShaderModule, const VkShaderModule& closestHitShaderModule,
                                                               const VkShaderModule& missShaderModule) const;
-    void                             recordRasterCommandBuffer(const uint32_t& frameIndex, const uint32_t& indexCount) const;
-    void                             recordRayTracingCommandBuffer(const uint32_t& frameIndex, const VkStridedBufferRegionKHR& raygenStridedBufferRegion,
+    const bool                       recordRasterCommandBuffer(const uint32_t& frameIndex) const;
+    const bool                       recordRayTracingCommandBuffer(const uint32_t& frameIndex, const VkStridedBufferRegionKHR& raygenStridedBufferRegion,
                                                                    const VkStridedBufferRegionKHR& closestHitStridedBufferRegion, const VkStridedBufferRegionKHR& missStridedBufferRegion,
-                                                                   const VkStridedBufferRegionKHR& callableBufferRegion) const;
-    void                             updateCameraAndPushData(const uint32_t& frameTime);
+                                                                   const VkStridedBufferRegionKHR& callableBufferRegion);
+    void                             prepareCommandBuffer(const uint32_t& frameIndex, const bool& rayTracing,
+                                                          const VkStridedBufferRegionKHR& raygenStridedBufferRegion,
+                                                          const VkStridedBufferRegionKHR& closestHitStridedBufferRegion,
+                                                          const VkStridedBufferRegionKHR& missStridedBufferRegion,
+                                                          const VkStridedBufferRegionKHR& callableBufferRegion);
+    void                             runHeadless(const VkQueue& queue, const VkStridedBufferRegionKHR& raygenStridedBufferRegion,
+                                                 const VkStridedBufferRegionKHR& closestHitStridedBufferRegion,
+                                                 const VkStridedBufferRegionKHR& missStridedBufferRegion,
+                                                 const VkStridedBufferRegionKHR& callableBufferRegion);
+    void                             runValidation(const VkQueue& queue, const VkStridedBufferRegionKHR& raygenStridedBufferRegion,
+                                                   const VkStridedBufferRegionKHR& closestHitStridedBufferRegion,
+                                                   const VkStridedBufferRegionKHR& missStridedBufferRegion,
+                                                   const VkStridedBufferRegionKHR& callableBufferRegion, const Scene& scene);
+    void                             updateCamera(const uint32_t& frameTime);
+    void                             animateTopLevelInstances(const float& angle);
+    void                             updateCameraData();
+    void                             writeCameraData(const uint32_t& frameIndex) const;
+    void                             submitFrame(const VkQueue& queue, const uint32_t& frameIndex, const uint32_t& commandBufferCount,
+                                                 const VkCommandBuffer* commandBuffers, const VkSemaphore& imageAvailableSemaphore,
+                                                 const VkSemaphore& renderFinishedSemaphore);
+    void                             allocateDescriptorSets(const uint32_t setCount);
     void                             updateSurfaceDependantStructures();
+    void                             addRenderTargets(const uint32_t renderTargetCount);
+    void                             writeRenderTargetDescriptor(const uint32_t& frameIndex);
+
+    // Startup jobs, their data is defined next to them in application.cpp
+    static void loadShaderJob(void* data);
+    static void createRasterPipelineJob(void* data);
+    static void createRayTracingPipelineJob(void* data);
+
+    // Frame job, records a slice of the raster draws into a secondary command buffer of the thread it runs on
+    static void recordRasterSliceJob(void* data);
 
     static VkBool32 VKAPI_CALL debugUtilsCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageTypes,
                                                   const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* /*pUserData*/);
@@ -0,0 +1,45 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+static float getPercentile(std::vector<float> values, const float percentile) {
+    if (values.empty()) {
+        return 0.0f;
+    }
+
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(percentile * static_cast<float>(values.size() - 1) + 0.5f);
+    return values[index];
+}
+
+void writeFrameTimings(const char* path, const std::vector<FrameTiming>& frameTimings) {
+    FILE* file;
+    fopen_s(&file, path, "w");
+    if (!file) {
+        throw std::runtime_error(std::string("Couldn't open timings file ") + path + "!");
+    }
+
+    fprintf(file, "frame,cpu_frame_ms,cpu_record_ms,gpu_ms\n");
+
+    std::vector<float> cpuFrameTimes;
+    std::vector<float> gpuTimes;
+    for (const FrameTiming& frameTiming : frameTimings) {
+        fprintf(file, "%u,%.4f,%.4f,%.4f\n", frameTiming.frame, frameTiming.cpuFrameTime, frameTiming.cpuRecordTime, frameTiming.gpuTime);
+
+        cpuFrameTimes.push_back(frameTiming.cpuFrameTime);
+        if (frameTiming.gpuTime >= 0.0f) {
+            gpuTimes.push_back(frameTiming.gpuTime);
+        }
+    }
+
+    fclose(file);
+
+    printf("Wrote %u frame timings to %s\n", static_cast<uint32_t>(frameTimings.size()), path);
+    printf("CPU frame time: median %.3fms, p99 %.3fms\n", getPercentile(cpuFrameTimes, 0.5f), getPercentile(cpuFrameTimes, 0.99f));
+    if (!gpuTimes.empty()) {
+        printf("GPU frame time: median %.3fms, p99 %.3fms\n", getPercentile(gpuTimes, 0.5f), getPercentile(gpuTimes, 0.99f));
+    }
+}
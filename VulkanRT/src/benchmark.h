@@ -0,0 +1,15 @@
+#pragma once
+
+#include "common.h"
+
+#include <vector>
+
+struct FrameTiming {
+    uint32_t frame         = 0;
+    float    cpuFrameTime  = 0.0f;  // Milliseconds between the starts of two consecutive frames
+    float    cpuRecordTime = 0.0f;  // Milliseconds spent preparing and submitting the frame
+    float    gpuTime       = -1.0f; // Milliseconds between the first and last GPU timestamp, negative if unavailable
+};
+
+// Writes the timings as CSV with a header row, followed by a summary on stdout
+void writeFrameTimings(const char* path, const std::vector<FrameTiming>& frameTimings);
@@ -0,0 +1,478 @@
+#include "bvh.h"
+
+#include "meshImporter.h"
+#include "profiler.h"
+#include "tasks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#define BVH_MAX_BIN_COUNT       32
+#define BVH_MIN_BIN_COUNT       4 // Small nodes get about a bin per triangle, more would mostly stay empty
+#define BVH_TRAVERSAL_COST      1.0f // Relative to one triangle intersection
+#define BVH_INTERSECTION_COST   1.0f
+#define MIN_PARALLEL_BUILD_SIZE 65'536 // Triangles, smaller meshes are built by one core
+#define MIN_PARALLEL_BIN_SIZE   65'536
+#define SUBTREES_PER_WORKER     4 // More subtrees than workers even out their uneven sizes
+
+struct Aabb {
+    float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+};
+
+static void grow(Aabb& aabb, const float* point) {
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        aabb.min[axis] = std::min(aabb.min[axis], point[axis]);
+        aabb.max[axis] = std::max(aabb.max[axis], point[axis]);
+    }
+}
+
+static void grow(Aabb& aabb, const Aabb& other) {
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        aabb.min[axis] = std::min(aabb.min[axis], other.min[axis]);
+        aabb.max[axis] = std::max(aabb.max[axis], other.max[axis]);
+    }
+}
+
+// Empty and inverted bounds have no area
+static float getSurfaceArea(const Aabb& aabb) {
+    float extent[3];
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        extent[axis] = std::max(aabb.max[axis] - aabb.min[axis], 0.0f);
+    }
+
+    return 2.0f * (extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0]);
+}
+
+static Aabb getNodeBounds(const BvhNode& node) {
+    Aabb aabb;
+    std::copy(node.boundsMin, node.boundsMin + 3, aabb.min);
+    std::copy(node.boundsMax, node.boundsMax + 3, aabb.max);
+
+    return aabb;
+}
+
+// Triangles are partitioned as these, so the build never has to look at the mesh again
+struct BvhPrimitive {
+    Aabb     bounds;
+    float    centroid[3] = {};
+    uint32_t triangle    = 0;
+};
+
+struct PrimitiveTask {
+    const MeshView* meshView   = nullptr;
+    BvhPrimitive*   primitives = nullptr;
+    uint32_t        first      = 0;
+    uint32_t        last       = 0;
+};
+
+static void computePrimitives(PrimitiveTask& task) {
+    const float* vertices = static_cast<const float*>(task.meshView->vertices);
+
+    for (uint32_t triangle = task.first; triangle < task.last; ++triangle) {
+        BvhPrimitive& primitive = task.primitives[triangle];
+        primitive.triangle      = triangle;
+
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            grow(primitive.bounds, &vertices[3 * static_cast<uint64_t>(getIndex(*task.meshView, 3 * static_cast<uint64_t>(triangle) + corner))]);
+        }
+
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            primitive.centroid[axis] = 0.5f * (primitive.bounds.min[axis] + primitive.bounds.max[axis]);
+        }
+    }
+}
+
+struct BvhBin {
+    Aabb     bounds;
+    uint32_t count = 0;
+};
+
+// Bounds of a range of primitives and of their centroids, then the primitives binned by centroid along every axis
+struct BinningTask {
+    const BvhPrimitive* primitives = nullptr;
+    uint32_t            first      = 0;
+    uint32_t            last       = 0;
+    Aabb                bounds;
+    Aabb                centroidBounds;
+    uint32_t            binCount     = BVH_MAX_BIN_COUNT;
+    float               binOrigin[3] = {};
+    float               binScale[3]  = {};
+    BvhBin              bins[3][BVH_MAX_BIN_COUNT];
+};
+
+static uint32_t getBin(const float centroid, const float binOrigin, const float binScale, const uint32_t binCount) {
+    return std::min(static_cast<uint32_t>((centroid - binOrigin) * binScale), binCount - 1);
+}
+
+static void computeRangeBounds(BinningTask& task) {
+    for (uint32_t i = task.first; i < task.last; ++i) {
+        grow(task.bounds, task.primitives[i].bounds);
+        grow(task.centroidBounds, task.primitives[i].centroid);
+    }
+}
+
+static void binPrimitives(BinningTask& task) {
+    for (uint32_t i = task.first; i < task.last; ++i) {
+        const BvhPrimitive& primitive = task.primitives[i];
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            BvhBin& bin = task.bins[axis][getBin(primitive.centroid[axis], task.binOrigin[axis], task.binScale[axis], task.binCount)];
+            grow(bin.bounds, primitive.bounds);
+            ++bin.count;
+        }
+    }
+}
+
+struct BvhSubtree {
+    uint32_t node  = 0;
+    uint32_t first = 0;
+    uint32_t last  = 0;
+};
+
+struct SubtreeLarger {
+    bool operator()(const BvhSubtree& a, const BvhSubtree& b) const { return a.last - a.first > b.last - b.first; }
+};
+
+struct BvhBuilder {
+    JobSystem*                jobSystem = nullptr;
+    std::vector<BvhPrimitive> primitives;
+    std::vector<BvhNode>      nodes;
+    std::atomic<uint32_t>     nodeCount = 1;
+
+    // Ranges smaller than this are left to a single worker once the upper levels are done
+    uint32_t                maxSubtreeSize = UINT32_MAX;
+    std::vector<BvhSubtree> subtrees;
+    std::atomic<size_t>     nextSubtree = 0;
+};
+
+struct BinLess {
+    float    binOrigin = 0.0f;
+    float    binScale  = 0.0f;
+    uint32_t binCount  = 0;
+    uint32_t axis      = 0;
+    uint32_t splitBin  = 0;
+
+    bool operator()(const BvhPrimitive& primitive) const { return getBin(primitive.centroid[axis], binOrigin, binScale, binCount) < splitBin; }
+};
+
+// Runs one binning pass over a range, spread over the job system when the range is large enough to pay for the jobs
+static void runBinningPass(JobSystem& jobSystem, void (*function)(BinningTask&), std::vector<BinningTask>& tasks, BinningTask& result,
+                           const bool parallel) {
+    const uint32_t count     = result.last - result.first;
+    const uint32_t taskCount = parallel ? getTaskCount(jobSystem, count, MIN_PARALLEL_BIN_SIZE) : 1;
+    if (taskCount == 1) {
+        function(result);
+        return;
+    }
+
+    tasks.assign(taskCount, result);
+    for (uint32_t i = 0; i < taskCount; ++i) {
+        tasks[i].first = result.first + static_cast<uint32_t>(static_cast<uint64_t>(count) * i / taskCount);
+        tasks[i].last  = result.first + static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / taskCount);
+    }
+
+    runTasks(jobSystem, function, tasks);
+
+    for (const BinningTask& task : tasks) {
+        grow(result.bounds, task.bounds);
+        grow(result.centroidBounds, task.centroidBounds);
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            for (uint32_t bin = 0; bin < result.binCount; ++bin) {
+                grow(result.bins[axis][bin].bounds, task.bins[axis][bin].bounds);
+                result.bins[axis][bin].count += task.bins[axis][bin].count;
+            }
+        }
+    }
+}
+
+// Fills in the node as a leaf over the range, then partitions the range and returns where the second child starts if splitting pays off.
+// Returns last if the node stays a leaf. Kept apart from the recursion, so the bins are off the stack again before the children are built.
+static uint32_t splitNode(BvhBuilder& builder, const uint32_t nodeIndex, const uint32_t first, const uint32_t last, const bool parallel) {
+    const uint32_t count = last - first;
+
+    BinningTask              binning;
+    std::vector<BinningTask> tasks;
+    binning.primitives = builder.primitives.data();
+    binning.first      = first;
+    binning.last       = last;
+    runBinningPass(*builder.jobSystem, computeRangeBounds, tasks, binning, parallel);
+
+    BvhNode& node = builder.nodes[nodeIndex];
+    std::copy(binning.bounds.min, binning.bounds.min + 3, node.boundsMin);
+    std::copy(binning.bounds.max, binning.bounds.max + 3, node.boundsMax);
+    node.offset        = first;
+    node.triangleCount = count;
+
+    if (count == 1) {
+        return last;
+    }
+
+    // Primitives whose centroids all coincide can't be binned, they're split in half if they don't fit a leaf
+    bool binnable    = false;
+    binning.binCount = std::clamp(count, static_cast<uint32_t>(BVH_MIN_BIN_COUNT), static_cast<uint32_t>(BVH_MAX_BIN_COUNT));
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        float extent            = binning.centroidBounds.max[axis] - binning.centroidBounds.min[axis];
+        binning.binOrigin[axis] = binning.centroidBounds.min[axis];
+        binning.binScale[axis]  = extent > 0.0f ? static_cast<float>(binning.binCount) / extent : 0.0f;
+        binnable |= extent > 0.0f;
+    }
+
+    float    bestCost = FLT_MAX;
+    uint32_t bestAxis = 0;
+    uint32_t bestBin  = 0;
+    if (binnable) {
+        runBinningPass(*builder.jobSystem, binPrimitives, tasks, binning, parallel);
+
+        // Sweeps the bins from the right to get the cost of every split plane in one pass from the left
+        const float parentArea = getSurfaceArea(binning.bounds);
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            float    rightAreas[BVH_MAX_BIN_COUNT]  = {};
+            uint32_t rightCounts[BVH_MAX_BIN_COUNT] = {};
+
+            Aabb     rightBounds;
+            uint32_t rightCount = 0;
+            for (uint32_t bin = binning.binCount - 1; bin > 0; --bin) {
+                grow(rightBounds, binning.bins[axis][bin].bounds);
+                rightCount += binning.bins[axis][bin].count;
+                rightAreas[bin]  = getSurfaceArea(rightBounds);
+                rightCounts[bin] = rightCount;
+            }
+
+            Aabb     leftBounds;
+            uint32_t leftCount = 0;
+            for (uint32_t bin = 1; bin < binning.binCount; ++bin) {
+                grow(leftBounds, binning.bins[axis][bin - 1].bounds);
+                leftCount += binning.bins[axis][bin - 1].count;
+                if (leftCount == 0 || rightCounts[bin] == 0) {
+                    continue;
+                }
+
+                float leftCost  = getSurfaceArea(leftBounds) * static_cast<float>(leftCount);
+                float rightCost = rightAreas[bin] * static_cast<float>(rightCounts[bin]);
+                float cost      = BVH_TRAVERSAL_COST + BVH_INTERSECTION_COST * (leftCost + rightCost) / parentArea;
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin  = bin;
+                }
+            }
+        }
+    }
+
+    if (count <= BVH_MAX_LEAF_SIZE && bestCost >= BVH_INTERSECTION_COST * static_cast<float>(count)) {
+        return last;
+    }
+
+    if (bestCost == FLT_MAX) {
+        return first + count / 2;
+    }
+
+    BinLess binLess = {binning.binOrigin[bestAxis], binning.binScale[bestAxis], binning.binCount, bestAxis, bestBin};
+    return static_cast<uint32_t>(std::partition(&builder.primitives[first], &builder.primitives[first] + count, binLess) - &builder.primitives[0]);
+}
+
+static void buildNode(BvhBuilder& builder, const uint32_t nodeIndex, const uint32_t first, const uint32_t last, const bool upperLevel) {
+    if (upperLevel && last - first <= builder.maxSubtreeSize) {
+        builder.subtrees.push_back({nodeIndex, first, last});
+        return;
+    }
+
+    const uint32_t middle = splitNode(builder, nodeIndex, first, last, upperLevel);
+    if (middle == last) {
+        return;
+    }
+
+    const uint32_t children                = builder.nodeCount.fetch_add(2);
+    builder.nodes[nodeIndex].offset        = children;
+    builder.nodes[nodeIndex].triangleCount = 0;
+
+    buildNode(builder, children, first, middle, upperLevel);
+    buildNode(builder, children + 1, middle, last, upperLevel);
+}
+
+struct SubtreeTask {
+    BvhBuilder* builder = nullptr;
+};
+
+// Subtrees are handed out largest first, so the last ones picked up are the small ones
+static void buildSubtrees(SubtreeTask& task) {
+    for (size_t i = task.builder->nextSubtree++; i < task.builder->subtrees.size(); i = task.builder->nextSubtree++) {
+        const BvhSubtree& subtree = task.builder->subtrees[i];
+        buildNode(*task.builder, subtree.node, subtree.first, subtree.last, false);
+    }
+}
+
+Bvh buildBvh(JobSystem& jobSystem, const MeshView& meshView) {
+    PROFILE_ZONE("buildBvh");
+
+    Bvh bvh;
+
+    const uint32_t triangleCount = meshView.entry->indexCount / 3;
+    if (triangleCount == 0) {
+        return bvh;
+    }
+
+    BvhBuilder builder;
+    builder.jobSystem = &jobSystem;
+    builder.primitives.resize(triangleCount);
+    builder.nodes.resize(2 * static_cast<size_t>(triangleCount) - 1);
+
+    std::vector<PrimitiveTask> primitiveTasks(getTaskCount(jobSystem, triangleCount, MIN_PARALLEL_BIN_SIZE));
+    for (uint32_t i = 0; i < primitiveTasks.size(); ++i) {
+        primitiveTasks[i].meshView   = &meshView;
+        primitiveTasks[i].primitives = builder.primitives.data();
+        primitiveTasks[i].first      = static_cast<uint32_t>(static_cast<uint64_t>(triangleCount) * i / primitiveTasks.size());
+        primitiveTasks[i].last       = static_cast<uint32_t>(static_cast<uint64_t>(triangleCount) * (i + 1) / primitiveTasks.size());
+    }
+
+    runTasks(jobSystem, computePrimitives, primitiveTasks);
+
+    const uint32_t workerCount = getTaskCount(jobSystem, triangleCount, MIN_PARALLEL_BUILD_SIZE);
+    if (workerCount > 1) {
+        builder.maxSubtreeSize = std::max(triangleCount / (workerCount * SUBTREES_PER_WORKER), static_cast<uint32_t>(BVH_MAX_LEAF_SIZE));
+        buildNode(builder, 0, 0, triangleCount, true);
+
+        std::sort(builder.subtrees.begin(), builder.subtrees.end(), SubtreeLarger());
+
+        std::vector<SubtreeTask> subtreeTasks(workerCount);
+        for (SubtreeTask& subtreeTask : subtreeTasks) {
+            subtreeTask.builder = &builder;
+        }
+
+        runTasks(jobSystem, buildSubtrees, subtreeTasks);
+    } else {
+        buildNode(builder, 0, 0, triangleCount, false);
+    }
+
+    builder.nodes.resize(builder.nodeCount);
+    bvh.nodes = std::move(builder.nodes);
+
+    bvh.triangles.resize(triangleCount);
+    for (uint32_t i = 0; i < triangleCount; ++i) {
+        bvh.triangles[i] = builder.primitives[i].triangle;
+    }
+
+    return bvh;
+}
+
+BvhStats measureBvh(const Bvh& bvh) {
+    BvhStats stats;
+    if (bvh.nodes.empty()) {
+        return stats;
+    }
+
+    stats.nodeCount = static_cast<uint32_t>(bvh.nodes.size());
+
+    const float rootArea = getSurfaceArea(getNodeBounds(bvh.nodes[0]));
+
+    double   sahCost       = 0.0;
+    double   overlapSum    = 0.0;
+    uint64_t leafDepthSum  = 0;
+    uint32_t interiorCount = 0;
+
+    // Node index and depth
+    std::vector<std::pair<uint32_t, uint32_t>> stack = {{0, 0}};
+    while (!stack.empty()) {
+        const uint32_t nodeIndex = stack.back().first;
+        const uint32_t depth     = stack.back().second;
+        stack.pop_back();
+
+        const BvhNode& node   = bvh.nodes[nodeIndex];
+        const Aabb     bounds = getNodeBounds(node);
+        const double   area   = rootArea > 0.0f ? getSurfaceArea(bounds) / rootArea : 1.0; // Relative to the root
+
+        stats.maxDepth = std::max(stats.maxDepth, depth);
+
+        if (node.triangleCount > 0) {
+            sahCost += BVH_INTERSECTION_COST * static_cast<double>(node.triangleCount) * area;
+            leafDepthSum += depth;
+            ++stats.leafCount;
+            ++stats.leafSizes[std::min(node.triangleCount, static_cast<uint32_t>(BVH_MAX_LEAF_SIZE))];
+            continue;
+        }
+
+        sahCost += BVH_TRAVERSAL_COST * area;
+        ++interiorCount;
+
+        Aabb overlap = getNodeBounds(bvh.nodes[node.offset]);
+        Aabb right   = getNodeBounds(bvh.nodes[node.offset + 1]);
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            overlap.min[axis] = std::max(overlap.min[axis], right.min[axis]);
+            overlap.max[axis] = std::min(overlap.max[axis], right.max[axis]);
+        }
+
+        // Siblings that only touch along an axis share no volume, even though a plane between them has an area
+        bool disjoint = false;
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            disjoint |= overlap.min[axis] > overlap.max[axis];
+        }
+
+        const float parentArea = getSurfaceArea(bounds);
+        if (!disjoint && parentArea > 0.0f) {
+            overlapSum += getSurfaceArea(overlap) / parentArea;
+        }
+
+        stack.push_back({node.offset, depth + 1});
+        stack.push_back({node.offset + 1, depth + 1});
+    }
+
+    stats.sahCost          = static_cast<float>(sahCost);
+    stats.averageOverlap   = interiorCount > 0 ? static_cast<float>(overlapSum / interiorCount) : 0.0f;
+    stats.averageLeafDepth = static_cast<float>(static_cast<double>(leafDepthSum) / stats.leafCount);
+
+    return stats;
+}
+
+void printBvhReport(const char* meshPath, const bool splitMeshes) {
+    JobSystem jobSystem(std::max(1u, std::thread::hardware_concurrency()));
+
+    std::string meshFilePath = meshPath;
+    if (isImportableMesh(meshFilePath.c_str())) {
+        meshFilePath = importMeshCached(jobSystem, meshFilePath.c_str(), splitMeshes);
+    }
+
+    MeshFile meshFile(meshFilePath.c_str());
+    if (meshFile.getMeshCount() == 0) {
+        throw std::runtime_error(std::string("Mesh file ") + meshPath + " contains no meshes!");
+    }
+
+    uint64_t totalTriangleCount = 0;
+    double   totalBuildTime     = 0.0;
+
+    printf("BVH report for %s, %u threads\n", meshPath, jobSystem.getThreadCount());
+
+    for (uint32_t i = 0; i < meshFile.getMeshCount(); ++i) {
+        const MeshView meshView      = meshFile.getMesh(i);
+        const uint32_t triangleCount = meshView.entry->indexCount / 3;
+
+        auto     start     = std::chrono::high_resolution_clock::now();
+        Bvh      bvh       = buildBvh(jobSystem, meshView);
+        auto     end       = std::chrono::high_resolution_clock::now();
+        double   buildTime = std::chrono::duration<double>(end - start).count();
+        BvhStats stats     = measureBvh(bvh);
+
+        totalTriangleCount += triangleCount;
+        totalBuildTime += buildTime;
+
+        printf("Mesh %u: %u triangles, %u nodes, %u leaves, %.2f KB\n", i, triangleCount, stats.nodeCount, stats.leafCount,
+               static_cast<double>(bvh.nodes.size() * sizeof(BvhNode) + bvh.triangles.size() * sizeof(uint32_t)) / 1024.0);
+        printf("    SAH cost %.2f, sibling overlap %.2f%%, depth %u max %.1f average\n", stats.sahCost, stats.averageOverlap * 100.0f,
+               stats.maxDepth, stats.averageLeafDepth);
+
+        printf("    Leaf sizes:");
+        for (uint32_t size = 1; size <= BVH_MAX_LEAF_SIZE; ++size) {
+            printf(" %u:%u", size, stats.leafSizes[size]);
+        }
+
+        printf("\n    Built in %.2f ms, %.2f Mtris/s\n", buildTime * 1000.0, buildTime > 0.0 ? triangleCount / buildTime / 1e6 : 0.0);
+    }
+
+    printf("Total: %llu triangles built in %.2f ms, %.2f Mtris/s\n", static_cast<unsigned long long>(totalTriangleCount), totalBuildTime * 1000.0,
+           totalBuildTime > 0.0 ? static_cast<double>(totalTriangleCount) / totalBuildTime / 1e6 : 0.0);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common.h"
+
+#include "jobSystem.h"
+#include "meshFile.h"
+
+#include <vector>
+
+// Leaves never hold more triangles than this, larger ranges are always split
+#define BVH_MAX_LEAF_SIZE 8
+
+// Binary, with the two children of an interior node stored next to each other
+struct BvhNode {
+    float    boundsMin[3]  = {};
+    uint32_t offset        = 0; // First child of interior nodes, first entry in Bvh::triangles of leaves
+    float    boundsMax[3]  = {};
+    uint32_t triangleCount = 0; // Zero for interior nodes
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode is meant to fill half a cache line");
+
+struct Bvh {
+    std::vector<BvhNode>  nodes; // Root first, empty for meshes without triangles
+    std::vector<uint32_t> triangles;
+};
+
+struct BvhStats {
+    uint32_t nodeCount        = 0;
+    uint32_t leafCount        = 0;
+    uint32_t maxDepth         = 0;
+    float    averageLeafDepth = 0.0f;
+    float    sahCost          = 0.0f; // Expected cost of a random ray hitting the root, in triangle intersections
+    float    averageOverlap   = 0.0f; // Surface area shared by sibling bounds relative to their parent, averaged over interior nodes
+
+    // Leaf count by triangle count
+    uint32_t leafSizes[BVH_MAX_LEAF_SIZE + 1] = {};
+};
+
+// Binned SAH build over the triangles of a mesh. Upper levels bin on every thread of the job system, lower subtrees are built by one thread each.
+Bvh buildBvh(JobSystem& jobSystem, const MeshView& meshView);
+
+BvhStats measureBvh(const Bvh& bvh);
+
+// Builds a BVH for every mesh in the file, importing it first if needed, and prints its quality and build throughput. Doesn't need a GPU.
+void printBvhReport(const char* meshPath, const bool splitMeshes);
@@ -0,0 +1,103 @@
+#include "camera.h"
+
+#pragma warning(push, 0)
+#include "glm/gtx/rotate_vector.hpp"
+#pragma warning(pop)
+
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+std::vector<CameraKeyframe> loadCameraPath(const char* path) {
+    FILE* file;
+    fopen_s(&file, path, "r");
+    if (!file) {
+        throw std::runtime_error(std::string("Couldn't open camera path ") + path + "!");
+    }
+
+    std::vector<CameraKeyframe> cameraPath;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+
+        CameraKeyframe keyframe = {};
+        int            parsed   = sscanf_s(line, "%u %f %f %f %f %f", &keyframe.frame, &keyframe.position.x, &keyframe.position.y, &keyframe.position.z,
+                                  &keyframe.orientation.x, &keyframe.orientation.y);
+        if (parsed != 6) {
+            fclose(file);
+            throw std::runtime_error(std::string("Malformed camera path line: ") + line);
+        }
+
+        if (!cameraPath.empty() && keyframe.frame <= cameraPath.back().frame) {
+            fclose(file);
+            throw std::runtime_error("Camera path keyframes have to be sorted by frame!");
+        }
+
+        cameraPath.push_back(keyframe);
+    }
+
+    fclose(file);
+
+    if (cameraPath.empty()) {
+        throw std::runtime_error(std::string("Camera path ") + path + " contains no keyframes!");
+    }
+
+    return cameraPath;
+}
+
+std::vector<CameraKeyframe> createOrbitCameraPath(const uint32_t frameCount, const float radius) {
+    // One full orbit around the origin, looking at it, with a keyframe every few degrees
+    const uint32_t keyframeCount = 72;
+
+    std::vector<CameraKeyframe> cameraPath(keyframeCount + 1);
+    for (uint32_t i = 0; i <= keyframeCount; ++i) {
+        float angle = 2.0f * PI * static_cast<float>(i) / static_cast<float>(keyframeCount);
+
+        cameraPath[i].frame       = static_cast<uint32_t>(static_cast<uint64_t>(frameCount) * i / keyframeCount);
+        cameraPath[i].position    = glm::vec3(-sinf(angle) * radius, 0.0f, cosf(angle) * radius);
+        cameraPath[i].orientation = glm::vec2(angle, 0.0f);
+    }
+
+    return cameraPath;
+}
+
+Camera sampleCameraPath(const std::vector<CameraKeyframe>& cameraPath, const uint32_t frame) {
+    assert(!cameraPath.empty());
+
+    size_t next = 0;
+    while (next < cameraPath.size() && cameraPath[next].frame <= frame) {
+        ++next;
+    }
+
+    Camera camera = {};
+    if (next == 0 || next == cameraPath.size()) {
+        const CameraKeyframe& keyframe = next == 0 ? cameraPath.front() : cameraPath.back();
+        camera.position                = keyframe.position;
+        camera.orientation             = keyframe.orientation;
+        return camera;
+    }
+
+    const CameraKeyframe& from = cameraPath[next - 1];
+    const CameraKeyframe& to   = cameraPath[next];
+
+    float t            = static_cast<float>(frame - from.frame) / static_cast<float>(to.frame - from.frame);
+    camera.position    = from.position + (to.position - from.position) * t;
+    camera.orientation = from.orientation + (to.orientation - from.orientation) * t;
+
+    return camera;
+}
+
+glm::mat4 getCameraTransformation(const Camera& camera) {
+    glm::vec3 globalUp    = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec3 globalRight = glm::vec3(1.0f, 0.0f, 0.0f);
+
+    glm::mat4 cameraTransformation = glm::transpose(glm::translate(glm::identity<glm::mat4>(), -camera.position));
+    cameraTransformation           = glm::rotate(cameraTransformation, static_cast<float>(camera.orientation.x), globalUp);
+    cameraTransformation           = glm::rotate(cameraTransformation, static_cast<float>(camera.orientation.y), globalRight);
+
+    return cameraTransformation;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "common.h"
+
+#pragma warning(push, 0)
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_XYZW_ONLY
+#include "glm/fwd.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+#pragma warning(pop)
+
+#include <vector>
+
+#define PI 3.1415926535897932384f
+
+#define FOV                 glm::radians(100.0f)
+#define ORBIT_CAMERA_RADIUS 2.5f // The orbit camera path circles the origin at this distance
+
+struct Camera {
+    glm::vec2 orientation = glm::vec2();
+    glm::vec3 position    = glm::vec3();
+    glm::vec3 velocity    = glm::vec3();
+};
+
+struct CameraKeyframe {
+    uint32_t  frame       = 0;
+    glm::vec3 position    = glm::vec3();
+    glm::vec2 orientation = glm::vec2();
+};
+
+// Text format, one keyframe per line: frame positionX positionY positionZ yaw pitch
+// Lines starting with # are ignored, keyframes have to be sorted by frame.
+std::vector<CameraKeyframe> loadCameraPath(const char* path);
+std::vector<CameraKeyframe> createOrbitCameraPath(const uint32_t frameCount, const float radius);
+Camera                      sampleCameraPath(const std::vector<CameraKeyframe>& cameraPath, const uint32_t frame);
+
+glm::mat4 getCameraTransformation(const Camera& camera);
@@ -9,4 +9,58 @@ VkCommandPool createCommandPool(const VkDevice device, const uint32_t queueFamil
     VK_CHECK(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool));
 
     return commandPool;
-}
\ No newline at end of file
+}
+
+ThreadCommandPools::ThreadCommandPools(const VkDevice device, const uint32_t queueFamilyIndex, const uint32_t renderTargetCount,
+                                       const uint32_t threadCount)
+    : m_device(device), m_queueFamilyIndex(queueFamilyIndex), m_threadCount(threadCount) {
+    addRenderTargets(renderTargetCount);
+}
+
+ThreadCommandPools::~ThreadCommandPools() {
+    for (ThreadCommandPool& pool : m_pools) {
+        vkDestroyCommandPool(m_device, pool.commandPool, nullptr);
+    }
+}
+
+void ThreadCommandPools::addRenderTargets(const uint32_t renderTargetCount) {
+    const size_t firstPool = m_pools.size();
+    if (static_cast<size_t>(renderTargetCount) * m_threadCount <= firstPool) {
+        return;
+    }
+
+    m_pools.resize(static_cast<size_t>(renderTargetCount) * m_threadCount);
+    for (size_t i = firstPool; i < m_pools.size(); ++i) {
+        m_pools[i].commandPool = createCommandPool(m_device, m_queueFamilyIndex);
+    }
+}
+
+void ThreadCommandPools::reset(const uint32_t frameIndex) {
+    for (uint32_t thread = 0; thread < m_threadCount; ++thread) {
+        ThreadCommandPool& pool = m_pools[static_cast<size_t>(frameIndex) * m_threadCount + thread];
+        if (pool.usedCount == 0) {
+            continue;
+        }
+
+        // Without releasing resources, the next frame records about as much again
+        VK_CHECK(vkResetCommandPool(m_device, pool.commandPool, 0));
+        pool.usedCount = 0;
+    }
+}
+
+const VkCommandBuffer ThreadCommandPools::getSecondaryCommandBuffer(const uint32_t frameIndex, const uint32_t threadIndex) {
+    ThreadCommandPool& pool = m_pools[static_cast<size_t>(frameIndex) * m_threadCount + threadIndex];
+
+    if (pool.usedCount == pool.commandBuffers.size()) {
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        commandBufferAllocateInfo.commandPool                 = pool.commandPool;
+        commandBufferAllocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        commandBufferAllocateInfo.commandBufferCount          = 1;
+
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VK_CHECK(vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &commandBuffer));
+        pool.commandBuffers.push_back(commandBuffer);
+    }
+
+    return pool.commandBuffers[pool.usedCount++];
+}
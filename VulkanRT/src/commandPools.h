@@ -7,4 +7,35 @@
 #include "volk.h"
 #pragma warning(pop)
 
-VkCommandPool createCommandPool(const VkDevice device, const uint32_t queueFamilyIndex);
\ No newline at end of file
+#include <vector>
+
+VkCommandPool createCommandPool(const VkDevice device, const uint32_t queueFamilyIndex);
+
+// A transient pool for every thread of a job system and every render target, so threads record secondary command buffers without locking.
+// Buffers are kept across frames and handed out again once the pools of their render target are reset.
+class ThreadCommandPools {
+  public:
+    ThreadCommandPools(const VkDevice device, const uint32_t queueFamilyIndex, const uint32_t renderTargetCount, const uint32_t threadCount);
+    ~ThreadCommandPools();
+
+    // Creates the pools of render targets up to renderTargetCount, for render targets added after construction
+    void addRenderTargets(const uint32_t renderTargetCount);
+
+    // Only once the previous submission of the render target has retired
+    void reset(const uint32_t frameIndex);
+
+    // From the pool of threadIndex, only that thread may record into it until the next reset
+    const VkCommandBuffer getSecondaryCommandBuffer(const uint32_t frameIndex, const uint32_t threadIndex);
+
+  private:
+    struct ThreadCommandPool {
+        VkCommandPool                commandPool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> commandBuffers;
+        uint32_t                     usedCount = 0;
+    };
+
+    const VkDevice                 m_device;
+    const uint32_t                 m_queueFamilyIndex;
+    const uint32_t                 m_threadCount;
+    std::vector<ThreadCommandPool> m_pools; // Thread pools of the first render target, then of the second and so on
+};
@@ -0,0 +1,461 @@
+#include "cpuRayTracer.h"
+
+#include "bvh.h"
+#include "camera.h"
+#include "profiler.h"
+#include "scene.h"
+
+#pragma warning(push, 0)
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_XYZW_ONLY
+#include "glm/fwd.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/matrix.hpp"
+#include "glm/trigonometric.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#pragma warning(pop)
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <xmmintrin.h>
+
+#define TILE_SIZE            16 // Pixels along each side
+#define TRAVERSAL_STACK_SIZE 256
+#define INVALID_CHILD        UINT32_MAX
+
+// Same as raygenShader.rgen
+#define RAY_T_MIN 0.0001f
+#define RAY_T_MAX 1000.0f
+
+static float getSurfaceArea(const BvhNode& node) {
+    float extent[3];
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        extent[axis] = node.boundsMax[axis] - node.boundsMin[axis];
+    }
+
+    return extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0];
+}
+
+// Pulls up the children of the largest interior slots until the node has four slots or only leaves are left.
+// traversalStackSize is set to the most entries traversing the collapsed subtree can push, whichever order the ray visits children in.
+static uint32_t collapseNode(const Bvh& bvh, const uint32_t binaryNode, std::vector<CpuBvhNode>& nodes, uint32_t& traversalStackSize) {
+    uint32_t slots[4]  = {binaryNode};
+    uint32_t slotCount = 1;
+    while (slotCount < 4) {
+        uint32_t largestSlot = INVALID_CHILD;
+        float    largestArea = -1.0f;
+        for (uint32_t slot = 0; slot < slotCount; ++slot) {
+            const BvhNode& node = bvh.nodes[slots[slot]];
+            if (node.triangleCount == 0 && getSurfaceArea(node) > largestArea) {
+                largestSlot = slot;
+                largestArea = getSurfaceArea(node);
+            }
+        }
+
+        if (largestSlot == INVALID_CHILD) {
+            break;
+        }
+
+        const uint32_t firstChild = bvh.nodes[slots[largestSlot]].offset;
+        slots[largestSlot]        = firstChild;
+        slots[slotCount++]        = firstChild + 1;
+    }
+
+    const uint32_t nodeIndex = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    CpuBvhNode& node = nodes.back();
+    for (uint32_t slot = 0; slot < 4; ++slot) {
+        const BvhNode* child = slot < slotCount ? &bvh.nodes[slots[slot]] : nullptr;
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            node.boundsMin[axis][slot] = child ? child->boundsMin[axis] : FLT_MAX;
+            node.boundsMax[axis][slot] = child ? child->boundsMax[axis] : -FLT_MAX;
+        }
+
+        node.children[slot]       = child && child->triangleCount > 0 ? child->offset : INVALID_CHILD;
+        node.triangleCounts[slot] = child ? child->triangleCount : 0;
+    }
+
+    // Children are collapsed after the node is filled in, they grow the node array
+    uint32_t interiorCount       = 0;
+    uint32_t childTraversalStack = 0;
+    for (uint32_t slot = 0; slot < slotCount; ++slot) {
+        if (bvh.nodes[slots[slot]].triangleCount == 0) {
+            uint32_t       childStackSize   = 0;
+            const uint32_t child            = collapseNode(bvh, slots[slot], nodes, childStackSize);
+            nodes[nodeIndex].children[slot] = child;
+
+            ++interiorCount;
+            childTraversalStack = std::max(childTraversalStack, childStackSize);
+        }
+    }
+
+    // All interior children are pushed at once, the other ones wait on the stack while any of them is traversed
+    traversalStackSize = interiorCount == 0 ? 0 : std::max(interiorCount, interiorCount - 1 + childTraversalStack);
+
+    return nodeIndex;
+}
+
+CpuRayTracer::CpuRayTracer(JobSystem& jobSystem, const std::vector<MeshView>& meshViews) {
+    PROFILE_ZONE("createCpuRayTracer");
+
+    m_meshes = std::vector<CpuMesh>(meshViews.size());
+    for (size_t i = 0; i < meshViews.size(); ++i) {
+        const MeshView& meshView = meshViews[i];
+        CpuMesh&        mesh     = m_meshes[i];
+
+        mesh.normals = static_cast<const float*>(meshView.normals);
+
+        Bvh bvh = buildBvh(jobSystem, meshView);
+        if (bvh.nodes.empty()) {
+            continue;
+        }
+
+        mesh.nodes.reserve(bvh.nodes.size() / 2);
+
+        // Degenerate meshes can build arbitrarily deep trees, traversal would overrun its fixed stack
+        uint32_t traversalStackSize = 0;
+        collapseNode(bvh, 0, mesh.nodes, traversalStackSize);
+        if (traversalStackSize > TRAVERSAL_STACK_SIZE) {
+            throw std::runtime_error("Couldn't build CPU BVH of mesh " + std::to_string(i) + ", it's too deep to traverse!");
+        }
+
+        const float* vertices = static_cast<const float*>(meshView.vertices);
+
+        mesh.triangles = std::vector<CpuTriangle>(bvh.triangles.size());
+        for (size_t j = 0; j < bvh.triangles.size(); ++j) {
+            CpuTriangle& triangle = mesh.triangles[j];
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                triangle.vertices[corner] = getIndex(meshView, 3 * static_cast<uint64_t>(bvh.triangles[j]) + corner);
+            }
+
+            const float* corners[3] = {&vertices[3 * static_cast<uint64_t>(triangle.vertices[0])],
+                                       &vertices[3 * static_cast<uint64_t>(triangle.vertices[1])],
+                                       &vertices[3 * static_cast<uint64_t>(triangle.vertices[2])]};
+            for (uint32_t axis = 0; axis < 3; ++axis) {
+                triangle.vertex[axis]   = corners[0][axis];
+                triangle.edges[0][axis] = corners[1][axis] - corners[0][axis];
+                triangle.edges[1][axis] = corners[2][axis] - corners[0][axis];
+            }
+        }
+    }
+}
+
+struct CpuRay {
+    float origin[3];
+    float direction[3];
+    float inverseDirection[3];
+};
+
+struct CpuHit {
+    float              t               = RAY_T_MAX;
+    const CpuMesh*     mesh            = nullptr;
+    const CpuTriangle* triangle        = nullptr;
+    float              barycentrics[2] = {}; // Weights of the second and third vertex, like the hit attribute of the built in intersection
+};
+
+static float dot(const float* a, const float* b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+static void cross(const float* a, const float* b, float* result) {
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Moller-Trumbore, without culling since the shaders trace with no culling flags
+static void intersectTriangle(const CpuRay& ray, const CpuMesh& mesh, const CpuTriangle& triangle, CpuHit& hit) {
+    float p[3];
+    cross(ray.direction, triangle.edges[1], p);
+
+    float determinant = dot(triangle.edges[0], p);
+    if (determinant == 0.0f) {
+        return;
+    }
+
+    float inverseDeterminant = 1.0f / determinant;
+    float s[3]               = {ray.origin[0] - triangle.vertex[0], ray.origin[1] - triangle.vertex[1], ray.origin[2] - triangle.vertex[2]};
+
+    float u = dot(s, p) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f) {
+        return;
+    }
+
+    float q[3];
+    cross(s, triangle.edges[0], q);
+
+    float v = dot(ray.direction, q) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f) {
+        return;
+    }
+
+    float t = dot(triangle.edges[1], q) * inverseDeterminant;
+    if (t < RAY_T_MIN || t >= hit.t) {
+        return;
+    }
+
+    hit.t               = t;
+    hit.mesh            = &mesh;
+    hit.triangle        = &triangle;
+    hit.barycentrics[0] = u;
+    hit.barycentrics[1] = v;
+}
+
+static void traceMesh(const CpuRay& ray, const CpuMesh& mesh, CpuHit& hit) {
+    if (mesh.nodes.empty()) {
+        return;
+    }
+
+    const __m128 origin[3]  = {_mm_set1_ps(ray.origin[0]), _mm_set1_ps(ray.origin[1]), _mm_set1_ps(ray.origin[2])};
+    const __m128 inverse[3] = {_mm_set1_ps(ray.inverseDirection[0]), _mm_set1_ps(ray.inverseDirection[1]), _mm_set1_ps(ray.inverseDirection[2])};
+    const __m128 tMin       = _mm_set1_ps(RAY_T_MIN);
+
+    // Picking the near plane by the sign of the direction keeps inverted bounds inverted, which is what rejects empty slots
+    bool negative[3];
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        negative[axis] = ray.direction[axis] < 0.0f;
+    }
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    uint32_t stackSize = 1;
+    stack[0]           = 0;
+
+    while (stackSize > 0) {
+        const CpuBvhNode& node = mesh.nodes[stack[--stackSize]];
+
+        __m128 tNear = tMin;
+        __m128 tFar  = _mm_set1_ps(hit.t);
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            const float* nearPlanes = negative[axis] ? node.boundsMax[axis] : node.boundsMin[axis];
+            const float* farPlanes  = negative[axis] ? node.boundsMin[axis] : node.boundsMax[axis];
+
+            tNear = _mm_max_ps(tNear, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearPlanes), origin[axis]), inverse[axis]));
+            tFar  = _mm_min_ps(tFar, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(farPlanes), origin[axis]), inverse[axis]));
+        }
+
+        int hitMask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+        if (hitMask == 0) {
+            continue;
+        }
+
+        alignas(16) float distances[4];
+        _mm_store_ps(distances, tNear);
+
+        // Leaves are intersected right away, interior children are pushed farthest first so the nearest one is visited next
+        uint32_t children[4];
+        float    childDistances[4];
+        uint32_t childCount = 0;
+        for (uint32_t slot = 0; slot < 4; ++slot) {
+            if ((hitMask & (1 << slot)) == 0) {
+                continue;
+            }
+
+            if (node.triangleCounts[slot] > 0) {
+                for (uint32_t i = 0; i < node.triangleCounts[slot]; ++i) {
+                    intersectTriangle(ray, mesh, mesh.triangles[node.children[slot] + i], hit);
+                }
+                continue;
+            }
+
+            uint32_t position = childCount++;
+            while (position > 0 && childDistances[position - 1] < distances[slot]) {
+                children[position]       = children[position - 1];
+                childDistances[position] = childDistances[position - 1];
+                --position;
+            }
+
+            children[position]       = node.children[slot];
+            childDistances[position] = distances[slot];
+        }
+
+        for (uint32_t i = 0; i < childCount; ++i) {
+            stack[stackSize++] = children[i];
+        }
+    }
+}
+
+// closestHitShader.rchit, with the normal in mesh space like the shader's
+static void shadeClosestHit(const CpuHit& hit, float* color) {
+    const float weights[3] = {1.0f - hit.barycentrics[0] - hit.barycentrics[1], hit.barycentrics[0], hit.barycentrics[1]};
+
+    float normal[3] = {};
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            normal[axis] += hit.mesh->normals[3 * static_cast<uint64_t>(hit.triangle->vertices[corner]) + axis] * weights[corner];
+        }
+    }
+
+    float inverseLength = 1.0f / std::sqrt(dot(normal, normal));
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        normal[axis] *= inverseLength;
+    }
+
+    normal[1] = -normal[1];
+
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        color[axis] = (normal[axis] + 3.0f) * 0.25f * std::abs(normal[axis]);
+    }
+}
+
+// missShader.rmiss
+static void shadeMiss(float* color) {
+    color[0] = 0.0f;
+    color[1] = 0.0f;
+    color[2] = 0.2f;
+}
+
+struct CpuFrame {
+    const std::vector<CpuMesh>* meshes = nullptr;
+    RayTracingCameraData        cameraData;
+    float                       instanceCosine = 1.0f;
+    float                       instanceSine   = 0.0f;
+    uint32_t                    width          = 0;
+    uint32_t                    height         = 0;
+    uint8_t*                    pixels         = nullptr;
+};
+
+struct CpuTile {
+    const CpuFrame* frame = nullptr;
+    uint32_t        x     = 0;
+    uint32_t        y     = 0;
+};
+
+// raygenShader.rgen for every pixel of the tile
+static void renderTile(void* data) {
+    const CpuTile&  tile  = *static_cast<const CpuTile*>(data);
+    const CpuFrame& frame = *tile.frame;
+
+    const glm::vec4 origin = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) * frame.cameraData.cameraTransformationInverse;
+    const float     z      = -frame.cameraData.oneOverTanOfHalfFov * static_cast<float>(frame.height);
+
+    const uint32_t lastX = std::min(tile.x + TILE_SIZE, frame.width);
+    const uint32_t lastY = std::min(tile.y + TILE_SIZE, frame.height);
+    for (uint32_t y = tile.y; y < lastY; ++y) {
+        for (uint32_t x = tile.x; x < lastX; ++x) {
+            glm::vec2 pixelCenter = (glm::vec2(static_cast<float>(x), static_cast<float>(y)) + glm::vec2(0.5f)) * 2.0f -
+                                    glm::vec2(static_cast<float>(frame.width), static_cast<float>(frame.height));
+            glm::vec4 direction = glm::vec4(pixelCenter.x, pixelCenter.y, z, 1.0f) * frame.cameraData.cameraTransformationInverse;
+
+            // Every mesh is an instance of its own, rays go into mesh space through the inverse of the instance rotation
+            CpuRay ray;
+            ray.origin[0]    = frame.instanceCosine * origin.x - frame.instanceSine * origin.z;
+            ray.origin[1]    = origin.y;
+            ray.origin[2]    = frame.instanceSine * origin.x + frame.instanceCosine * origin.z;
+            ray.direction[0] = frame.instanceCosine * direction.x - frame.instanceSine * direction.z;
+            ray.direction[1] = direction.y;
+            ray.direction[2] = frame.instanceSine * direction.x + frame.instanceCosine * direction.z;
+            for (uint32_t axis = 0; axis < 3; ++axis) {
+                ray.inverseDirection[axis] = 1.0f / ray.direction[axis];
+            }
+
+            CpuHit hit;
+            for (const CpuMesh& mesh : *frame.meshes) {
+                traceMesh(ray, mesh, hit);
+            }
+
+            float color[3];
+            if (hit.mesh) {
+                shadeClosestHit(hit, color);
+            } else {
+                shadeMiss(color);
+            }
+
+            // Stored like imageStore into an RGBA8 UNORM image, alpha is written as zero
+            uint8_t* pixel = &frame.pixels[4 * (static_cast<uint64_t>(y) * frame.width + x)];
+            for (uint32_t channel = 0; channel < 3; ++channel) {
+                pixel[channel] = static_cast<uint8_t>(std::lround(std::clamp(color[channel], 0.0f, 1.0f) * 255.0f));
+            }
+            pixel[3] = 0;
+        }
+    }
+}
+
+void CpuRayTracer::render(JobSystem& jobSystem, const RayTracingCameraData& cameraData, const float instanceAngle, const uint32_t width,
+                          const uint32_t height, uint8_t* pixels) const {
+    PROFILE_ZONE("cpuRayTrace");
+
+    CpuFrame frame       = {};
+    frame.meshes         = &m_meshes;
+    frame.cameraData     = cameraData;
+    frame.instanceCosine = std::cos(instanceAngle);
+    frame.instanceSine   = std::sin(instanceAngle);
+    frame.width          = width;
+    frame.height         = height;
+    frame.pixels         = pixels;
+
+    std::vector<CpuTile> tiles;
+    tiles.reserve(static_cast<size_t>((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE));
+    for (uint32_t y = 0; y < height; y += TILE_SIZE) {
+        for (uint32_t x = 0; x < width; x += TILE_SIZE) {
+            tiles.push_back({&frame, x, y});
+        }
+    }
+
+    JobCounter counter;
+    for (CpuTile& tile : tiles) {
+        jobSystem.run(renderTile, &tile, counter);
+    }
+
+    jobSystem.wait(counter);
+}
+
+void runCpuRayTracingBenchmark(const Settings& settings) {
+    // Importing and building use every core, the benchmark runs get job systems of their own
+    JobSystem loadJobSystem(std::max(1u, std::thread::hardware_concurrency()));
+    Scene     scene(loadJobSystem, settings.meshFile, settings.splitMeshes);
+
+    auto         buildStart = std::chrono::high_resolution_clock::now();
+    CpuRayTracer rayTracer(loadJobSystem, scene.getMeshViews());
+    auto         buildEnd = std::chrono::high_resolution_clock::now();
+    printf("Built CPU ray tracing BVHs in %.2fms\n", std::chrono::duration<double, std::milli>(buildEnd - buildStart).count());
+
+    const std::vector<CameraKeyframe> cameraPath = settings.cameraPathFile.empty() ? createOrbitCameraPath(settings.frameCount, ORBIT_CAMERA_RADIUS)
+                                                                                   : loadCameraPath(settings.cameraPathFile.c_str());
+
+    std::vector<uint32_t> threadCounts;
+    if (settings.cpuThreadCount > 0) {
+        threadCounts.push_back(settings.cpuThreadCount);
+    } else {
+        const uint32_t coreCount = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t threadCount = 1; threadCount < coreCount; threadCount *= 2) {
+            threadCounts.push_back(threadCount);
+        }
+        threadCounts.push_back(coreCount);
+    }
+
+    RayTracingCameraData cameraData = {};
+    cameraData.oneOverTanOfHalfFov  = 1.0f / std::tan(0.5f * FOV);
+
+    std::vector<uint8_t> pixels(4 * static_cast<size_t>(settings.width) * settings.height);
+    const double         rayCount = static_cast<double>(settings.width) * settings.height * settings.frameCount;
+
+    printf("Ray tracing %u frames on the CPU at %ux%u\n", settings.frameCount, settings.width, settings.height);
+
+    double baseRate = 0.0; // Mrays/s per thread of the first run, what perfect scaling would keep
+    for (const uint32_t threadCount : threadCounts) {
+        JobSystem jobSystem(threadCount);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t frame = 0; frame < settings.frameCount; ++frame) {
+            cameraData.cameraTransformationInverse = glm::inverse(getCameraTransformation(sampleCameraPath(cameraPath, frame)));
+
+            const float instanceAngle = settings.animateInstances ? INSTANCE_ROTATION_SPEED * HEADLESS_FRAME_TIME * static_cast<float>(frame) : 0.0f;
+            rayTracer.render(jobSystem, cameraData, instanceAngle, settings.width, settings.height, pixels.data());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        double rate = rayCount / seconds / 1e6;
+        if (baseRate == 0.0) {
+            baseRate = rate / threadCount;
+        }
+
+        printf("%3u threads: %8.2fms per frame, %8.2f Mrays/s, %6.2f Mrays/s per thread, %5.1f%% scaling efficiency\n", threadCount,
+               seconds * 1000.0 / settings.frameCount, rate, rate / threadCount, 100.0 * rate / (baseRate * threadCount));
+    }
+}
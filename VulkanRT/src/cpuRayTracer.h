@@ -0,0 +1,53 @@
+#pragma once
+
+#include "common.h"
+
+#include "jobSystem.h"
+#include "meshFile.h"
+#include "settings.h"
+#include "sharedStructures.h"
+
+#include <vector>
+
+// Four children per node with their bounds stored axis by axis, so one SSE test checks a ray against all of them
+struct alignas(16) CpuBvhNode {
+    float    boundsMin[3][4];
+    float    boundsMax[3][4];
+    uint32_t children[4];       // Node of interior children, first triangle of leaves
+    uint32_t triangleCounts[4]; // Zero for interior children and empty slots, empty slots have inverted bounds
+};
+
+static_assert(sizeof(CpuBvhNode) == 128, "CpuBvhNode is meant to fill two cache lines");
+
+// Stored in leaf order, so the triangles of a leaf are next to each other
+struct CpuTriangle {
+    float    vertex[3];
+    float    edges[2][3]; // From the first vertex to the second and third
+    uint32_t vertices[3]; // For interpolating the normals
+};
+
+struct CpuMesh {
+    std::vector<CpuBvhNode>  nodes;
+    std::vector<CpuTriangle> triangles;
+    const float*             normals = nullptr;
+};
+
+// Reference for the ray tracing pipeline: one primary ray per pixel like raygenShader.rgen, hits shaded like closestHitShader.rchit
+// and misses like missShader.rmiss. Float meshes come out the same as on the GPU up to the rounding of the triangle test,
+// quantized meshes are traced from their float source.
+class CpuRayTracer {
+  public:
+    // The BVHs are built on jobSystem
+    CpuRayTracer(JobSystem& jobSystem, const std::vector<MeshView>& meshViews);
+
+    // Pixels are RGBA8 like the ray traced render targets, rendered tile by tile on every thread of the job system.
+    // Instances are rotated around the y axis by instanceAngle, like Application::animateTopLevelInstances does.
+    void render(JobSystem& jobSystem, const RayTracingCameraData& cameraData, const float instanceAngle, const uint32_t width, const uint32_t height,
+                uint8_t* pixels) const;
+
+  private:
+    std::vector<CpuMesh> m_meshes;
+};
+
+// Renders the headless camera path on 1, 2, 4 and so on threads up to the core count and prints the throughput of each. Doesn't need a GPU.
+void runCpuRayTracingBenchmark(const Settings& settings);
@@ -0,0 +1,60 @@
+#include "deletionQueue.h"
+
+DeletionQueue::DeletionQueue(const VkDevice device, MemoryAllocator& memoryAllocator) : m_device(device), m_memoryAllocator(memoryAllocator) {}
+
+DeletionQueue::~DeletionQueue() {
+    for (RetiredObject& retiredObject : m_retiredObjects) {
+        destroy(retiredObject);
+    }
+}
+
+void DeletionQueue::retire(const uint64_t frameValue, const VkSwapchainKHR swapchain) {
+    RetiredObject retiredObject = {};
+    retiredObject.frameValue    = frameValue;
+    retiredObject.swapchain     = swapchain;
+    m_retiredObjects.push_back(retiredObject);
+}
+
+void DeletionQueue::retire(const uint64_t frameValue, const VkImageView imageView) {
+    RetiredObject retiredObject = {};
+    retiredObject.frameValue    = frameValue;
+    retiredObject.imageView     = imageView;
+    m_retiredObjects.push_back(retiredObject);
+}
+
+void DeletionQueue::retire(const uint64_t frameValue, const VkFramebuffer framebuffer) {
+    RetiredObject retiredObject = {};
+    retiredObject.frameValue    = frameValue;
+    retiredObject.framebuffer   = framebuffer;
+    m_retiredObjects.push_back(retiredObject);
+}
+
+void DeletionQueue::retire(const uint64_t frameValue, const VkImage image, const Allocation& allocation) {
+    RetiredObject retiredObject = {};
+    retiredObject.frameValue    = frameValue;
+    retiredObject.image         = image;
+    retiredObject.allocation    = allocation;
+    m_retiredObjects.push_back(retiredObject);
+}
+
+void DeletionQueue::collect(const uint64_t completedValue, const VkSwapchainKHR swapchainInUse) {
+    while (!m_retiredObjects.empty() && m_retiredObjects.front().frameValue <= completedValue) {
+        if (m_retiredObjects.front().swapchain != VK_NULL_HANDLE && m_retiredObjects.front().swapchain == swapchainInUse) {
+            break;
+        }
+
+        destroy(m_retiredObjects.front());
+        m_retiredObjects.pop_front();
+    }
+}
+
+void DeletionQueue::destroy(RetiredObject& retiredObject) {
+    vkDestroyFramebuffer(m_device, retiredObject.framebuffer, nullptr);
+    vkDestroyImageView(m_device, retiredObject.imageView, nullptr);
+    vkDestroySwapchainKHR(m_device, retiredObject.swapchain, nullptr);
+
+    if (retiredObject.image != VK_NULL_HANDLE) {
+        vkDestroyImage(m_device, retiredObject.image, nullptr);
+        m_memoryAllocator.deallocate(retiredObject.allocation);
+    }
+}
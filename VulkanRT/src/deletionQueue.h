@@ -0,0 +1,48 @@
+#pragma once
+
+#include "common.h"
+
+#include "memoryAllocator.h"
+
+#pragma warning(push, 0)
+#define VK_ENABLE_BETA_EXTENSIONS
+#include "volk.h"
+#pragma warning(pop)
+
+#include <deque>
+
+// Defers destroying objects that frames still in flight may use. Every object is retired with the frame timeline value of the last frame
+// submitted before it was replaced, and destroyed once the timeline has reached it. Values have to be retired in increasing order.
+class DeletionQueue {
+  public:
+    DeletionQueue(const VkDevice device, MemoryAllocator& memoryAllocator);
+
+    // Destroys whatever is left, the device has to be idle by then
+    ~DeletionQueue();
+
+    void retire(const uint64_t frameValue, const VkSwapchainKHR swapchain);
+    void retire(const uint64_t frameValue, const VkImageView imageView);
+    void retire(const uint64_t frameValue, const VkFramebuffer framebuffer);
+    void retire(const uint64_t frameValue, const VkImage image, const Allocation& allocation);
+
+    // Destroys every object retired with a value up to completedValue. swapchainInUse is still waited on outside of the frames,
+    // like by the latency monitor, so it and everything retired after it are kept until a later collect.
+    void collect(const uint64_t completedValue, const VkSwapchainKHR swapchainInUse);
+
+  private:
+    struct RetiredObject {
+        uint64_t       frameValue  = 0;
+        VkSwapchainKHR swapchain   = VK_NULL_HANDLE;
+        VkImageView    imageView   = VK_NULL_HANDLE;
+        VkFramebuffer  framebuffer = VK_NULL_HANDLE;
+        VkImage        image       = VK_NULL_HANDLE;
+        Allocation     allocation  = {};
+    };
+
+    const VkDevice   m_device;
+    MemoryAllocator& m_memoryAllocator;
+
+    std::deque<RetiredObject> m_retiredObjects;
+
+    void destroy(RetiredObject& retiredObject);
+};
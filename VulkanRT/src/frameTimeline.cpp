@@ -0,0 +1,59 @@
+#include "frameTimeline.h"
+
+#include "profiler.h"
+
+FrameTimeline::FrameTimeline(const VkDevice device, const uint32_t latencyDepth) : m_device(device), m_latencyDepth(latencyDepth) {
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    semaphoreTypeCreateInfo.semaphoreType             = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue              = 0;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    semaphoreCreateInfo.pNext                 = &semaphoreTypeCreateInfo;
+
+    VK_CHECK(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_semaphore));
+}
+
+FrameTimeline::~FrameTimeline() {
+    wait(m_submittedValue);
+
+    vkDestroySemaphore(m_device, m_semaphore, nullptr);
+}
+
+void FrameTimeline::waitForLatency() const {
+    if (m_submittedValue >= m_latencyDepth) {
+        PROFILE_ZONE("waitForFrameLatency");
+        wait(m_submittedValue + 1 - m_latencyDepth);
+    }
+}
+
+void FrameTimeline::wait(const uint64_t value) const {
+    if (value == 0) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo semaphoreWaitInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    semaphoreWaitInfo.semaphoreCount      = 1;
+    semaphoreWaitInfo.pSemaphores         = &m_semaphore;
+    semaphoreWaitInfo.pValues             = &value;
+
+    VK_CHECK(vkWaitSemaphores(m_device, &semaphoreWaitInfo, UINT64_MAX));
+}
+
+const uint64_t FrameTimeline::getNextValue() const { return m_submittedValue + 1; }
+
+const uint32_t FrameTimeline::getNextSlot() const { return static_cast<uint32_t>(m_submittedValue % m_latencyDepth); }
+
+void FrameTimeline::markSubmitted() { ++m_submittedValue; }
+
+const uint64_t FrameTimeline::getSubmittedValue() const { return m_submittedValue; }
+
+const uint64_t FrameTimeline::getCompletedValue() const {
+    uint64_t completedValue = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_semaphore, &completedValue));
+
+    return completedValue;
+}
+
+const VkSemaphore FrameTimeline::getSemaphore() const { return m_semaphore; }
+
+const uint32_t FrameTimeline::getLatencyDepth() const { return m_latencyDepth; }
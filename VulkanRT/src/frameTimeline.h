@@ -0,0 +1,43 @@
+#pragma once
+
+#include "common.h"
+
+#pragma warning(push, 0)
+#define VK_ENABLE_BETA_EXTENSIONS
+#include "volk.h"
+#pragma warning(pop)
+
+// Paces frames with one timeline semaphore, every submitted frame signals the next value.
+// A frame may only be recorded once no more than latencyDepth - 1 frames are still in flight, so a deeper queue trades input latency
+// for throughput. Anything a frame used is free again once the semaphore reaches the value that frame signalled.
+class FrameTimeline {
+  public:
+    FrameTimeline(const VkDevice device, const uint32_t latencyDepth);
+    ~FrameTimeline();
+
+    // Blocks until the next frame fits within the latency depth
+    void waitForLatency() const;
+
+    // Blocks until the frame that signalled value has completed, zero never blocks
+    void wait(const uint64_t value) const;
+
+    // What the next submitted frame has to signal, and its slot among latencyDepth sets of per frame resources
+    const uint64_t getNextValue() const;
+    const uint32_t getNextSlot() const;
+
+    // Once the frame signalling getNextValue() is submitted
+    void markSubmitted();
+
+    const uint64_t getSubmittedValue() const;
+    const uint64_t getCompletedValue() const; // Reached by the GPU so far, doesn't block
+
+    const VkSemaphore getSemaphore() const;
+    const uint32_t    getLatencyDepth() const;
+
+  private:
+    const VkDevice m_device;
+    const uint32_t m_latencyDepth;
+
+    VkSemaphore m_semaphore      = VK_NULL_HANDLE;
+    uint64_t    m_submittedValue = 0;
+};
@@ -0,0 +1,317 @@
+#include "gpuProfiler.h"
+
+#include "commandPools.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+
+// Frames kept for the rolling statistics of every pass
+#define GPU_PROFILER_HISTORY 256
+
+#define PASS_COUNT static_cast<uint32_t>(GpuPass::Count)
+
+#define RASTER_PIPELINE_STATISTICS                                                                                                                             \
+    (VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |                                   \
+     VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT)
+
+static const char* getPassName(const GpuPass pass) {
+    switch (pass) {
+    case GpuPass::Frame:
+        return "frame";
+    case GpuPass::RayTracing:
+        return "ray tracing";
+    case GpuPass::Raster:
+        return "raster";
+    default:
+        return "unknown";
+    }
+}
+
+GpuProfiler::GpuProfiler(const VkDevice& device, const uint32_t& frameCount, const float& timestampPeriod, const uint32_t& timestampValidBits,
+                         const bool& pipelineStatisticsSupported)
+    : m_device(device), m_timestampPeriod(timestampPeriod),
+      m_timestampMask(timestampValidBits >= 64 ? UINT64_MAX : (1ull << timestampValidBits) - 1), m_timestampsSupported(timestampValidBits > 0),
+      m_pipelineStatisticsSupported(pipelineStatisticsSupported) {
+
+    m_passHistories.resize(PASS_COUNT);
+    for (PassHistory& passHistory : m_passHistories) {
+        passHistory.samples.resize(GPU_PROFILER_HISTORY);
+    }
+
+    if (!m_timestampsSupported) {
+        printf("Timestamps not supported by the selected queue, GPU timings will not be recorded\n");
+    }
+
+    addFrames(frameCount);
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (FrameQueries& frame : m_frames) {
+        vkDestroyQueryPool(m_device, frame.statisticsQueryPool, nullptr);
+        vkDestroyQueryPool(m_device, frame.timestampQueryPool, nullptr);
+    }
+}
+
+// Frames without timestamp support keep null query pools, every call for them is a no-op
+void GpuProfiler::addFrames(const uint32_t frameCount) {
+    const size_t firstFrame = m_frames.size();
+    if (frameCount <= firstFrame) {
+        return;
+    }
+
+    m_frames.resize(frameCount);
+
+    if (!m_timestampsSupported) {
+        return;
+    }
+
+    for (size_t i = firstFrame; i < m_frames.size(); ++i) {
+        FrameQueries& frame = m_frames[i];
+
+        VkQueryPoolCreateInfo timestampQueryPoolCreateInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        timestampQueryPoolCreateInfo.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+        timestampQueryPoolCreateInfo.queryCount            = 2 * PASS_COUNT;
+        VK_CHECK(vkCreateQueryPool(m_device, &timestampQueryPoolCreateInfo, nullptr, &frame.timestampQueryPool));
+
+        if (m_pipelineStatisticsSupported) {
+            VkQueryPoolCreateInfo statisticsQueryPoolCreateInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+            statisticsQueryPoolCreateInfo.queryType             = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            statisticsQueryPoolCreateInfo.queryCount            = 1;
+            statisticsQueryPoolCreateInfo.pipelineStatistics    = RASTER_PIPELINE_STATISTICS;
+            VK_CHECK(vkCreateQueryPool(m_device, &statisticsQueryPoolCreateInfo, nullptr, &frame.statisticsQueryPool));
+        }
+    }
+}
+
+void GpuProfiler::calibrate(const VkQueue& queue, const uint32_t& queueFamilyIndex) {
+    if (m_frames.empty() || m_frames[0].timestampQueryPool == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    queryPoolCreateInfo.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount            = 1;
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateQueryPool(m_device, &queryPoolCreateInfo, nullptr, &queryPool));
+
+    VkCommandPool commandPool = createCommandPool(m_device, queueFamilyIndex);
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    commandBufferAllocateInfo.commandPool                 = commandPool;
+    commandBufferAllocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount          = 1;
+
+    VkCommandBuffer commandBuffer = 0;
+    VK_CHECK(vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &commandBuffer));
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    commandBufferBeginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+    vkCmdResetQueryPool(commandBuffer, queryPool, 0, 1);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 0);
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    semaphoreTypeCreateInfo.semaphoreType             = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue              = 0;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    semaphoreCreateInfo.pNext                 = &semaphoreTypeCreateInfo;
+
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &semaphore));
+
+    const uint64_t completedValue = 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    timelineSemaphoreSubmitInfo.signalSemaphoreValueCount     = 1;
+    timelineSemaphoreSubmitInfo.pSignalSemaphoreValues        = &completedValue;
+
+    VkSubmitInfo submitInfo         = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.pNext                = &timelineSemaphoreSubmitInfo;
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores    = &semaphore;
+
+    VkSemaphoreWaitInfo semaphoreWaitInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    semaphoreWaitInfo.semaphoreCount      = 1;
+    semaphoreWaitInfo.pSemaphores         = &semaphore;
+    semaphoreWaitInfo.pValues             = &completedValue;
+
+    // The timestamp lands somewhere between the submission and the end of the wait, the midpoint halves the error
+    uint64_t submitTime = getProfilerTime();
+    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+    VK_CHECK(vkWaitSemaphores(m_device, &semaphoreWaitInfo, UINT64_MAX));
+    uint64_t completeTime = getProfilerTime();
+
+    uint64_t timestamp = 0;
+    VK_CHECK(vkGetQueryPoolResults(m_device, queryPool, 0, 1, sizeof(timestamp), &timestamp, sizeof(timestamp), VK_QUERY_RESULT_64_BIT));
+
+    m_profilerTimeOffset = 0.5 * static_cast<double>(submitTime + completeTime) - static_cast<double>(timestamp & m_timestampMask) * m_timestampPeriod;
+    m_calibrated         = true;
+
+    vkDestroySemaphore(m_device, semaphore, nullptr);
+    vkFreeCommandBuffers(m_device, commandPool, 1, &commandBuffer);
+    vkDestroyCommandPool(m_device, commandPool, nullptr);
+    vkDestroyQueryPool(m_device, queryPool, nullptr);
+}
+
+const float GpuProfiler::collect(const uint32_t frameIndex) {
+    FrameQueries& frame = m_frames[frameIndex];
+
+    float frameTime = -1.0f;
+
+    for (uint32_t i = 0; i < PASS_COUNT; ++i) {
+        if ((frame.recordedPasses & (1u << i)) == 0) {
+            continue;
+        }
+
+        // No wait flag, the frame timeline already guarantees completion and a result that still isn't ready is dropped instead of stalling
+        std::array<uint64_t, 2> timestamps  = {};
+        VkResult                queryResult = vkGetQueryPoolResults(m_device, frame.timestampQueryPool, 2 * i, 2, sizeof(timestamps), timestamps.data(),
+                                                                    sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (queryResult != VK_SUCCESS) {
+            continue;
+        }
+
+        uint64_t ticks        = ((timestamps[1] & m_timestampMask) - (timestamps[0] & m_timestampMask)) & m_timestampMask;
+        float    milliseconds = static_cast<float>(static_cast<double>(ticks) * m_timestampPeriod / 1'000'000.0);
+
+        addSample(static_cast<GpuPass>(i), milliseconds);
+
+        if (m_calibrated && isProfilingEnabled()) {
+            recordGpuZone(getPassName(static_cast<GpuPass>(i)), getProfilerTimestamp(timestamps[0]), getProfilerTimestamp(timestamps[1]));
+        }
+
+        if (static_cast<GpuPass>(i) == GpuPass::Frame) {
+            frameTime = milliseconds;
+        }
+    }
+
+    if ((frame.recordedPasses & (1u << static_cast<uint32_t>(GpuPass::Raster))) && frame.statisticsQueryPool != VK_NULL_HANDLE) {
+        std::array<uint64_t, 4> statistics  = {};
+        VkResult                queryResult = vkGetQueryPoolResults(m_device, frame.statisticsQueryPool, 0, 1, sizeof(statistics), statistics.data(),
+                                                                    sizeof(statistics), VK_QUERY_RESULT_64_BIT);
+        if (queryResult == VK_SUCCESS) {
+            // Counters are written in the order of their bits
+            m_pipelineStatistics.inputAssemblyPrimitives   = statistics[0];
+            m_pipelineStatistics.vertexShaderInvocations   = statistics[1];
+            m_pipelineStatistics.clippingPrimitives        = statistics[2];
+            m_pipelineStatistics.fragmentShaderInvocations = statistics[3];
+        }
+    }
+
+    // Recorded passes are kept, a command buffer submitted again without being recorded writes the same queries
+    return frameTime;
+}
+
+void GpuProfiler::beginFrame(const VkCommandBuffer commandBuffer, const uint32_t frameIndex) {
+    FrameQueries& frame = m_frames[frameIndex];
+    if (frame.timestampQueryPool == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkCmdResetQueryPool(commandBuffer, frame.timestampQueryPool, 0, 2 * PASS_COUNT);
+    if (frame.statisticsQueryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, frame.statisticsQueryPool, 0, 1);
+    }
+
+    frame.recordedPasses = 0;
+
+    beginPass(commandBuffer, frameIndex, GpuPass::Frame);
+}
+
+void GpuProfiler::endFrame(const VkCommandBuffer commandBuffer, const uint32_t frameIndex) { endPass(commandBuffer, frameIndex, GpuPass::Frame); }
+
+void GpuProfiler::beginPass(const VkCommandBuffer commandBuffer, const uint32_t frameIndex, const GpuPass pass) {
+    FrameQueries& frame = m_frames[frameIndex];
+    if (frame.timestampQueryPool == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestampQueryPool, 2 * static_cast<uint32_t>(pass));
+
+    if (pass == GpuPass::Raster && frame.statisticsQueryPool != VK_NULL_HANDLE) {
+        vkCmdBeginQuery(commandBuffer, frame.statisticsQueryPool, 0, 0);
+    }
+}
+
+void GpuProfiler::endPass(const VkCommandBuffer commandBuffer, const uint32_t frameIndex, const GpuPass pass) {
+    FrameQueries& frame = m_frames[frameIndex];
+    if (frame.timestampQueryPool == VK_NULL_HANDLE) {
+        return;
+    }
+
+    if (pass == GpuPass::Raster && frame.statisticsQueryPool != VK_NULL_HANDLE) {
+        vkCmdEndQuery(commandBuffer, frame.statisticsQueryPool, 0);
+    }
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampQueryPool, 2 * static_cast<uint32_t>(pass) + 1);
+
+    frame.recordedPasses |= 1u << static_cast<uint32_t>(pass);
+}
+
+const GpuPassStats GpuProfiler::getStats(const GpuPass pass) const {
+    const PassHistory& passHistory = m_passHistories[static_cast<uint32_t>(pass)];
+
+    GpuPassStats stats = {};
+    stats.sampleCount  = passHistory.sampleCount;
+    if (stats.sampleCount == 0) {
+        return stats;
+    }
+
+    std::vector<float> samples(passHistory.samples.begin(), passHistory.samples.begin() + passHistory.sampleCount);
+    std::sort(samples.begin(), samples.end());
+
+    float sum = 0.0f;
+    for (float sample : samples) {
+        sum += sample;
+    }
+
+    stats.minimum = samples.front();
+    stats.average = sum / static_cast<float>(samples.size());
+    stats.p99     = samples[static_cast<size_t>(0.99f * static_cast<float>(samples.size() - 1) + 0.5f)];
+
+    return stats;
+}
+
+const PipelineStatistics GpuProfiler::getPipelineStatistics() const { return m_pipelineStatistics; }
+
+const VkQueryPipelineStatisticFlags GpuProfiler::getInheritedPipelineStatistics() const {
+    return !m_frames.empty() && m_frames[0].statisticsQueryPool != VK_NULL_HANDLE ? RASTER_PIPELINE_STATISTICS : 0;
+}
+
+void GpuProfiler::printStats() const {
+    for (uint32_t i = 0; i < PASS_COUNT; ++i) {
+        GpuPassStats stats = getStats(static_cast<GpuPass>(i));
+        if (stats.sampleCount == 0) {
+            continue;
+        }
+
+        printf("GPU %s time over the last %u frames: min %.3fms, avg %.3fms, p99 %.3fms\n", getPassName(static_cast<GpuPass>(i)), stats.sampleCount,
+               stats.minimum, stats.average, stats.p99);
+    }
+
+    if (m_pipelineStatistics.inputAssemblyPrimitives > 0) {
+        printf("Raster pipeline statistics: %llu primitives assembled, %llu vertex invocations, %llu primitives after clipping, %llu fragment invocations\n",
+               m_pipelineStatistics.inputAssemblyPrimitives, m_pipelineStatistics.vertexShaderInvocations, m_pipelineStatistics.clippingPrimitives,
+               m_pipelineStatistics.fragmentShaderInvocations);
+    }
+}
+
+void GpuProfiler::addSample(const GpuPass pass, const float milliseconds) {
+    PassHistory& passHistory = m_passHistories[static_cast<uint32_t>(pass)];
+
+    passHistory.samples[passHistory.nextSample] = milliseconds;
+    passHistory.nextSample                      = (passHistory.nextSample + 1) % GPU_PROFILER_HISTORY;
+    passHistory.sampleCount                     = std::min(passHistory.sampleCount + 1, static_cast<uint32_t>(GPU_PROFILER_HISTORY));
+}
+
+const uint64_t GpuProfiler::getProfilerTimestamp(const uint64_t timestamp) const {
+    return static_cast<uint64_t>(static_cast<double>(timestamp & m_timestampMask) * m_timestampPeriod + m_profilerTimeOffset);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "common.h"
+
+#pragma warning(push, 0)
+#define VK_ENABLE_BETA_EXTENSIONS
+#include "volk.h"
+#pragma warning(pop)
+
+#include <vector>
+
+enum class GpuPass { Frame, RayTracing, Raster, Count };
+
+// Rolling statistics in milliseconds over the most recently collected frames
+struct GpuPassStats {
+    float    minimum     = 0.0f;
+    float    average     = 0.0f;
+    float    p99         = 0.0f;
+    uint32_t sampleCount = 0;
+};
+
+struct PipelineStatistics {
+    uint64_t inputAssemblyPrimitives   = 0;
+    uint64_t vertexShaderInvocations   = 0;
+    uint64_t clippingPrimitives        = 0;
+    uint64_t fragmentShaderInvocations = 0;
+};
+
+// Times passes with a timestamp query pool per frame in flight. A frame's queries are only read back once the frame timeline has reached
+// the frame's value, so collecting results never stalls the CPU on the GPU. Without timestamp support on the queue every call is a no-op.
+class GpuProfiler {
+  public:
+    GpuProfiler(const VkDevice& device, const uint32_t& frameCount, const float& timestampPeriod, const uint32_t& timestampValidBits,
+                const bool& pipelineStatisticsSupported);
+
+    ~GpuProfiler();
+
+    // Creates the queries of frames up to frameCount, for render targets added after construction
+    void addFrames(const uint32_t frameCount);
+
+    // Measures the offset between GPU timestamps and profiler time with one blocking submission, so collected passes can be placed on the
+    // trace timeline next to CPU zones. Drift between the clocks isn't corrected afterwards.
+    void calibrate(const VkQueue& queue, const uint32_t& queueFamilyIndex);
+
+    // Has to be called once the frame timeline has reached the value last submitted with frameIndex, and before it's recorded or submitted again.
+    // Returns the GPU time of the whole frame in milliseconds, negative if it wasn't timed or its results weren't available.
+    const float collect(const uint32_t frameIndex);
+
+    // beginFrame resets the queries of frameIndex, so it has to be the first profiler call recorded for the frame, outside of a render pass
+    void beginFrame(const VkCommandBuffer commandBuffer, const uint32_t frameIndex);
+    void endFrame(const VkCommandBuffer commandBuffer, const uint32_t frameIndex);
+
+    // Raster passes also gather pipeline statistics when they are supported, along with the inheritedQueries feature their secondary command buffers need.
+    // Ray tracing stages have no statistics counters.
+    void beginPass(const VkCommandBuffer commandBuffer, const uint32_t frameIndex, const GpuPass pass);
+    void endPass(const VkCommandBuffer commandBuffer, const uint32_t frameIndex, const GpuPass pass);
+
+    const GpuPassStats       getStats(const GpuPass pass) const;
+    const PipelineStatistics getPipelineStatistics() const; // Of the most recently collected raster pass
+    void                     printStats() const;
+
+    // Secondary command buffers executed inside a raster pass have to inherit its statistics query, zero when there is none
+    const VkQueryPipelineStatisticFlags getInheritedPipelineStatistics() const;
+
+  private:
+    struct FrameQueries {
+        VkQueryPool timestampQueryPool  = VK_NULL_HANDLE; // Two timestamps per pass
+        VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+        uint32_t    recordedPasses      = 0; // Bit per GpuPass with both timestamps recorded
+    };
+
+    struct PassHistory {
+        std::vector<float> samples;
+        uint32_t           sampleCount = 0;
+        uint32_t           nextSample  = 0;
+    };
+
+    const VkDevice m_device;
+    const float    m_timestampPeriod;
+    const uint64_t m_timestampMask;
+    const bool     m_timestampsSupported;
+    const bool     m_pipelineStatisticsSupported;
+
+    std::vector<FrameQueries> m_frames;
+    std::vector<PassHistory>  m_passHistories;
+    PipelineStatistics        m_pipelineStatistics = {};
+    double                    m_profilerTimeOffset = 0.0; // Nanoseconds to add to converted timestamps to get profiler time
+    bool                      m_calibrated         = false;
+
+    void           addSample(const GpuPass pass, const float milliseconds);
+    const uint64_t getProfilerTimestamp(const uint64_t timestamp) const;
+};
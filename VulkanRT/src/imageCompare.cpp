@@ -0,0 +1,93 @@
+#include "imageCompare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define MIN_DIFF_INTENSITY 64 // Even barely mismatched pixels show up clearly red
+
+static uint32_t getChannelDifference(const uint8_t* image, const uint8_t* reference, const size_t pixel) {
+    uint32_t difference = 0;
+    for (uint32_t channel = 0; channel < 3; ++channel) {
+        difference = std::max(difference, static_cast<uint32_t>(std::abs(image[4 * pixel + channel] - reference[4 * pixel + channel])));
+    }
+
+    return difference;
+}
+
+ImageComparison compareImages(const uint8_t* image, const uint8_t* reference, const uint32_t width, const uint32_t height, const uint32_t pixelTolerance) {
+    ImageComparison comparison;
+
+    const size_t pixelCount        = static_cast<size_t>(width) * height;
+    double       squaredErrorTotal = 0.0;
+    for (size_t pixel = 0; pixel < pixelCount; ++pixel) {
+        for (uint32_t channel = 0; channel < 3; ++channel) {
+            const double error = static_cast<double>(image[4 * pixel + channel]) - static_cast<double>(reference[4 * pixel + channel]);
+            squaredErrorTotal += error * error;
+        }
+
+        const uint32_t difference = getChannelDifference(image, reference, pixel);
+        comparison.maxDifference  = std::max(comparison.maxDifference, difference);
+        if (difference > pixelTolerance) {
+            ++comparison.mismatchedPixelCount;
+        }
+    }
+
+    const double meanSquaredError = squaredErrorTotal / (3.0 * static_cast<double>(pixelCount));
+    comparison.psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : std::numeric_limits<double>::infinity();
+
+    return comparison;
+}
+
+static void writePpm(const char* path, const std::vector<uint8_t>& rgb, const uint32_t width, const uint32_t height) {
+    FILE* file = nullptr;
+    if (fopen_s(&file, path, "wb") != 0 || !file) {
+        throw std::runtime_error(std::string("Failed to open image file ") + path + " for writing!");
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    size_t written = fwrite(rgb.data(), 1, rgb.size(), file);
+    fclose(file);
+
+    if (written != rgb.size()) {
+        throw std::runtime_error(std::string("Failed to write image file ") + path + "!");
+    }
+}
+
+void writeImage(const char* path, const uint8_t* pixels, const uint32_t width, const uint32_t height) {
+    const size_t         pixelCount = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> rgb(3 * pixelCount);
+    for (size_t pixel = 0; pixel < pixelCount; ++pixel) {
+        for (uint32_t channel = 0; channel < 3; ++channel) {
+            rgb[3 * pixel + channel] = pixels[4 * pixel + channel];
+        }
+    }
+
+    writePpm(path, rgb, width, height);
+}
+
+void writeDiffImage(const char* path, const uint8_t* image, const uint8_t* reference, const uint32_t width, const uint32_t height,
+                    const uint32_t pixelTolerance) {
+    const size_t         pixelCount = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> rgb(3 * pixelCount);
+    for (size_t pixel = 0; pixel < pixelCount; ++pixel) {
+        const uint32_t difference = getChannelDifference(image, reference, pixel);
+        if (difference > pixelTolerance) {
+            rgb[3 * pixel]     = static_cast<uint8_t>(std::min(MIN_DIFF_INTENSITY + difference, 255u));
+            rgb[3 * pixel + 1] = 0;
+            rgb[3 * pixel + 2] = 0;
+        } else {
+            const uint32_t luminance = (reference[4 * pixel] + reference[4 * pixel + 1] + reference[4 * pixel + 2]) / 12;
+            rgb[3 * pixel]           = static_cast<uint8_t>(luminance);
+            rgb[3 * pixel + 1]       = static_cast<uint8_t>(luminance);
+            rgb[3 * pixel + 2]       = static_cast<uint8_t>(luminance);
+        }
+    }
+
+    writePpm(path, rgb, width, height);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "common.h"
+
+struct ImageComparison {
+    uint32_t mismatchedPixelCount = 0; // Pixels with any color channel further than the tolerance from the reference
+    uint32_t maxDifference        = 0; // Largest difference of any color channel, out of 255
+    double   psnr                 = 0.0; // In dB over the color channels, infinite for identical images
+};
+
+// Both images are RGBA8 with the same size, alpha is ignored
+ImageComparison compareImages(const uint8_t* image, const uint8_t* reference, const uint32_t width, const uint32_t height, const uint32_t pixelTolerance);
+
+// Binary PPM, alpha is dropped
+void writeImage(const char* path, const uint8_t* pixels, const uint32_t width, const uint32_t height);
+
+// Mismatched pixels are red, scaled by how far off they are, everything else is the reference darkened to grey so the mismatches stand out
+void writeDiffImage(const char* path, const uint8_t* image, const uint8_t* reference, const uint32_t width, const uint32_t height,
+                    const uint32_t pixelTolerance);
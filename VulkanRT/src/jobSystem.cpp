@@ -0,0 +1,223 @@
+#include "jobSystem.h"
+
+#include <algorithm>
+
+// Identifies the system a thread belongs to and its deque there, threads outside of any system use the creating thread's deque
+static thread_local const JobSystem* t_jobSystem   = nullptr;
+static thread_local uint32_t         t_threadIndex = 0;
+
+JobSystem::JobSystem(const uint32_t threadCount) {
+    const uint32_t queueCount = std::max(threadCount, 1u);
+
+    m_queues.reserve(queueCount);
+    for (uint32_t i = 0; i < queueCount; ++i) {
+        m_queues.push_back(std::make_unique<JobQueue>());
+    }
+
+    t_jobSystem   = this;
+    t_threadIndex = 0;
+
+    m_threads.reserve(queueCount - 1);
+    for (uint32_t i = 1; i < queueCount; ++i) {
+        m_threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_quit = true;
+    }
+
+    m_wakeCondition.notify_all();
+
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+
+    if (t_jobSystem == this) {
+        t_jobSystem = nullptr;
+    }
+}
+
+const uint32_t JobSystem::getThreadCount() const { return static_cast<uint32_t>(m_queues.size()); }
+
+void JobSystem::run(const JobFunction function, void* data, JobCounter& counter, const JobCounter* dependency) {
+    ++counter.count;
+    counter.jobSystem = this;
+
+    const Job job = {function, data, &counter, dependency};
+
+    // A dependency reaching zero releases its pending jobs under the same lock, so the job is either held back here or sees it finished
+    if (dependency) {
+        std::unique_lock<std::mutex> lock(m_pendingMutex);
+        if (dependency->count > 0) {
+            m_pendingJobs.push_back(job);
+            return;
+        }
+
+        lock.unlock();
+
+        if (dependency->exception) {
+            finishJob(job, dependency->exception);
+            return;
+        }
+    }
+
+    queueJob(job);
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    help(counter);
+
+    if (counter.exception) {
+        std::rethrow_exception(counter.exception);
+    }
+}
+
+void JobSystem::help(JobCounter& counter) {
+    const uint32_t threadIndex = getThreadIndex();
+    while (counter.count > 0) {
+        if (!tryRunJob(threadIndex)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::workerLoop(const uint32_t threadIndex) {
+    t_jobSystem   = this;
+    t_threadIndex = threadIndex;
+
+    while (true) {
+        if (tryRunJob(threadIndex)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        while (!m_quit && m_queuedJobCount == 0) {
+            m_wakeCondition.wait(lock);
+        }
+
+        if (m_quit) {
+            return;
+        }
+    }
+}
+
+void JobSystem::queueJob(const Job& job) {
+    JobQueue& queue = *m_queues[getThreadIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+        ++m_queuedJobCount;
+    }
+
+    // Taking the lock orders the count above before the check of a worker about to sleep, so the notification can't get lost
+    { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+    m_wakeCondition.notify_one();
+}
+
+bool JobSystem::tryRunJob(const uint32_t threadIndex) {
+    Job  job   = {};
+    bool found = false;
+
+    {
+        JobQueue&                   queue = *m_queues[threadIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+            --m_queuedJobCount;
+            found = true;
+        }
+    }
+
+    // Victims are tried starting with the next thread, so thieves spread out instead of all hitting the first deque
+    for (uint32_t offset = 1; !found && offset < m_queues.size(); ++offset) {
+        JobQueue&                   victim = *m_queues[(threadIndex + offset) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            --m_queuedJobCount;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    std::exception_ptr exception;
+    try {
+        job.function(job.data);
+    } catch (...) {
+        exception = std::current_exception();
+    }
+
+    finishJob(job, exception);
+
+    return true;
+}
+
+// Cancelled jobs are finished with the exception of their dependency without running, which cancels whatever depends on them in turn
+void JobSystem::finishJob(const Job& job, const std::exception_ptr& exception) {
+    JobCounter* counter = job.counter;
+    if (exception) {
+        std::lock_guard<std::mutex> lock(counter->exceptionMutex);
+        if (!counter->exception) {
+            counter->exception = exception;
+        }
+    }
+
+    // Jobs that aren't the last of their group only decrement, without touching the pending lock
+    uint32_t count = counter->count;
+    while (count > 1) {
+        if (counter->count.compare_exchange_weak(count, count - 1)) {
+            return;
+        }
+    }
+
+    // Once at zero a waiter may already be destroying the counter, so everything needed from it is taken before the final decrement.
+    // Holding the pending lock across it keeps a new counter at the same address from getting dependents until the old ones are collected.
+    std::vector<Job>   releasedJobs;
+    std::exception_ptr counterException;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        {
+            std::lock_guard<std::mutex> exceptionLock(counter->exceptionMutex);
+            counterException = counter->exception;
+        }
+
+        if (--counter->count > 0) {
+            return;
+        }
+
+        for (size_t i = 0; i < m_pendingJobs.size();) {
+            if (m_pendingJobs[i].dependency == counter) {
+                releasedJobs.push_back(m_pendingJobs[i]);
+                m_pendingJobs[i] = m_pendingJobs.back();
+                m_pendingJobs.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    for (const Job& releasedJob : releasedJobs) {
+        if (counterException) {
+            finishJob(releasedJob, counterException);
+        } else {
+            queueJob(releasedJob);
+        }
+    }
+}
+
+const uint32_t JobSystem::getThreadIndex() const { return t_jobSystem == this ? t_threadIndex : 0; }
+
+JobCounter::~JobCounter() {
+    JobSystem* system = jobSystem;
+    if (system) {
+        system->help(*this);
+    }
+}
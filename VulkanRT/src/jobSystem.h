@@ -0,0 +1,86 @@
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+typedef void (*JobFunction)(void* data);
+
+// Counts the unfinished jobs of a group, waiting on it returns once it's back at zero.
+// Jobs usually point at data next to their counter, so the counter waits for its jobs when it's destroyed, even while an exception unwinds.
+// Declare counters after the data their jobs use.
+struct JobCounter {
+    ~JobCounter();
+
+    std::atomic<uint32_t>   count     = 0;
+    std::atomic<JobSystem*> jobSystem = nullptr; // Set by the jobs counted
+
+    // The first exception thrown by a counted job, or the one that cancelled a job depending on a failed group
+    std::mutex         exceptionMutex;
+    std::exception_ptr exception;
+};
+
+struct Job {
+    JobFunction       function   = nullptr;
+    void*             data       = nullptr;
+    JobCounter*       counter    = nullptr;
+    const JobCounter* dependency = nullptr;
+};
+
+// Every thread has a deque of its own. Threads take jobs from the back of their own deque, while they're still warm in its cache,
+// and steal from the front of the others' once theirs is empty, where the oldest and usually largest jobs are.
+class JobSystem {
+  public:
+    // The thread creating the system counts as one of the threads, it runs jobs whenever it waits
+    JobSystem(const uint32_t threadCount);
+    ~JobSystem();
+
+    const uint32_t getThreadCount() const;
+
+    // Of the calling thread, from 0 for the creating thread to getThreadCount() - 1. Threads outside of the system get 0 like the creating thread.
+    const uint32_t getThreadIndex() const;
+
+    // Goes onto the deque of the calling thread, threads outside of the system queue onto the creating thread's deque.
+    // With a dependency the job is held back until every job counted by it has finished, and it's cancelled instead if any of those threw.
+    // All the jobs of the dependency have to be queued before the job depending on them, and it has to outlive the job.
+    void run(const JobFunction function, void* data, JobCounter& counter, const JobCounter* dependency = nullptr);
+
+    // Runs queued jobs, its own or stolen ones, until every job counted by counter has finished, then rethrows the first exception they threw
+    void wait(JobCounter& counter);
+
+  private:
+    friend struct JobCounter;
+
+    struct JobQueue {
+        std::mutex      mutex;
+        std::deque<Job> jobs;
+    };
+
+    void workerLoop(const uint32_t threadIndex);
+    void queueJob(const Job& job);
+    bool tryRunJob(const uint32_t threadIndex);
+    void finishJob(const Job& job, const std::exception_ptr& exception);
+    void help(JobCounter& counter);
+
+    std::vector<std::unique_ptr<JobQueue>> m_queues;
+    std::vector<std::thread>               m_threads;
+
+    // Jobs whose dependency hasn't finished yet, only touched when a job is queued with a dependency or a counter reaches zero
+    std::mutex       m_pendingMutex;
+    std::vector<Job> m_pendingJobs;
+
+    // Idle workers sleep until a job is queued
+    std::mutex              m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+    std::atomic<uint32_t>   m_queuedJobCount = 0;
+    bool                    m_quit           = false;
+};
@@ -0,0 +1,244 @@
+#include "latencyMonitor.h"
+
+#include "profiler.h"
+
+#pragma warning(push, 0)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#pragma warning(pop)
+
+#include <algorithm>
+#include <cstdio>
+
+// Frames kept for the rolling statistics
+#define LATENCY_HISTORY 256
+
+// Nanoseconds to wait for a frame before it's dropped, presents of a swapchain that went out of date never complete
+#define FRAME_WAIT_TIMEOUT   1'000'000'000
+#define PRESENT_WAIT_TIMEOUT 100'000'000
+
+// Microseconds a frame should still be finished ahead of its present, covering the jitter of recording and rendering
+#define INPUT_DELAY_MARGIN 1'000
+
+// Fraction of the slack beyond the margin the input delay moves by per frame
+#define INPUT_DELAY_GAIN 0.25f
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+LatencyMonitor::LatencyMonitor(const VkDevice device, const VkSemaphore frameSemaphore, const bool presentWaitSupported, const bool justInTimeInput)
+    : m_device(device), m_frameSemaphore(frameSemaphore), m_presentWaitSupported(presentWaitSupported), m_justInTimeInput(justInTimeInput),
+      m_samples(LATENCY_HISTORY) {
+
+    // Regular sleeps are rounded up to the system timer period, which can be longer than a frame
+    if (m_justInTimeInput) {
+        m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    }
+
+    m_thread = std::thread(&LatencyMonitor::threadLoop, this);
+}
+
+LatencyMonitor::~LatencyMonitor() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_frameAdded.notify_one();
+
+    m_thread.join();
+
+    if (m_timer) {
+        CloseHandle(m_timer);
+    }
+}
+
+void LatencyMonitor::waitForInput() const {
+    const uint32_t inputDelay = m_inputDelay.load();
+    if (inputDelay == 0) {
+        return;
+    }
+
+    PROFILE_ZONE("waitForInput");
+
+    const std::chrono::high_resolution_clock::time_point wakeTime = std::chrono::high_resolution_clock::now() + std::chrono::microseconds(inputDelay);
+
+    if (m_timer) {
+        LARGE_INTEGER dueTime;
+        dueTime.QuadPart = -static_cast<long long>(inputDelay) * 10; // Relative, in 100 nanosecond units
+        if (SetWaitableTimer(m_timer, &dueTime, 0, nullptr, nullptr, FALSE)) {
+            WaitForSingleObject(m_timer, INFINITE);
+        }
+    }
+
+    while (std::chrono::high_resolution_clock::now() < wakeTime) {
+        std::this_thread::yield();
+    }
+}
+
+void LatencyMonitor::addFrame(const uint64_t frameValue, const VkSwapchainKHR swapchain, const std::chrono::high_resolution_clock::time_point& inputTime,
+                              const std::chrono::high_resolution_clock::time_point& submitTime) {
+    Frame frame      = {};
+    frame.value      = frameValue;
+    frame.swapchain  = m_presentWaitSupported ? swapchain : VK_NULL_HANDLE;
+    frame.inputTime  = inputTime;
+    frame.submitTime = submitTime;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        frame.generation = m_generation;
+        m_frames.push_back(frame);
+    }
+    m_frameAdded.notify_one();
+}
+
+void LatencyMonitor::retireSwapchain() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+}
+
+const VkSwapchainKHR LatencyMonitor::getWaitedSwapchain() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_waitedSwapchain;
+}
+
+const LatencyStats LatencyMonitor::getStats() const {
+    LatencyStats stats = {};
+    stats.inputDelay   = static_cast<float>(m_inputDelay.load()) / 1'000.0f;
+
+    std::vector<Sample> samples;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        samples.assign(m_samples.begin(), m_samples.begin() + m_sampleCount);
+    }
+
+    stats.sampleCount = static_cast<uint32_t>(samples.size());
+    if (stats.sampleCount == 0) {
+        return stats;
+    }
+
+    float              inputToSubmitSum  = 0.0f;
+    float              inputToPresentSum = 0.0f;
+    std::vector<float> inputToPresent;
+    for (const Sample& sample : samples) {
+        inputToSubmitSum += sample.inputToSubmit;
+        inputToPresentSum += sample.inputToPresent;
+        inputToPresent.push_back(sample.inputToPresent);
+    }
+
+    std::sort(inputToPresent.begin(), inputToPresent.end());
+
+    stats.inputToSubmit     = inputToSubmitSum / static_cast<float>(stats.sampleCount);
+    stats.inputToPresent    = inputToPresentSum / static_cast<float>(stats.sampleCount);
+    stats.p99InputToPresent = inputToPresent[static_cast<size_t>(0.99f * static_cast<float>(inputToPresent.size() - 1) + 0.5f)];
+
+    return stats;
+}
+
+void LatencyMonitor::printStats() const {
+    LatencyStats stats = getStats();
+    if (stats.sampleCount == 0) {
+        return;
+    }
+
+    printf("Latency over the last %u frames: input to submit avg %.3fms, input to %s avg %.3fms, p99 %.3fms\n", stats.sampleCount, stats.inputToSubmit,
+           m_presentWaitSupported ? "present" : "GPU finish", stats.inputToPresent, stats.p99InputToPresent);
+
+    if (m_justInTimeInput) {
+        printf("Just in time input delay: %.3fms\n", stats.inputDelay);
+    }
+}
+
+void LatencyMonitor::threadLoop() {
+    while (true) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_stopping && m_frames.empty()) {
+                m_frameAdded.wait(lock);
+            }
+
+            if (m_stopping) {
+                return;
+            }
+
+            frame = m_frames.front();
+            m_frames.pop_front();
+
+            // Checked under the same lock retireSwapchain takes, so once it returns no wait on the retired swapchain can start anymore
+            if (frame.generation != m_generation) {
+                continue;
+            }
+
+            m_waitedSwapchain = frame.swapchain;
+        }
+
+        waitForFrame(frame);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_waitedSwapchain = VK_NULL_HANDLE;
+    }
+}
+
+void LatencyMonitor::waitForFrame(const Frame& frame) {
+    // Present intervals don't carry over to a new swapchain
+    if (frame.generation != m_lastGeneration) {
+        m_lastGeneration     = frame.generation;
+        m_lastPresentedValue = 0;
+    }
+
+    VkSemaphoreWaitInfo semaphoreWaitInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    semaphoreWaitInfo.semaphoreCount      = 1;
+    semaphoreWaitInfo.pSemaphores         = &m_frameSemaphore;
+    semaphoreWaitInfo.pValues             = &frame.value;
+
+    if (vkWaitSemaphores(m_device, &semaphoreWaitInfo, FRAME_WAIT_TIMEOUT) != VK_SUCCESS) {
+        return;
+    }
+
+    const std::chrono::high_resolution_clock::time_point finishTime  = std::chrono::high_resolution_clock::now();
+    std::chrono::high_resolution_clock::time_point       presentTime = finishTime;
+
+#ifdef VK_KHR_present_wait
+    if (frame.swapchain != VK_NULL_HANDLE) {
+        if (vkWaitForPresentKHR(m_device, frame.swapchain, frame.value, PRESENT_WAIT_TIMEOUT) != VK_SUCCESS) {
+            return;
+        }
+
+        presentTime = std::chrono::high_resolution_clock::now();
+        steerInputDelay(frame.value, finishTime, presentTime);
+    }
+#endif
+
+    Sample sample         = {};
+    sample.inputToSubmit  = std::chrono::duration<float, std::milli>(frame.submitTime - frame.inputTime).count();
+    sample.inputToPresent = std::chrono::duration<float, std::milli>(presentTime - frame.inputTime).count();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_samples[m_nextSample] = sample;
+    m_nextSample            = (m_nextSample + 1) % LATENCY_HISTORY;
+    m_sampleCount           = std::min(m_sampleCount + 1, static_cast<uint32_t>(LATENCY_HISTORY));
+}
+
+// The delay only moves by a fraction of the slack per frame, as it takes a few frames for a change to show up in the slack measured
+void LatencyMonitor::steerInputDelay(const uint64_t frameValue, const std::chrono::high_resolution_clock::time_point& finishTime,
+                                     const std::chrono::high_resolution_clock::time_point& presentTime) {
+    if (m_lastPresentedValue != 0 && frameValue == m_lastPresentedValue + 1) {
+        m_presentInterval = std::chrono::duration<float, std::micro>(presentTime - m_lastPresentTime).count();
+    }
+
+    m_lastPresentTime    = presentTime;
+    m_lastPresentedValue = frameValue;
+
+    if (!m_justInTimeInput) {
+        return;
+    }
+
+    const float slack      = std::chrono::duration<float, std::micro>(presentTime - finishTime).count();
+    const float inputDelay = static_cast<float>(m_inputDelay.load()) + INPUT_DELAY_GAIN * (slack - static_cast<float>(INPUT_DELAY_MARGIN));
+
+    // Sleeping for longer than a present interval would only skip presents
+    m_inputDelay = static_cast<uint32_t>(std::clamp(inputDelay, 0.0f, m_presentInterval));
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "common.h"
+
+#pragma warning(push, 0)
+#define VK_ENABLE_BETA_EXTENSIONS
+#include "volk.h"
+#pragma warning(pop)
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Rolling statistics in milliseconds over the most recently completed frames
+struct LatencyStats {
+    float    inputToSubmit     = 0.0f;
+    float    inputToPresent    = 0.0f;
+    float    p99InputToPresent = 0.0f;
+    float    inputDelay        = 0.0f; // Slept before input is sampled
+    uint32_t sampleCount       = 0;
+};
+
+// Measures how long sampled input takes to reach the screen. A thread waits for every frame to be presented with VK_KHR_present_wait,
+// where that isn't available it only waits for the GPU to finish the frame, which leaves out the time it waits for the display.
+// With just in time input, frames that are finished before their present push the input delay up, so the next frames sample input later
+// and still make the same present. Frames finishing too close to their present bring it back down.
+class LatencyMonitor {
+  public:
+    LatencyMonitor(const VkDevice device, const VkSemaphore frameSemaphore, const bool presentWaitSupported, const bool justInTimeInput);
+    ~LatencyMonitor();
+
+    // Sleeps for the input delay, which stays zero without just in time input
+    void waitForInput() const;
+
+    // frameValue is the frame timeline value the frame signalled, it doubles as its present ID. Without a swapchain only the GPU is waited on.
+    void addFrame(const uint64_t frameValue, const VkSwapchainKHR swapchain, const std::chrono::high_resolution_clock::time_point& inputTime,
+                  const std::chrono::high_resolution_clock::time_point& submitTime);
+
+    // Drops the frames not yet waited on without blocking, a present of the retired swapchain may still be waited on until
+    // getWaitedSwapchain stops returning it
+    void retireSwapchain();
+
+    // The swapchain of the present being waited on, it must not be destroyed before that wait returns
+    const VkSwapchainKHR getWaitedSwapchain() const;
+
+    const LatencyStats getStats() const;
+    void               printStats() const;
+
+  private:
+    struct Frame {
+        uint64_t                                       value      = 0;
+        uint32_t                                       generation = 0; // Of the swapchain, frames of a retired one are dropped
+        VkSwapchainKHR                                 swapchain  = VK_NULL_HANDLE;
+        std::chrono::high_resolution_clock::time_point inputTime;
+        std::chrono::high_resolution_clock::time_point submitTime;
+    };
+
+    struct Sample {
+        float inputToSubmit  = 0.0f;
+        float inputToPresent = 0.0f;
+    };
+
+    const VkDevice    m_device;
+    const VkSemaphore m_frameSemaphore;
+    const bool        m_presentWaitSupported;
+    const bool        m_justInTimeInput;
+    void*             m_timer = nullptr; // High resolution waitable timer the input delay is slept on, spins without one
+
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_frameAdded;
+    std::deque<Frame>       m_frames; // Added and not waited on yet
+    std::vector<Sample>     m_samples;
+    uint32_t                m_sampleCount     = 0;
+    uint32_t                m_nextSample      = 0;
+    uint32_t                m_generation      = 0; // Bumped by every retired swapchain
+    VkSwapchainKHR          m_waitedSwapchain = VK_NULL_HANDLE;
+    bool                    m_stopping        = false;
+
+    // Only touched by the thread
+    std::chrono::high_resolution_clock::time_point m_lastPresentTime;
+    uint64_t                                       m_lastPresentedValue = 0;
+    uint32_t                                       m_lastGeneration     = 0;
+    float                                          m_presentInterval    = 0.0f; // Microseconds
+
+    std::atomic<uint32_t> m_inputDelay = 0; // Microseconds
+
+    std::thread m_thread;
+
+    void threadLoop();
+    void waitForFrame(const Frame& frame);
+    void steerInputDelay(const uint64_t frameValue, const std::chrono::high_resolution_clock::time_point& finishTime,
+                         const std::chrono::high_resolution_clock::time_point& presentTime);
+};
@@ -2,16 +2,33 @@
 
 #include "common.h"
 
+#include "bvh.h"
+#include "cpuRayTracer.h"
+#include "profiler.h"
+
 #include <stdexcept>
 
-int main(int, char*[]) {
-    Application application;
+int main(int argc, char* argv[]) {
     try {
-        application.run();
+        Settings settings = parseCommandLine(argc, argv);
+        setProfilingEnabled(!settings.traceFile.empty());
+
+        if (settings.bvhReport) {
+            printBvhReport(settings.meshFile.c_str(), settings.splitMeshes);
+        } else if (settings.cpuRayTracing) {
+            runCpuRayTracingBenchmark(settings);
+        } else {
+            Application application(settings);
+            application.run();
+        }
+
+        if (!settings.traceFile.empty()) {
+            writeChromeTrace(settings.traceFile.c_str());
+        }
     } catch (std::runtime_error e) {
         printf("%s/n", e.what());
         return -1;
     }
 
     return 0;
-}
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "mappedFile.h"
+
+#pragma warning(push, 0)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#pragma warning(pop)
+
+#include <stdexcept>
+#include <string>
+
+MappedFile::MappedFile(const char* path) {
+    // Sequential scan lets the OS read ahead aggressively, which is what the section copies want
+    m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        m_file = nullptr;
+        throw std::runtime_error(std::string("Couldn't open file ") + path + "!");
+    }
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(m_file);
+        throw std::runtime_error(std::string("Couldn't map empty or unreadable file ") + path + "!");
+    }
+    m_size = static_cast<uint64_t>(fileSize.QuadPart);
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        CloseHandle(m_file);
+        throw std::runtime_error(std::string("Couldn't create a mapping of file ") + path + "!");
+    }
+
+    m_data = reinterpret_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) {
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        throw std::runtime_error(std::string("Couldn't map file ") + path + "!");
+    }
+}
+
+MappedFile::~MappedFile() {
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+}
+
+const uint8_t* MappedFile::getData() const { return m_data; }
+
+const uint64_t MappedFile::getSize() const { return m_size; }
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "common.h"
+
+// Read only mapping of a whole file. Pages are read by the OS on first access, so copying out of the mapping is the only pass over the data.
+class MappedFile {
+  public:
+    MappedFile(const char* path);
+
+    ~MappedFile();
+
+    const uint8_t* getData() const;
+    const uint64_t getSize() const;
+
+  private:
+    void*          m_file    = nullptr;
+    void*          m_mapping = nullptr;
+    const uint8_t* m_data    = nullptr;
+    uint64_t       m_size    = 0;
+};
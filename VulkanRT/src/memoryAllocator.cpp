@@ -0,0 +1,287 @@
+#include "memoryAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <stdexcept>
+
+#define MEMORY_BLOCK_SIZE 67'108'864 // 64MB
+
+// Requests larger than this get a block of their own instead of eating most of a shared one
+#define DEDICATED_ALLOCATION_THRESHOLD (MEMORY_BLOCK_SIZE / 2)
+
+static VkDeviceSize alignUp(const VkDeviceSize value, const VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+static const char* getMemoryUsageName(const MemoryUsage usage) {
+    switch (usage) {
+    case MemoryUsage::DeviceAddressBuffer:
+        return "device address buffers";
+    case MemoryUsage::AccelerationStructure:
+        return "acceleration structures";
+    case MemoryUsage::Staging:
+        return "staging";
+    case MemoryUsage::MappedDeviceAddressBuffer:
+        return "mapped device address buffers";
+    case MemoryUsage::Image:
+        return "images";
+    default:
+        return "unknown";
+    }
+}
+
+uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties, const uint32_t memoryTypeBits,
+                        const VkMemoryPropertyFlags memoryPropertyFlags) {
+    uint32_t memoryType = UINT32_MAX;
+    for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; ++i) {
+        bool memoryIsOfRequiredType        = memoryTypeBits & (1 << i);
+        bool memoryHasDesiredPropertyFlags = (physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & memoryPropertyFlags) == memoryPropertyFlags;
+
+        if (memoryIsOfRequiredType && memoryHasDesiredPropertyFlags) {
+            memoryType = i;
+            break;
+        }
+    }
+
+    if (memoryType == UINT32_MAX) {
+        throw std::runtime_error("Couldn't find a suitable memory type!");
+    }
+
+    return memoryType;
+}
+
+MemoryAllocator::MemoryAllocator(const VkDevice& device, const VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties,
+                                 const VkPhysicalDeviceLimits& limits)
+    : m_device(device), m_physicalDeviceMemoryProperties(physicalDeviceMemoryProperties), m_bufferImageGranularity(limits.bufferImageGranularity),
+      m_maxMemoryAllocationCount(limits.maxMemoryAllocationCount) {}
+
+MemoryAllocator::~MemoryAllocator() {
+    for (MemoryPool& pool : m_pools) {
+        for (MemoryBlock& block : pool.blocks) {
+            assert(block.allocationCount == 0);
+            vkFreeMemory(m_device, block.memory, nullptr);
+        }
+    }
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& memoryRequirements, const MemoryUsage usage) {
+    VkDeviceSize size      = memoryRequirements.size;
+    VkDeviceSize alignment = std::max<VkDeviceSize>(memoryRequirements.alignment, 1);
+
+    // Image pools only ever hold optimal tiling images, padding them to the granularity keeps that true even if a linear resource is ever added
+    if (usage == MemoryUsage::Image) {
+        alignment = std::max(alignment, m_bufferImageGranularity);
+        size      = alignUp(size, m_bufferImageGranularity);
+    }
+
+    Allocation allocation = {};
+    allocation.poolIndex  = getPoolIndex(memoryRequirements.memoryTypeBits, usage);
+    allocation.size       = size;
+
+    MemoryPool& pool = m_pools[allocation.poolIndex];
+
+    if (size > DEDICATED_ALLOCATION_THRESHOLD) {
+        allocation.blockIndex = createBlock(pool, size, true);
+        allocateFromBlock(pool.blocks[allocation.blockIndex], size, alignment, allocation.offset);
+    } else {
+        for (uint32_t i = 0; i < static_cast<uint32_t>(pool.blocks.size()); ++i) {
+            MemoryBlock& block = pool.blocks[i];
+            if (block.memory != VK_NULL_HANDLE && !block.dedicated && allocateFromBlock(block, size, alignment, allocation.offset)) {
+                allocation.blockIndex = i;
+                break;
+            }
+        }
+
+        if (allocation.blockIndex == UINT32_MAX) {
+            allocation.blockIndex = createBlock(pool, MEMORY_BLOCK_SIZE, false);
+            allocateFromBlock(pool.blocks[allocation.blockIndex], size, alignment, allocation.offset);
+        }
+    }
+
+    MemoryBlock& block = pool.blocks[allocation.blockIndex];
+    ++block.allocationCount;
+
+    allocation.memory = block.memory;
+    if (block.mappedData) {
+        allocation.mappedData = block.mappedData + allocation.offset;
+    }
+
+    return allocation;
+}
+
+void MemoryAllocator::deallocate(Allocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    MemoryBlock& block = m_pools[allocation.poolIndex].blocks[allocation.blockIndex];
+    assert(block.memory == allocation.memory && block.allocationCount > 0);
+
+    VkDeviceSize offset = allocation.offset;
+    VkDeviceSize size   = allocation.size;
+
+    // Merge with the free range that ends where this one starts, and with the one that starts where this one ends
+    std::map<VkDeviceSize, VkDeviceSize>::iterator next = block.freeRanges.lower_bound(offset);
+    if (next != block.freeRanges.begin()) {
+        std::map<VkDeviceSize, VkDeviceSize>::iterator previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            block.freeRanges.erase(previous);
+        }
+    }
+
+    if (next != block.freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        block.freeRanges.erase(next);
+    }
+
+    block.freeRanges[offset] = size;
+    --block.allocationCount;
+
+    if (block.dedicated && block.allocationCount == 0) {
+        vkFreeMemory(m_device, block.memory, nullptr);
+        block = {};
+        --m_deviceMemoryCount;
+    }
+
+    allocation = {};
+}
+
+const MemoryStats MemoryAllocator::getStats(const MemoryUsage usage) const {
+    MemoryStats stats = {};
+    for (const MemoryPool& pool : m_pools) {
+        if (pool.usage != usage) {
+            continue;
+        }
+
+        for (const MemoryBlock& block : pool.blocks) {
+            if (block.memory == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            VkDeviceSize freeBytes = 0;
+            for (const std::pair<const VkDeviceSize, VkDeviceSize>& freeRange : block.freeRanges) {
+                freeBytes += freeRange.second;
+            }
+
+            ++stats.blockCount;
+            stats.allocationCount += block.allocationCount;
+            stats.reservedBytes += block.size;
+            stats.usedBytes += block.size - freeBytes;
+        }
+    }
+
+    return stats;
+}
+
+void MemoryAllocator::printStats() const {
+    printf("Device memory: %u of %u allocations used\n", m_deviceMemoryCount, m_maxMemoryAllocationCount);
+
+    for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryUsage::Count); ++i) {
+        MemoryUsage usage = static_cast<MemoryUsage>(i);
+        MemoryStats stats = getStats(usage);
+        if (stats.blockCount == 0) {
+            continue;
+        }
+
+        printf("    %s: %u allocations in %u blocks, %.2fMB of %.2fMB used\n", getMemoryUsageName(usage), stats.allocationCount, stats.blockCount,
+               static_cast<double>(stats.usedBytes) / 1'048'576.0, static_cast<double>(stats.reservedBytes) / 1'048'576.0);
+    }
+}
+
+const VkMemoryPropertyFlags MemoryAllocator::getMemoryPropertyFlags(const MemoryUsage usage) const {
+    if (usage == MemoryUsage::Staging || usage == MemoryUsage::MappedDeviceAddressBuffer) {
+        return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    }
+
+    return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+}
+
+const uint32_t MemoryAllocator::getPoolIndex(const uint32_t memoryTypeBits, const MemoryUsage usage) {
+    uint32_t memoryType = findMemoryType(m_physicalDeviceMemoryProperties, memoryTypeBits, getMemoryPropertyFlags(usage));
+
+    for (uint32_t i = 0; i < static_cast<uint32_t>(m_pools.size()); ++i) {
+        if (m_pools[i].memoryType == memoryType && m_pools[i].usage == usage) {
+            return i;
+        }
+    }
+
+    MemoryPool pool = {};
+    pool.memoryType = memoryType;
+    pool.usage      = usage;
+    m_pools.push_back(pool);
+
+    return static_cast<uint32_t>(m_pools.size() - 1);
+}
+
+const uint32_t MemoryAllocator::createBlock(MemoryPool& pool, const VkDeviceSize size, const bool dedicated) {
+    if (m_deviceMemoryCount >= m_maxMemoryAllocationCount) {
+        throw std::runtime_error("Exceeded maxMemoryAllocationCount!");
+    }
+
+    VkMemoryAllocateInfo memoryAllocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    memoryAllocateInfo.allocationSize       = size;
+    memoryAllocateInfo.memoryTypeIndex      = pool.memoryType;
+
+    VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO};
+    if (pool.usage == MemoryUsage::DeviceAddressBuffer || pool.usage == MemoryUsage::AccelerationStructure ||
+        pool.usage == MemoryUsage::MappedDeviceAddressBuffer) {
+        memoryAllocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+        memoryAllocateInfo.pNext      = &memoryAllocateFlagsInfo;
+    }
+
+    MemoryBlock block = {};
+    block.size        = size;
+    block.dedicated   = dedicated;
+    block.freeRanges.emplace(0, size);
+
+    if (vkAllocateMemory(m_device, &memoryAllocateInfo, nullptr, &block.memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate device memory!");
+    }
+    ++m_deviceMemoryCount;
+
+    if (getMemoryPropertyFlags(pool.usage) & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void* mappedData = nullptr;
+        VK_CHECK(vkMapMemory(m_device, block.memory, 0, VK_WHOLE_SIZE, 0, &mappedData));
+        block.mappedData = reinterpret_cast<uint8_t*>(mappedData);
+    }
+
+    // Reuse the slot of a released dedicated block so the indices held by live allocations stay valid
+    for (uint32_t i = 0; i < static_cast<uint32_t>(pool.blocks.size()); ++i) {
+        if (pool.blocks[i].memory == VK_NULL_HANDLE) {
+            pool.blocks[i] = block;
+            return i;
+        }
+    }
+
+    pool.blocks.push_back(block);
+
+    return static_cast<uint32_t>(pool.blocks.size() - 1);
+}
+
+const bool MemoryAllocator::allocateFromBlock(MemoryBlock& block, const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize& offset) const {
+    for (std::map<VkDeviceSize, VkDeviceSize>::iterator freeRange = block.freeRanges.begin(); freeRange != block.freeRanges.end(); ++freeRange) {
+        VkDeviceSize rangeStart   = freeRange->first;
+        VkDeviceSize rangeEnd     = freeRange->first + freeRange->second;
+        VkDeviceSize alignedStart = alignUp(rangeStart, alignment);
+
+        if (alignedStart + size > rangeEnd) {
+            continue;
+        }
+
+        block.freeRanges.erase(freeRange);
+
+        if (alignedStart > rangeStart) {
+            block.freeRanges.emplace(rangeStart, alignedStart - rangeStart);
+        }
+
+        if (alignedStart + size < rangeEnd) {
+            block.freeRanges.emplace(alignedStart + size, rangeEnd - alignedStart - size);
+        }
+
+        offset = alignedStart;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "common.h"
+
+#pragma warning(push, 0)
+#define VK_ENABLE_BETA_EXTENSIONS
+#include "volk.h"
+#pragma warning(pop)
+
+#include <map>
+#include <vector>
+
+uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties, const uint32_t memoryTypeBits,
+                        const VkMemoryPropertyFlags memoryPropertyFlags);
+
+// Every usage class gets its own pools, so linear and optimal resources never share a block
+enum class MemoryUsage {
+    DeviceAddressBuffer,       // Device local buffers, blocks allocated with VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+    AccelerationStructure,     // Acceleration structure storage
+    Staging,                   // Host visible and coherent, blocks stay persistently mapped
+    MappedDeviceAddressBuffer, // Like staging, but also device addressable, for data the host rewrites and the device reads in place
+    Image,                     // Device local optimal tiling images
+    Count
+};
+
+struct Allocation {
+    VkDeviceMemory memory     = VK_NULL_HANDLE;
+    VkDeviceSize   offset     = 0;
+    VkDeviceSize   size       = 0;
+    void*          mappedData = nullptr; // Only set for host visible allocations
+    uint32_t       poolIndex  = UINT32_MAX;
+    uint32_t       blockIndex = UINT32_MAX;
+};
+
+struct MemoryStats {
+    uint32_t     blockCount      = 0;
+    uint32_t     allocationCount = 0;
+    VkDeviceSize reservedBytes   = 0; // Sum of all block sizes
+    VkDeviceSize usedBytes       = 0; // Sum of all live sub-allocation sizes
+};
+
+class MemoryAllocator {
+  public:
+    MemoryAllocator(const VkDevice& device, const VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties, const VkPhysicalDeviceLimits& limits);
+
+    ~MemoryAllocator();
+
+    Allocation allocate(const VkMemoryRequirements& memoryRequirements, const MemoryUsage usage);
+    void       deallocate(Allocation& allocation);
+
+    const MemoryStats getStats(const MemoryUsage usage) const;
+    void              printStats() const;
+
+  private:
+    struct MemoryBlock {
+        VkDeviceMemory memory          = VK_NULL_HANDLE;
+        VkDeviceSize   size            = 0;
+        uint8_t*       mappedData      = nullptr;
+        uint32_t       allocationCount = 0;
+        bool           dedicated       = false;
+
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges; // Offset to size, adjacent ranges are always merged
+    };
+
+    struct MemoryPool {
+        uint32_t                 memoryType = UINT32_MAX;
+        MemoryUsage              usage      = MemoryUsage::Count;
+        std::vector<MemoryBlock> blocks;
+    };
+
+    const VkDevice                         m_device;
+    const VkPhysicalDeviceMemoryProperties m_physicalDeviceMemoryProperties;
+    const VkDeviceSize                     m_bufferImageGranularity;
+    const uint32_t                         m_maxMemoryAllocationCount;
+
+    std::vector<MemoryPool> m_pools;
+
+    uint32_t m_deviceMemoryCount = 0;
+
+    const VkMemoryPropertyFlags getMemoryPropertyFlags(const MemoryUsage usage) const;
+    const uint32_t              getPoolIndex(const uint32_t memoryTypeBits, const MemoryUsage usage);
+    const uint32_t              createBlock(MemoryPool& pool, const VkDeviceSize size, const bool dedicated);
+    const bool                  allocateFromBlock(MemoryBlock& block, const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize& offset) const;
+};
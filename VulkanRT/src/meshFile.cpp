@@ -0,0 +1,212 @@
+#include "meshFile.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+static uint64_t alignUp(const uint64_t value, const uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+static uint64_t getIndexSize(const uint32_t indexType) { return indexType == MESH_INDEX_TYPE_UINT32 ? sizeof(uint32_t) : sizeof(uint16_t); }
+
+static uint64_t getAttributeStride(const uint32_t attributes) {
+    uint64_t stride = MESH_NORMAL_STRIDE;
+    stride += attributes & MESH_ATTRIBUTE_UV ? MESH_UV_STRIDE : 0;
+    stride += attributes & MESH_ATTRIBUTE_TANGENT ? MESH_TANGENT_STRIDE : 0;
+
+    return stride;
+}
+
+// Pads from position up to offset, so every section lands on the offset its entry points to
+static void writeSection(FILE* file, uint64_t& position, const uint64_t offset, const void* data, const uint64_t size) {
+    static const uint8_t padding[MESH_FILE_ALIGNMENT] = {};
+
+    fwrite(padding, 1, static_cast<size_t>(offset - position), file);
+    if (size > 0) {
+        fwrite(data, 1, static_cast<size_t>(size), file);
+    }
+    position = offset + size;
+}
+
+static bool sectionValid(const uint64_t offset, const uint64_t size, const uint64_t fileSize) {
+    return offset % MESH_FILE_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+}
+
+// The BVH build and the CPU ray tracer index vertices with these directly, so they have to stay within the mesh
+template <typename Index> static bool indicesValid(const uint8_t* data, const MeshFileEntry& entry) {
+    const Index* indices = reinterpret_cast<const Index*>(data + entry.indexOffset);
+    for (uint32_t i = 0; i < entry.indexCount; ++i) {
+        if (indices[i] >= entry.vertexCount) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+MeshFile::MeshFile(const char* path) : m_mappedFile(path) {
+    const uint8_t* data     = m_mappedFile.getData();
+    const uint64_t fileSize = m_mappedFile.getSize();
+
+    if (fileSize < sizeof(MeshFileHeader)) {
+        throw std::runtime_error(std::string("Mesh file ") + path + " is too small!");
+    }
+
+    m_header = reinterpret_cast<const MeshFileHeader*>(data);
+    if (m_header->magic != MESH_FILE_MAGIC) {
+        throw std::runtime_error(std::string("File ") + path + " is not a mesh file!");
+    }
+
+    if (m_header->version != MESH_FILE_VERSION) {
+        throw std::runtime_error(std::string("Mesh file ") + path + " has an unsupported version!");
+    }
+
+    if (m_header->fileSize != fileSize || (fileSize - sizeof(MeshFileHeader)) / sizeof(MeshFileEntry) < m_header->meshCount) {
+        throw std::runtime_error(std::string("Mesh file ") + path + " is truncated!");
+    }
+
+    m_entries = reinterpret_cast<const MeshFileEntry*>(data + sizeof(MeshFileHeader));
+
+    for (uint32_t i = 0; i < m_header->meshCount; ++i) {
+        const MeshFileEntry& entry = m_entries[i];
+
+        bool indexTypeValid  = entry.indexType == MESH_INDEX_TYPE_UINT16 || entry.indexType == MESH_INDEX_TYPE_UINT32;
+        bool attributesValid = (entry.attributes & ~(MESH_ATTRIBUTE_UV | MESH_ATTRIBUTE_TANGENT)) == 0;
+        if (!indexTypeValid || !attributesValid || entry.indexCount % 3 != 0 ||
+            !sectionValid(entry.vertexOffset, static_cast<uint64_t>(entry.vertexCount) * MESH_VERTEX_STRIDE, fileSize) ||
+            !sectionValid(entry.indexOffset, static_cast<uint64_t>(entry.indexCount) * getIndexSize(entry.indexType), fileSize) ||
+            !sectionValid(entry.attributeOffset, static_cast<uint64_t>(entry.vertexCount) * getAttributeStride(entry.attributes), fileSize)) {
+            throw std::runtime_error(std::string("Mesh file ") + path + " has a corrupt mesh entry!");
+        }
+
+        bool indicesInRange = entry.indexType == MESH_INDEX_TYPE_UINT32 ? indicesValid<uint32_t>(data, entry) : indicesValid<uint16_t>(data, entry);
+        if (!indicesInRange) {
+            throw std::runtime_error(std::string("Mesh file ") + path + " has indices past the end of its vertices!");
+        }
+    }
+}
+
+const uint32_t getIndex(const MeshView& meshView, const uint64_t index) {
+    assert(index < meshView.entry->indexCount);
+
+    if (meshView.entry->indexType == MESH_INDEX_TYPE_UINT32) {
+        return static_cast<const uint32_t*>(meshView.indices)[index];
+    }
+
+    return static_cast<const uint16_t*>(meshView.indices)[index];
+}
+
+const uint32_t MeshFile::getMeshCount() const { return m_header->meshCount; }
+
+const MeshView MeshFile::getMesh(const uint32_t meshIndex) const {
+    assert(meshIndex < m_header->meshCount);
+
+    const MeshFileEntry& entry = m_entries[meshIndex];
+
+    MeshView meshView   = {};
+    meshView.entry      = &entry;
+    meshView.vertices   = m_mappedFile.getData() + entry.vertexOffset;
+    meshView.indices    = m_mappedFile.getData() + entry.indexOffset;
+    meshView.normals    = m_mappedFile.getData() + entry.attributeOffset;
+    meshView.vertexSize = static_cast<uint64_t>(entry.vertexCount) * MESH_VERTEX_STRIDE;
+    meshView.indexSize  = static_cast<uint64_t>(entry.indexCount) * getIndexSize(entry.indexType);
+
+    uint64_t attributeOffset = entry.attributeOffset + static_cast<uint64_t>(entry.vertexCount) * MESH_NORMAL_STRIDE;
+    if (entry.attributes & MESH_ATTRIBUTE_UV) {
+        meshView.uvs = m_mappedFile.getData() + attributeOffset;
+        attributeOffset += static_cast<uint64_t>(entry.vertexCount) * MESH_UV_STRIDE;
+    }
+
+    if (entry.attributes & MESH_ATTRIBUTE_TANGENT) {
+        meshView.tangents = m_mappedFile.getData() + attributeOffset;
+    }
+
+    return meshView;
+}
+
+void writeMeshFile(const char* path, const std::vector<MeshData>& meshes) {
+    MeshFileHeader header = {};
+    header.meshCount      = static_cast<uint32_t>(meshes.size());
+
+    std::vector<MeshFileEntry> entries(meshes.size());
+
+    uint64_t offset = alignUp(sizeof(MeshFileHeader) + sizeof(MeshFileEntry) * meshes.size(), MESH_FILE_ALIGNMENT);
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const MeshData& mesh  = meshes[i];
+        MeshFileEntry&  entry = entries[i];
+
+        entry.vertexCount = static_cast<uint32_t>(mesh.vertices.size() / 3);
+        entry.indexCount  = static_cast<uint32_t>(mesh.indices.size());
+        entry.indexType   = entry.vertexCount > MESH_UINT16_MAX_VERTICES ? MESH_INDEX_TYPE_UINT32 : MESH_INDEX_TYPE_UINT16;
+        entry.buildHints  = mesh.buildHints;
+        entry.attributes  = (mesh.uvs.empty() ? 0 : MESH_ATTRIBUTE_UV) | (mesh.tangents.empty() ? 0 : MESH_ATTRIBUTE_TANGENT);
+
+        assert(mesh.normals.size() == mesh.vertices.size());
+
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            entry.boundsMin[axis] = mesh.vertices.empty() ? 0.0f : FLT_MAX;
+            entry.boundsMax[axis] = mesh.vertices.empty() ? 0.0f : -FLT_MAX;
+        }
+
+        for (size_t vertex = 0; vertex < entry.vertexCount; ++vertex) {
+            for (uint32_t axis = 0; axis < 3; ++axis) {
+                entry.boundsMin[axis] = std::min(entry.boundsMin[axis], mesh.vertices[3 * vertex + axis]);
+                entry.boundsMax[axis] = std::max(entry.boundsMax[axis], mesh.vertices[3 * vertex + axis]);
+            }
+        }
+
+        entry.vertexOffset = offset;
+        offset             = alignUp(offset + entry.vertexCount * MESH_VERTEX_STRIDE, MESH_FILE_ALIGNMENT);
+        entry.indexOffset  = offset;
+        offset             = alignUp(offset + entry.indexCount * getIndexSize(entry.indexType), MESH_FILE_ALIGNMENT);
+
+        entry.attributeOffset = offset;
+        offset                = alignUp(offset + entry.vertexCount * getAttributeStride(entry.attributes), MESH_FILE_ALIGNMENT);
+    }
+
+    header.fileSize = offset;
+
+    FILE* file;
+    fopen_s(&file, path, "wb");
+    if (!file) {
+        throw std::runtime_error(std::string("Couldn't open mesh file ") + path + " for writing!");
+    }
+
+    uint64_t position = 0;
+    writeSection(file, position, 0, &header, sizeof(header));
+    writeSection(file, position, sizeof(header), entries.data(), sizeof(MeshFileEntry) * entries.size());
+
+    std::vector<uint16_t> narrowedIndices;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const MeshData&      mesh  = meshes[i];
+        const MeshFileEntry& entry = entries[i];
+
+        writeSection(file, position, entry.vertexOffset, mesh.vertices.data(), entry.vertexCount * MESH_VERTEX_STRIDE);
+
+        if (entry.indexType == MESH_INDEX_TYPE_UINT16) {
+            narrowedIndices.resize(mesh.indices.size());
+            for (size_t index = 0; index < mesh.indices.size(); ++index) {
+                narrowedIndices[index] = static_cast<uint16_t>(mesh.indices[index]);
+            }
+            writeSection(file, position, entry.indexOffset, narrowedIndices.data(), sizeof(uint16_t) * narrowedIndices.size());
+        } else {
+            writeSection(file, position, entry.indexOffset, mesh.indices.data(), sizeof(uint32_t) * mesh.indices.size());
+        }
+
+        // The streams follow each other without padding, only the section as a whole is aligned
+        writeSection(file, position, entry.attributeOffset, mesh.normals.data(), sizeof(float) * mesh.normals.size());
+        writeSection(file, position, position, mesh.uvs.data(), sizeof(float) * mesh.uvs.size());
+        writeSection(file, position, position, mesh.tangents.data(), sizeof(float) * mesh.tangents.size());
+    }
+
+    // Pads the last section out to the size recorded in the header
+    writeSection(file, position, header.fileSize, nullptr, 0);
+
+    bool writeFailed = ferror(file) != 0;
+    fclose(file);
+
+    if (writeFailed) {
+        throw std::runtime_error(std::string("Couldn't write mesh file ") + path + "!");
+    }
+}
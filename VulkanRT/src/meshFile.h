@@ -0,0 +1,104 @@
+#pragma once
+
+#include "common.h"
+
+#include "mappedFile.h"
+
+#include <vector>
+
+// Binary mesh container, laid out so sections can be copied out of a file mapping as they are:
+// a MeshFileHeader, followed by meshCount MeshFileEntry records, followed by the vertex, index and attribute sections they point to.
+// Every section starts at a multiple of MESH_FILE_ALIGNMENT, all values are little endian.
+#define MESH_FILE_MAGIC     0x4853454D // "MESH"
+#define MESH_FILE_VERSION   2
+#define MESH_FILE_ALIGNMENT 64
+
+// Vertices are three floats of position, tightly packed
+#define MESH_VERTEX_STRIDE (3 * sizeof(float))
+
+// The attribute section holds one tightly packed stream after the other: normals, then UVs and tangents if the entry has them
+#define MESH_NORMAL_STRIDE  (3 * sizeof(float))
+#define MESH_UV_STRIDE      (2 * sizeof(float))
+#define MESH_TANGENT_STRIDE (4 * sizeof(float)) // w is the sign of the bitangent, which is cross(normal, tangent) * w
+
+#define MESH_ATTRIBUTE_UV      0x1
+#define MESH_ATTRIBUTE_TANGENT 0x2
+
+#define MESH_INDEX_TYPE_UINT16 0
+#define MESH_INDEX_TYPE_UINT32 1
+
+// Meshes with more vertices than this need 32 bit indices
+#define MESH_UINT16_MAX_VERTICES 65'536
+
+// Bottom level acceleration structure build hints
+#define MESH_BUILD_PREFER_FAST_TRACE 0x1
+#define MESH_BUILD_PREFER_FAST_BUILD 0x2
+#define MESH_BUILD_LOW_MEMORY        0x4
+
+struct MeshFileHeader {
+    uint32_t magic     = MESH_FILE_MAGIC;
+    uint32_t version   = MESH_FILE_VERSION;
+    uint32_t meshCount = 0;
+    uint32_t reserved  = 0;
+    uint64_t fileSize  = 0; // Catches truncated files before any section is touched
+};
+
+struct MeshFileEntry {
+    uint64_t vertexOffset    = 0; // In bytes from the start of the file
+    uint64_t indexOffset     = 0;
+    uint64_t attributeOffset = 0;
+    uint32_t vertexCount     = 0;
+    uint32_t indexCount      = 0;
+    uint32_t indexType       = MESH_INDEX_TYPE_UINT16;
+    uint32_t buildHints      = MESH_BUILD_PREFER_FAST_TRACE;
+    uint32_t attributes      = 0; // Optional streams, normals are always there
+    uint32_t reserved        = 0;
+    float    boundsMin[3]    = {};
+    float    boundsMax[3]    = {};
+};
+
+static_assert(sizeof(MeshFileHeader) == 24, "MeshFileHeader layout is part of the file format");
+static_assert(sizeof(MeshFileEntry) == 72, "MeshFileEntry layout is part of the file format");
+
+// Points into the mapping of the file it came from, it's only valid as long as that MeshFile is
+struct MeshView {
+    const MeshFileEntry* entry      = nullptr;
+    const void*          vertices   = nullptr;
+    const void*          indices    = nullptr;
+    const void*          normals    = nullptr;
+    const void*          uvs        = nullptr; // Null without MESH_ATTRIBUTE_UV
+    const void*          tangents   = nullptr; // Null without MESH_ATTRIBUTE_TANGENT
+    uint64_t             vertexSize = 0;
+    uint64_t             indexSize  = 0;
+};
+
+// Reads an index of either index type, relative to the mesh's first vertex
+const uint32_t getIndex(const MeshView& meshView, const uint64_t index);
+
+// Validates the header, the section bounds and the indices of every mesh on load, the other section bytes are never touched
+class MeshFile {
+  public:
+    MeshFile(const char* path);
+
+    const uint32_t getMeshCount() const;
+    const MeshView getMesh(const uint32_t meshIndex) const;
+
+  private:
+    MappedFile m_mappedFile;
+
+    const MeshFileHeader* m_header  = nullptr;
+    const MeshFileEntry*  m_entries = nullptr;
+};
+
+// Input of writeMeshFile, indices are narrowed to 16 bits whenever the vertex count allows it.
+// Normals are required, UVs and tangents are written when they aren't empty.
+struct MeshData {
+    std::vector<float>    vertices;
+    std::vector<uint32_t> indices;
+    std::vector<float>    normals;
+    std::vector<float>    uvs;
+    std::vector<float>    tangents;
+    uint32_t              buildHints = MESH_BUILD_PREFER_FAST_TRACE;
+};
+
+void writeMeshFile(const char* path, const std::vector<MeshData>& meshes);
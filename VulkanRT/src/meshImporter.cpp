@@ -0,0 +1,1319 @@
+#include "meshImporter.h"
+
+#include "mappedFile.h"
+#include "profiler.h"
+#include "tasks.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+// Part of the cache key, has to be bumped whenever the importer output changes
+#define MESH_IMPORTER_VERSION 2
+#define MESH_CACHE_DIRECTORY  "meshCache"
+
+// Smaller pieces of work aren't worth a thread of their own
+#define MIN_PARSE_CHUNK_SIZE  65'536
+#define MIN_VERTEX_TASK_SIZE  16'384
+#define HASH_CHUNK_SIZE       4'194'304 // Fixed, so the source hash doesn't depend on the core count
+#define VERTEX_MAP_SHARDS     64
+#define FNV_OFFSET_BASIS      0xCBF29CE484222325
+#define FNV_PRIME             0x100000001B3
+#define INVALID_MESH_INDEX    UINT32_MAX
+#define MIN_UV_AREA           1e-12f // Triangles with less UV area than this don't contribute to tangents
+
+static uint64_t hashBytes(const uint8_t* data, const uint64_t size, uint64_t hash = FNV_OFFSET_BASIS) {
+    for (uint64_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+struct HashTask {
+    const uint8_t* data        = nullptr;
+    uint64_t       size        = 0;
+    uint64_t*      chunkHashes = nullptr;
+    uint64_t       firstChunk  = 0;
+    uint64_t       lastChunk   = 0;
+};
+
+static void hashChunks(HashTask& task) {
+    for (uint64_t chunk = task.firstChunk; chunk < task.lastChunk; ++chunk) {
+        uint64_t offset         = chunk * HASH_CHUNK_SIZE;
+        task.chunkHashes[chunk] = hashBytes(task.data + offset, std::min(task.size - offset, uint64_t(HASH_CHUNK_SIZE)));
+    }
+}
+
+// Hashes fixed size chunks in parallel and then the chunk hashes, seeded with the versions and options that change what an import produces
+static uint64_t hashSource(JobSystem& jobSystem, const MappedFile& sourceFile, const bool splitMeshes) {
+    PROFILE_ZONE("hashSource");
+
+    uint64_t chunkCount = (sourceFile.getSize() + HASH_CHUNK_SIZE - 1) / HASH_CHUNK_SIZE;
+
+    std::vector<uint64_t> chunkHashes(chunkCount);
+    std::vector<HashTask> tasks(getTaskCount(jobSystem, chunkCount, 1));
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].data        = sourceFile.getData();
+        tasks[i].size        = sourceFile.getSize();
+        tasks[i].chunkHashes = chunkHashes.data();
+        tasks[i].firstChunk  = chunkCount * i / tasks.size();
+        tasks[i].lastChunk   = chunkCount * (i + 1) / tasks.size();
+    }
+
+    runTasks(jobSystem, hashChunks, tasks);
+
+    uint32_t options[3] = {MESH_IMPORTER_VERSION, MESH_FILE_VERSION, splitMeshes ? 1u : 0u};
+    uint64_t hash       = hashBytes(reinterpret_cast<const uint8_t*>(options), sizeof(options));
+
+    return hashBytes(reinterpret_cast<const uint8_t*>(chunkHashes.data()), sizeof(uint64_t) * chunkHashes.size(), hash);
+}
+
+static const char* skipSpaces(const char* c, const char* end) {
+    while (c < end && (*c == ' ' || *c == '\t')) {
+        ++c;
+    }
+
+    return c;
+}
+
+static const char* skipLine(const char* c, const char* end) {
+    const char* newline = reinterpret_cast<const char*>(memchr(c, '\n', static_cast<size_t>(end - c)));
+    return newline ? newline + 1 : end;
+}
+
+// Negative OBJ indices count back from the latest vertex, they can only be resolved once the vertex counts of the chunks before are known
+struct ObjIndex {
+    int64_t value    = 0;
+    bool    relative = false; // Relative to the first vertex of the chunk instead of the file
+};
+
+struct ObjChunk {
+    const char* begin = nullptr;
+    const char* end   = nullptr;
+
+    std::vector<float>    positions;
+    std::vector<float>    uvs;
+    std::vector<ObjIndex> indices; // Already triangulated
+    std::vector<ObjIndex> uvIndices;
+    std::string           error;
+
+    uint64_t  firstVertex = 0;
+    uint64_t  firstUv     = 0;
+    uint32_t* output      = nullptr; // Where the resolved indices of the chunk go
+    uint32_t* uvOutput    = nullptr;
+};
+
+static bool parseObjFloats(const char*& c, const char* end, const uint32_t count, std::vector<float>& values) {
+    for (uint32_t i = 0; i < count; ++i) {
+        c = skipSpaces(c, end);
+
+        float                  value  = 0.0f;
+        std::from_chars_result result = std::from_chars(c, end, value);
+        if (result.ec != std::errc()) {
+            return false;
+        }
+
+        values.push_back(value);
+        c = result.ptr;
+    }
+
+    return true;
+}
+
+// OBJ indices start at one, so zero stays invalid, and negative ones count back from elementCount
+static ObjIndex makeObjIndex(const int64_t value, const size_t elementCount) {
+    ObjIndex index = {};
+    if (value < 0) {
+        index.value    = static_cast<int64_t>(elementCount) + value;
+        index.relative = true;
+    } else {
+        index.value = value - 1;
+    }
+
+    return index;
+}
+
+static void parseObjChunk(ObjChunk& chunk) {
+    const char* end = chunk.end;
+
+    std::vector<ObjIndex> polygon;
+    std::vector<ObjIndex> polygonUvs;
+
+    const char* c = chunk.begin;
+    while (c < end) {
+        c = skipSpaces(c, end);
+
+        if (end - c > 1 && c[0] == 'v' && (c[1] == ' ' || c[1] == '\t')) {
+            c += 2;
+            if (!parseObjFloats(c, end, 3, chunk.positions)) {
+                chunk.error = "malformed vertex";
+                return;
+            }
+        } else if (end - c > 2 && c[0] == 'v' && c[1] == 't' && (c[2] == ' ' || c[2] == '\t')) {
+            c += 3;
+            if (!parseObjFloats(c, end, 2, chunk.uvs)) {
+                chunk.error = "malformed texture coordinate";
+                return;
+            }
+        } else if (end - c > 1 && c[0] == 'f' && (c[1] == ' ' || c[1] == '\t')) {
+            c += 2;
+
+            polygon.clear();
+            polygonUvs.clear();
+            for (;;) {
+                c = skipSpaces(c, end);
+                if (c == end || *c == '\n' || *c == '\r' || *c == '#') {
+                    break;
+                }
+
+                int64_t                value  = 0;
+                std::from_chars_result result = std::from_chars(c, end, value);
+                if (result.ec != std::errc() || value == 0) {
+                    chunk.error = "malformed face";
+                    return;
+                }
+
+                polygon.push_back(makeObjIndex(value, chunk.positions.size() / 3));
+                c = result.ptr;
+
+                // Corners without a texture coordinate get an invalid one. Normal indices aren't used, normals are generated.
+                int64_t uvValue = 0;
+                if (c < end && *c == '/') {
+                    result  = std::from_chars(c + 1, end, uvValue);
+                    uvValue = result.ec == std::errc() ? uvValue : 0;
+                }
+
+                polygonUvs.push_back(makeObjIndex(uvValue, chunk.uvs.size() / 2));
+
+                while (c < end && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n') {
+                    ++c;
+                }
+            }
+
+            if (polygon.size() < 3) {
+                chunk.error = "face with less than three vertices";
+                return;
+            }
+
+            for (size_t i = 2; i < polygon.size(); ++i) {
+                chunk.indices.push_back(polygon[0]);
+                chunk.indices.push_back(polygon[i - 1]);
+                chunk.indices.push_back(polygon[i]);
+
+                chunk.uvIndices.push_back(polygonUvs[0]);
+                chunk.uvIndices.push_back(polygonUvs[i - 1]);
+                chunk.uvIndices.push_back(polygonUvs[i]);
+            }
+        }
+
+        c = skipLine(c, end);
+    }
+}
+
+static uint32_t resolveObjIndex(const ObjIndex& index, const uint64_t first) {
+    int64_t resolved = index.relative ? static_cast<int64_t>(first) + index.value : index.value;
+    return resolved >= 0 && resolved < INVALID_MESH_INDEX ? static_cast<uint32_t>(resolved) : INVALID_MESH_INDEX;
+}
+
+// Out of range indices are made invalid here and rejected once vertices are merged
+static void resolveObjChunk(ObjChunk& chunk) {
+    for (size_t i = 0; i < chunk.indices.size(); ++i) {
+        chunk.output[i] = resolveObjIndex(chunk.indices[i], chunk.firstVertex);
+    }
+
+    if (chunk.uvOutput) {
+        for (size_t i = 0; i < chunk.uvIndices.size(); ++i) {
+            chunk.uvOutput[i] = resolveObjIndex(chunk.uvIndices[i], chunk.firstUv);
+        }
+    }
+}
+
+// OBJ indexes positions and texture coordinates separately, so with texture coordinates every corner becomes a vertex of its own.
+// Merging vertices afterwards folds the corners that share both again.
+struct ObjCornerTask {
+    const float*    positions      = nullptr;
+    const float*    uvs            = nullptr;
+    const uint32_t* uvIndices      = nullptr;
+    uint32_t*       indices        = nullptr;
+    float*          cornerVertices = nullptr;
+    float*          cornerUvs      = nullptr;
+    uint64_t        positionCount  = 0;
+    uint64_t        uvCount        = 0;
+    uint64_t        first          = 0;
+    uint64_t        last           = 0;
+    bool            outOfRange     = false;
+};
+
+static void expandObjCorners(ObjCornerTask& task) {
+    for (uint64_t corner = task.first; corner < task.last; ++corner) {
+        uint32_t vertex = task.indices[corner];
+        uint32_t uv     = task.uvIndices[corner];
+        if (vertex >= task.positionCount || (uv != INVALID_MESH_INDEX && uv >= task.uvCount)) {
+            task.outOfRange = true;
+            return;
+        }
+
+        memcpy(task.cornerVertices + 3 * corner, task.positions + 3 * static_cast<uint64_t>(vertex), 3 * sizeof(float));
+
+        task.cornerUvs[2 * corner]     = uv == INVALID_MESH_INDEX ? 0.0f : task.uvs[2 * static_cast<uint64_t>(uv)];
+        task.cornerUvs[2 * corner + 1] = uv == INVALID_MESH_INDEX ? 0.0f : task.uvs[2 * static_cast<uint64_t>(uv) + 1];
+        task.indices[corner]           = static_cast<uint32_t>(corner);
+    }
+}
+
+static void parseObj(JobSystem& jobSystem, const MappedFile& sourceFile, MeshData& mesh) {
+    const char* text = reinterpret_cast<const char*>(sourceFile.getData());
+    const char* end  = text + sourceFile.getSize();
+
+    // Chunks start right after a newline, so no line is split between two of them
+    std::vector<ObjChunk> chunks(getTaskCount(jobSystem, sourceFile.getSize(), MIN_PARSE_CHUNK_SIZE));
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        chunks[i].begin = i == 0 ? text : chunks[i - 1].end;
+        chunks[i].end   = i + 1 == chunks.size() ? end : skipLine(text + sourceFile.getSize() * (i + 1) / chunks.size() - 1, end);
+        chunks[i].end   = std::max(chunks[i].begin, chunks[i].end);
+    }
+
+    runTasks(jobSystem, parseObjChunk, chunks);
+
+    uint64_t vertexCount = 0;
+    uint64_t uvCount     = 0;
+    uint64_t indexCount  = 0;
+    for (const ObjChunk& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            throw std::runtime_error("Couldn't import OBJ, " + chunk.error + "!");
+        }
+
+        vertexCount += chunk.positions.size() / 3;
+        uvCount += chunk.uvs.size() / 2;
+        indexCount += chunk.indices.size();
+    }
+
+    // Corners only become vertices with texture coordinates, without them the positions are all that has to fit the indices
+    if (vertexCount >= INVALID_MESH_INDEX || (uvCount > 0 && (uvCount >= INVALID_MESH_INDEX || indexCount >= INVALID_MESH_INDEX))) {
+        throw std::runtime_error("Couldn't import OBJ, too many vertices!");
+    }
+
+    std::vector<float>    uvs;
+    std::vector<uint32_t> uvIndices(uvCount > 0 ? indexCount : 0);
+
+    mesh.vertices.reserve(3 * vertexCount);
+    uvs.reserve(2 * uvCount);
+    mesh.indices.resize(indexCount);
+
+    uint64_t firstIndex = 0;
+    for (ObjChunk& chunk : chunks) {
+        chunk.firstVertex = mesh.vertices.size() / 3;
+        chunk.firstUv     = uvs.size() / 2;
+        chunk.output      = mesh.indices.data() + firstIndex;
+        chunk.uvOutput    = uvCount > 0 ? uvIndices.data() + firstIndex : nullptr;
+
+        mesh.vertices.insert(mesh.vertices.end(), chunk.positions.begin(), chunk.positions.end());
+        uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+        firstIndex += chunk.indices.size();
+    }
+
+    runTasks(jobSystem, resolveObjChunk, chunks);
+
+    if (uvCount == 0) {
+        return;
+    }
+
+    std::vector<float> positions = std::move(mesh.vertices);
+    mesh.vertices.resize(3 * indexCount);
+    mesh.uvs.resize(2 * indexCount);
+
+    std::vector<ObjCornerTask> tasks(getTaskCount(jobSystem, indexCount, MIN_VERTEX_TASK_SIZE));
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].positions      = positions.data();
+        tasks[i].uvs            = uvs.data();
+        tasks[i].uvIndices      = uvIndices.data();
+        tasks[i].indices        = mesh.indices.data();
+        tasks[i].cornerVertices = mesh.vertices.data();
+        tasks[i].cornerUvs      = mesh.uvs.data();
+        tasks[i].positionCount  = vertexCount;
+        tasks[i].uvCount        = uvCount;
+        tasks[i].first          = indexCount * i / tasks.size();
+        tasks[i].last           = indexCount * (i + 1) / tasks.size();
+    }
+
+    runTasks(jobSystem, expandObjCorners, tasks);
+
+    for (const ObjCornerTask& task : tasks) {
+        if (task.outOfRange) {
+            throw std::runtime_error("Couldn't import OBJ, index out of range!");
+        }
+    }
+}
+
+enum class PlyType { Int8, Uint8, Int16, Uint16, Int32, Uint32, Float32, Float64 };
+
+struct PlyProperty {
+    std::string name;
+    PlyType     type      = PlyType::Float32;
+    PlyType     countType = PlyType::Uint8; // Type of the element count that precedes list properties
+    bool        list      = false;
+};
+
+struct PlyElement {
+    std::string              name;
+    uint64_t                 count = 0;
+    std::vector<PlyProperty> properties;
+};
+
+static bool parsePlyType(const std::string& name, PlyType& type) {
+    static const char* const names[][2] = {{"char", "int8"},   {"uchar", "uint8"}, {"short", "int16"},  {"ushort", "uint16"},
+                                           {"int", "int32"},   {"uint", "uint32"}, {"float", "float32"}, {"double", "float64"}};
+
+    for (uint32_t i = 0; i < 8; ++i) {
+        if (name == names[i][0] || name == names[i][1]) {
+            type = static_cast<PlyType>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint32_t getPlyTypeSize(const PlyType type) {
+    static const uint32_t sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+    return sizes[static_cast<uint32_t>(type)];
+}
+
+static double readPlyValue(const uint8_t* data, const PlyType type, const bool bigEndian) {
+    uint8_t  bytes[8] = {};
+    uint32_t size     = getPlyTypeSize(type);
+    for (uint32_t i = 0; i < size; ++i) {
+        bytes[i] = data[bigEndian ? size - 1 - i : i];
+    }
+
+    switch (type) {
+    case PlyType::Int8: {
+        int8_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    case PlyType::Uint8:
+        return bytes[0];
+    case PlyType::Int16: {
+        int16_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    case PlyType::Uint16: {
+        uint16_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    case PlyType::Int32: {
+        int32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    case PlyType::Uint32: {
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    case PlyType::Float32: {
+        float value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    default: {
+        double value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    }
+}
+
+static uint32_t readPlyIndex(const uint8_t* data, const PlyType type, const bool bigEndian) {
+    double value = readPlyValue(data, type, bigEndian);
+    return value >= 0.0 && value < INVALID_MESH_INDEX ? static_cast<uint32_t>(value) : INVALID_MESH_INDEX;
+}
+
+// Returns a pointer past the last element, or nullptr if the data ends before it
+static const uint8_t* skipPlyElement(const PlyElement& element, const uint8_t* data, const uint8_t* end, const bool bigEndian) {
+    for (uint64_t i = 0; i < element.count; ++i) {
+        for (const PlyProperty& property : element.properties) {
+            uint64_t count = 1;
+            if (property.list) {
+                if (static_cast<uint64_t>(end - data) < getPlyTypeSize(property.countType)) {
+                    return nullptr;
+                }
+
+                count = static_cast<uint64_t>(readPlyValue(data, property.countType, bigEndian));
+                data += getPlyTypeSize(property.countType);
+            }
+
+            if (static_cast<uint64_t>(end - data) < count * getPlyTypeSize(property.type)) {
+                return nullptr;
+            }
+
+            data += count * getPlyTypeSize(property.type);
+        }
+    }
+
+    return data;
+}
+
+// Offsets and types hold x, y and z followed by the two texture coordinates
+struct PlyVertexTask {
+    const uint8_t* data       = nullptr;
+    uint64_t       stride     = 0;
+    uint64_t       offsets[5] = {};
+    PlyType        types[5]   = {};
+    bool           bigEndian  = false;
+    uint64_t       first      = 0;
+    uint64_t       last       = 0;
+    float*         positions  = nullptr;
+    float*         uvs        = nullptr; // Null when the vertices have no texture coordinates
+};
+
+static void parsePlyVertices(PlyVertexTask& task) {
+    for (uint64_t vertex = task.first; vertex < task.last; ++vertex) {
+        const uint8_t* data = task.data + vertex * task.stride;
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            task.positions[3 * vertex + axis] = static_cast<float>(readPlyValue(data + task.offsets[axis], task.types[axis], task.bigEndian));
+        }
+
+        if (task.uvs) {
+            for (uint32_t axis = 0; axis < 2; ++axis) {
+                task.uvs[2 * vertex + axis] = static_cast<float>(readPlyValue(data + task.offsets[3 + axis], task.types[3 + axis], task.bigEndian));
+            }
+        }
+    }
+}
+
+// Exporters disagree on what to call texture coordinates, returns the axis a property is for or UINT32_MAX
+static uint32_t getPlyUvAxis(const std::string& name) {
+    static const char* const names[][2] = {{"u", "v"}, {"s", "t"}, {"texture_u", "texture_v"}, {"texture_s", "texture_t"}};
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        for (uint32_t axis = 0; axis < 2; ++axis) {
+            if (name == names[i][axis]) {
+                return axis;
+            }
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+// Faces that are all triangles with nothing but an index list have a fixed size, so they can be split between threads
+struct PlyTriangleTask {
+    const uint8_t* data        = nullptr;
+    PlyType        countType   = PlyType::Uint8;
+    PlyType        indexType   = PlyType::Int32;
+    bool           bigEndian   = false;
+    uint64_t       first       = 0;
+    uint64_t       last        = 0;
+    uint32_t*      indices     = nullptr;
+    bool           nonTriangle = false;
+};
+
+static void parsePlyTriangles(PlyTriangleTask& task) {
+    uint64_t countSize = getPlyTypeSize(task.countType);
+    uint64_t indexSize = getPlyTypeSize(task.indexType);
+    uint64_t faceSize  = countSize + 3 * indexSize;
+
+    for (uint64_t face = task.first; face < task.last; ++face) {
+        const uint8_t* data = task.data + face * faceSize;
+        if (readPlyValue(data, task.countType, task.bigEndian) != 3.0) {
+            task.nonTriangle = true;
+            return;
+        }
+
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            task.indices[3 * face + corner] = readPlyIndex(data + countSize + corner * indexSize, task.indexType, task.bigEndian);
+        }
+    }
+}
+
+static bool parsePlyTrianglesParallel(JobSystem& jobSystem, const PlyElement& faces, const PlyProperty& indexProperty, const uint8_t* data,
+                                      const uint8_t* end, const bool bigEndian, MeshData& mesh) {
+    uint64_t faceSize = getPlyTypeSize(indexProperty.countType) + 3 * getPlyTypeSize(indexProperty.type);
+    if (faces.properties.size() != 1 || static_cast<uint64_t>(end - data) / faceSize < faces.count) {
+        return false;
+    }
+
+    mesh.indices.resize(3 * faces.count);
+
+    std::vector<PlyTriangleTask> tasks(getTaskCount(jobSystem, faces.count, MIN_VERTEX_TASK_SIZE));
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].data      = data;
+        tasks[i].countType = indexProperty.countType;
+        tasks[i].indexType = indexProperty.type;
+        tasks[i].bigEndian = bigEndian;
+        tasks[i].first     = faces.count * i / tasks.size();
+        tasks[i].last      = faces.count * (i + 1) / tasks.size();
+        tasks[i].indices   = mesh.indices.data();
+    }
+
+    runTasks(jobSystem, parsePlyTriangles, tasks);
+
+    for (const PlyTriangleTask& task : tasks) {
+        if (task.nonTriangle) {
+            mesh.indices.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Fallback for polygons and faces with more properties than their index list
+static void parsePlyFaces(const PlyElement& faces, const uint8_t* data, const uint8_t* end, const bool bigEndian, MeshData& mesh) {
+    std::vector<uint32_t> polygon;
+
+    for (uint64_t face = 0; face < faces.count; ++face) {
+        for (const PlyProperty& property : faces.properties) {
+            uint64_t count = 1;
+            if (property.list) {
+                if (static_cast<uint64_t>(end - data) < getPlyTypeSize(property.countType)) {
+                    throw std::runtime_error("Couldn't import PLY, face data is truncated!");
+                }
+
+                count = static_cast<uint64_t>(readPlyValue(data, property.countType, bigEndian));
+                data += getPlyTypeSize(property.countType);
+            }
+
+            uint64_t valueSize = getPlyTypeSize(property.type);
+            if (static_cast<uint64_t>(end - data) / valueSize < count) {
+                throw std::runtime_error("Couldn't import PLY, face data is truncated!");
+            }
+
+            if (property.list && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+                if (count < 3) {
+                    throw std::runtime_error("Couldn't import PLY, face with less than three vertices!");
+                }
+
+                polygon.resize(count);
+                for (uint64_t i = 0; i < count; ++i) {
+                    polygon[i] = readPlyIndex(data + i * valueSize, property.type, bigEndian);
+                }
+
+                for (size_t i = 2; i < polygon.size(); ++i) {
+                    mesh.indices.push_back(polygon[0]);
+                    mesh.indices.push_back(polygon[i - 1]);
+                    mesh.indices.push_back(polygon[i]);
+                }
+            }
+
+            data += count * valueSize;
+        }
+    }
+}
+
+static std::vector<std::string> splitHeaderLine(const char* begin, const char* end) {
+    std::vector<std::string> tokens;
+
+    const char* c = begin;
+    while (c < end) {
+        c = skipSpaces(c, end);
+
+        const char* tokenBegin = c;
+        while (c < end && *c != ' ' && *c != '\t' && *c != '\r') {
+            ++c;
+        }
+
+        if (c > tokenBegin) {
+            tokens.emplace_back(tokenBegin, c);
+        } else {
+            ++c;
+        }
+    }
+
+    return tokens;
+}
+
+static void parsePly(JobSystem& jobSystem, const MappedFile& sourceFile, MeshData& mesh) {
+    const uint8_t* data = sourceFile.getData();
+    const uint8_t* end  = data + sourceFile.getSize();
+
+    bool                    formatFound = false;
+    bool                    bigEndian   = false;
+    bool                    headerEnded = false;
+    std::vector<PlyElement> elements;
+
+    const char* line = reinterpret_cast<const char*>(data);
+    const char* text = reinterpret_cast<const char*>(end);
+    for (uint32_t lineIndex = 0; line < text && !headerEnded; ++lineIndex) {
+        const char*              lineEnd = skipLine(line, text);
+        std::vector<std::string> tokens  = splitHeaderLine(line, lineEnd - (lineEnd[-1] == '\n' ? 1 : 0));
+        line                             = lineEnd;
+
+        if (lineIndex == 0) {
+            if (tokens.size() != 1 || tokens[0] != "ply") {
+                throw std::runtime_error("Couldn't import PLY, missing magic!");
+            }
+        } else if (tokens.empty() || tokens[0] == "comment" || tokens[0] == "obj_info") {
+            continue;
+        } else if (tokens[0] == "format" && tokens.size() == 3) {
+            if (tokens[1] != "binary_little_endian" && tokens[1] != "binary_big_endian") {
+                throw std::runtime_error("Couldn't import PLY, only binary PLY files are supported!");
+            }
+
+            formatFound = true;
+            bigEndian   = tokens[1] == "binary_big_endian";
+        } else if (tokens[0] == "element" && tokens.size() == 3) {
+            PlyElement element = {};
+            element.name       = tokens[1];
+            element.count      = strtoull(tokens[2].c_str(), nullptr, 10);
+            elements.push_back(element);
+        } else if (tokens[0] == "property" && !elements.empty()) {
+            PlyProperty property = {};
+            property.list        = tokens.size() == 5 && tokens[1] == "list";
+
+            bool typesValid = property.list ? parsePlyType(tokens[2], property.countType) && parsePlyType(tokens[3], property.type)
+                                            : tokens.size() == 3 && parsePlyType(tokens[1], property.type);
+            if (!typesValid) {
+                throw std::runtime_error("Couldn't import PLY, malformed property!");
+            }
+
+            property.name = tokens.back();
+            elements.back().properties.push_back(property);
+        } else if (tokens[0] == "end_header") {
+            headerEnded = true;
+        } else {
+            throw std::runtime_error("Couldn't import PLY, unknown header line " + tokens[0] + "!");
+        }
+    }
+
+    if (!formatFound || !headerEnded) {
+        throw std::runtime_error("Couldn't import PLY, malformed header!");
+    }
+
+    data = reinterpret_cast<const uint8_t*>(line);
+
+    bool verticesFound = false;
+    bool facesFound    = false;
+    for (const PlyElement& element : elements) {
+        if (element.name == "vertex" && !verticesFound) {
+            PlyVertexTask vertexTask = {};
+            uint32_t      axesFound  = 0;
+            for (const PlyProperty& property : element.properties) {
+                if (property.list) {
+                    throw std::runtime_error("Couldn't import PLY, vertices with list properties aren't supported!");
+                }
+
+                for (uint32_t axis = 0; axis < 3; ++axis) {
+                    if (property.name.size() == 1 && property.name[0] == "xyz"[axis]) {
+                        vertexTask.offsets[axis] = vertexTask.stride;
+                        vertexTask.types[axis]   = property.type;
+                        axesFound |= 1 << axis;
+                    }
+                }
+
+                uint32_t uvAxis = getPlyUvAxis(property.name);
+                if (uvAxis != UINT32_MAX) {
+                    vertexTask.offsets[3 + uvAxis] = vertexTask.stride;
+                    vertexTask.types[3 + uvAxis]   = property.type;
+                    axesFound |= 1 << (3 + uvAxis);
+                }
+
+                vertexTask.stride += getPlyTypeSize(property.type);
+            }
+
+            if ((axesFound & 0x7) != 0x7) {
+                throw std::runtime_error("Couldn't import PLY, vertices have no position!");
+            }
+
+            if (element.count >= INVALID_MESH_INDEX || static_cast<uint64_t>(end - data) / vertexTask.stride < element.count) {
+                throw std::runtime_error("Couldn't import PLY, vertex data is truncated!");
+            }
+
+            // Texture coordinates are only kept when both of them are there
+            mesh.vertices.resize(3 * element.count);
+            mesh.uvs.resize(axesFound == 0x1F ? 2 * element.count : 0);
+
+            vertexTask.data      = data;
+            vertexTask.bigEndian = bigEndian;
+            vertexTask.positions = mesh.vertices.data();
+            vertexTask.uvs       = mesh.uvs.empty() ? nullptr : mesh.uvs.data();
+
+            std::vector<PlyVertexTask> tasks(getTaskCount(jobSystem, element.count, MIN_VERTEX_TASK_SIZE), vertexTask);
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                tasks[i].first = element.count * i / tasks.size();
+                tasks[i].last  = element.count * (i + 1) / tasks.size();
+            }
+
+            runTasks(jobSystem, parsePlyVertices, tasks);
+
+            verticesFound = true;
+            data += element.count * vertexTask.stride;
+        } else if (element.name == "face" && !facesFound) {
+            const PlyProperty* indexProperty = nullptr;
+            for (const PlyProperty& property : element.properties) {
+                if (property.list && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+                    indexProperty = &property;
+                }
+            }
+
+            if (!indexProperty) {
+                throw std::runtime_error("Couldn't import PLY, faces have no vertex indices!");
+            }
+
+            if (!parsePlyTrianglesParallel(jobSystem, element, *indexProperty, data, end, bigEndian, mesh)) {
+                parsePlyFaces(element, data, end, bigEndian, mesh);
+            }
+
+            facesFound = true;
+        } else {
+            data = skipPlyElement(element, data, end, bigEndian);
+            if (!data) {
+                throw std::runtime_error("Couldn't import PLY, " + element.name + " data is truncated!");
+            }
+        }
+
+        if (verticesFound && facesFound) {
+            break;
+        }
+    }
+
+    if (!verticesFound || !facesFound) {
+        throw std::runtime_error("Couldn't import PLY, missing vertex or face element!");
+    }
+}
+
+// Position followed by the texture coordinate, which stays zero for meshes without them
+struct VertexKey {
+    uint32_t bits[5];
+
+    bool operator==(const VertexKey& other) const { return memcmp(bits, other.bits, sizeof(bits)) == 0; }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        uint64_t hash = key.bits[0] * 0x9E3779B97F4A7C15ull ^ key.bits[1] * 0xC2B2AE3D27D4EB4Full ^ key.bits[2] * 0x165667B19E3779F9ull ^
+                        key.bits[3] * 0x27D4EB2F165667C5ull ^ key.bits[4] * 0x94D049BB133111EBull;
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+};
+
+// Maps a vertex key to the first vertex that has it. Sharded by hash, so threads inserting at once rarely wait on the same lock.
+struct VertexMapShard {
+    std::mutex                                             mutex;
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertices;
+};
+
+static VertexKey getVertexKey(const float* positions, const float* uvs, const uint32_t vertex) {
+    float values[5] = {positions[3 * static_cast<uint64_t>(vertex)], positions[3 * static_cast<uint64_t>(vertex) + 1],
+                       positions[3 * static_cast<uint64_t>(vertex) + 2], 0.0f, 0.0f};
+    if (uvs) {
+        values[3] = uvs[2 * static_cast<uint64_t>(vertex)];
+        values[4] = uvs[2 * static_cast<uint64_t>(vertex) + 1];
+    }
+
+    VertexKey key = {};
+    for (uint32_t i = 0; i < 5; ++i) {
+        float value = values[i] == 0.0f ? 0.0f : values[i]; // -0 and 0 are the same value
+        memcpy(&key.bits[i], &value, sizeof(float));
+    }
+
+    return key;
+}
+
+static VertexMapShard& getVertexMapShard(std::vector<VertexMapShard>& shards, const VertexKey& key) {
+    return shards[(VertexKeyHash()(key) >> 24) % VERTEX_MAP_SHARDS];
+}
+
+struct VertexMergeTask {
+    const float*                 positions       = nullptr;
+    const float*                 uvs             = nullptr;
+    std::vector<VertexMapShard>* shards          = nullptr;
+    uint32_t*                    representatives = nullptr;
+    uint32_t                     first           = 0;
+    uint32_t                     last            = 0;
+};
+
+// Keeping the lowest vertex per position makes the result independent of the order threads insert in
+static void insertVertices(VertexMergeTask& task) {
+    for (uint32_t vertex = task.first; vertex < task.last; ++vertex) {
+        VertexKey       key   = getVertexKey(task.positions, task.uvs, vertex);
+        VertexMapShard& shard = getVertexMapShard(*task.shards, key);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        std::pair<std::unordered_map<VertexKey, uint32_t, VertexKeyHash>::iterator, bool> result = shard.vertices.emplace(key, vertex);
+        if (!result.second) {
+            result.first->second = std::min(result.first->second, vertex);
+        }
+    }
+}
+
+// Runs after every insert finished, so the map is only read and needs no locks
+static void findRepresentatives(VertexMergeTask& task) {
+    for (uint32_t vertex = task.first; vertex < task.last; ++vertex) {
+        VertexKey key                = getVertexKey(task.positions, task.uvs, vertex);
+        task.representatives[vertex] = getVertexMapShard(*task.shards, key).vertices.find(key)->second;
+    }
+}
+
+struct IndexRemapTask {
+    uint32_t*       indices    = nullptr;
+    const uint32_t* remap      = nullptr;
+    uint32_t        remapSize  = 0;
+    uint64_t        first      = 0;
+    uint64_t        last       = 0;
+    bool            outOfRange = false;
+};
+
+static void remapIndices(IndexRemapTask& task) {
+    for (uint64_t i = task.first; i < task.last; ++i) {
+        if (task.indices[i] >= task.remapSize) {
+            task.outOfRange = true;
+            return;
+        }
+
+        task.indices[i] = task.remap[task.indices[i]];
+    }
+}
+
+static void mergeVertices(JobSystem& jobSystem, MeshData& mesh) {
+    PROFILE_ZONE("mergeVertices");
+
+    uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size() / 3);
+
+    std::vector<VertexMapShard> shards(VERTEX_MAP_SHARDS);
+    std::vector<uint32_t>       representatives(vertexCount);
+
+    std::vector<VertexMergeTask> mergeTasks(getTaskCount(jobSystem, vertexCount, MIN_VERTEX_TASK_SIZE));
+    for (size_t i = 0; i < mergeTasks.size(); ++i) {
+        mergeTasks[i].positions       = mesh.vertices.data();
+        mergeTasks[i].uvs             = mesh.uvs.empty() ? nullptr : mesh.uvs.data();
+        mergeTasks[i].shards          = &shards;
+        mergeTasks[i].representatives = representatives.data();
+        mergeTasks[i].first           = static_cast<uint32_t>(uint64_t(vertexCount) * i / mergeTasks.size());
+        mergeTasks[i].last            = static_cast<uint32_t>(uint64_t(vertexCount) * (i + 1) / mergeTasks.size());
+    }
+
+    runTasks(jobSystem, insertVertices, mergeTasks);
+    runTasks(jobSystem, findRepresentatives, mergeTasks);
+
+    // A representative always comes before the vertices it stands for, so one pass compacts in place
+    std::vector<uint32_t> remap(vertexCount);
+    uint32_t              mergedCount = 0;
+    for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) {
+        if (representatives[vertex] == vertex) {
+            memmove(&mesh.vertices[3 * mergedCount], &mesh.vertices[3 * vertex], 3 * sizeof(float));
+            if (!mesh.uvs.empty()) {
+                memmove(&mesh.uvs[2 * mergedCount], &mesh.uvs[2 * vertex], 2 * sizeof(float));
+            }
+
+            remap[vertex] = mergedCount++;
+        } else {
+            remap[vertex] = remap[representatives[vertex]];
+        }
+    }
+
+    mesh.vertices.resize(3 * mergedCount);
+    mesh.uvs.resize(mesh.uvs.empty() ? 0 : 2 * mergedCount);
+
+    std::vector<IndexRemapTask> remapTasks(getTaskCount(jobSystem, mesh.indices.size(), MIN_VERTEX_TASK_SIZE));
+    for (size_t i = 0; i < remapTasks.size(); ++i) {
+        remapTasks[i].indices   = mesh.indices.data();
+        remapTasks[i].remap     = remap.data();
+        remapTasks[i].remapSize = vertexCount;
+        remapTasks[i].first     = mesh.indices.size() * i / remapTasks.size();
+        remapTasks[i].last      = mesh.indices.size() * (i + 1) / remapTasks.size();
+    }
+
+    runTasks(jobSystem, remapIndices, remapTasks);
+
+    for (const IndexRemapTask& task : remapTasks) {
+        if (task.outOfRange) {
+            throw std::runtime_error("Couldn't import mesh, index out of range!");
+        }
+    }
+}
+
+static float dot(const float* a, const float* b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+static void cross(const float* a, const float* b, float* result) {
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static bool normalize(float* vector) {
+    float length = std::sqrt(dot(vector, vector));
+    if (length == 0.0f || !std::isfinite(length)) {
+        return false;
+    }
+
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        vector[axis] /= length;
+    }
+
+    return true;
+}
+
+// Maps every vertex to the first vertex at the same position. Merged vertices only differ in position or texture coordinate,
+// so without texture coordinates every vertex is its own.
+static std::vector<uint32_t> findPositionVertices(const MeshData& mesh) {
+    uint32_t              vertexCount = static_cast<uint32_t>(mesh.vertices.size() / 3);
+    std::vector<uint32_t> positionVertices(vertexCount);
+
+    if (mesh.uvs.empty()) {
+        for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) {
+            positionVertices[vertex] = vertex;
+        }
+        return positionVertices;
+    }
+
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> positions;
+    positions.reserve(vertexCount);
+    for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) {
+        positionVertices[vertex] = positions.emplace(getVertexKey(mesh.vertices.data(), nullptr, vertex), vertex).first->second;
+    }
+
+    return positionVertices;
+}
+
+// Area weighted, the unnormalized cross product of two edges is twice the triangle's area. Normals are accumulated per position rather than
+// per vertex, so every triangle around a position contributes to its normal, vertices split along UV seams shade the same and hard edges
+// come out smoothed.
+static void generateNormals(MeshData& mesh) {
+    PROFILE_ZONE("generateNormals");
+
+    std::vector<uint32_t> positionVertices = findPositionVertices(mesh);
+
+    mesh.normals.assign(mesh.vertices.size(), 0.0f);
+
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        const float* v0 = &mesh.vertices[3 * static_cast<size_t>(mesh.indices[i])];
+        const float* v1 = &mesh.vertices[3 * static_cast<size_t>(mesh.indices[i + 1])];
+        const float* v2 = &mesh.vertices[3 * static_cast<size_t>(mesh.indices[i + 2])];
+
+        float first[3]  = {v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
+        float second[3] = {v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]};
+
+        float faceNormal[3];
+        cross(first, second, faceNormal);
+
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            size_t positionVertex = positionVertices[mesh.indices[i + corner]];
+            for (uint32_t axis = 0; axis < 3; ++axis) {
+                mesh.normals[3 * positionVertex + axis] += faceNormal[axis];
+            }
+        }
+    }
+
+    // Vertices only used by degenerate triangles get an arbitrary normal, they cover no pixels anyway. The first vertex at a position
+    // always comes before the others, so its normal is final by the time it's copied.
+    for (size_t vertex = 0; vertex < positionVertices.size(); ++vertex) {
+        float* normal = &mesh.normals[3 * vertex];
+        if (positionVertices[vertex] != vertex) {
+            memcpy(normal, &mesh.normals[3 * static_cast<size_t>(positionVertices[vertex])], 3 * sizeof(float));
+        } else if (!normalize(normal)) {
+            normal[0] = 0.0f;
+            normal[1] = 0.0f;
+            normal[2] = 1.0f;
+        }
+    }
+}
+
+// Tangents point where u grows, orthogonalized against the normal, and w flips the bitangent wherever the mapping is mirrored
+static void generateTangents(MeshData& mesh) {
+    PROFILE_ZONE("generateTangents");
+
+    size_t vertexCount = mesh.vertices.size() / 3;
+
+    std::vector<float> uDirections(3 * vertexCount);
+    std::vector<float> vDirections(3 * vertexCount);
+
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        size_t corners[3] = {mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]};
+
+        const float* v0 = &mesh.vertices[3 * corners[0]];
+        const float* v1 = &mesh.vertices[3 * corners[1]];
+        const float* v2 = &mesh.vertices[3 * corners[2]];
+
+        float first[3]  = {v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
+        float second[3] = {v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]};
+
+        float firstU  = mesh.uvs[2 * corners[1]] - mesh.uvs[2 * corners[0]];
+        float firstV  = mesh.uvs[2 * corners[1] + 1] - mesh.uvs[2 * corners[0] + 1];
+        float secondU = mesh.uvs[2 * corners[2]] - mesh.uvs[2 * corners[0]];
+        float secondV = mesh.uvs[2 * corners[2] + 1] - mesh.uvs[2 * corners[0] + 1];
+
+        float uvArea = firstU * secondV - secondU * firstV;
+        if (std::abs(uvArea) < MIN_UV_AREA) {
+            continue;
+        }
+
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            float uDirection = (first[axis] * secondV - second[axis] * firstV) / uvArea;
+            float vDirection = (second[axis] * firstU - first[axis] * secondU) / uvArea;
+
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                uDirections[3 * corners[corner] + axis] += uDirection;
+                vDirections[3 * corners[corner] + axis] += vDirection;
+            }
+        }
+    }
+
+    mesh.tangents.resize(4 * vertexCount);
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+        const float* normal     = &mesh.normals[3 * vertex];
+        const float* uDirection = &uDirections[3 * vertex];
+        float*       tangent    = &mesh.tangents[4 * vertex];
+
+        float projection = dot(normal, uDirection);
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            tangent[axis] = uDirection[axis] - normal[axis] * projection;
+        }
+
+        // Without a usable UV gradient any direction perpendicular to the normal will do
+        if (!normalize(tangent)) {
+            float axis[3] = {std::abs(normal[0]) < 0.9f ? 1.0f : 0.0f, std::abs(normal[0]) < 0.9f ? 0.0f : 1.0f, 0.0f};
+            cross(normal, axis, tangent);
+            normalize(tangent);
+        }
+
+        float bitangent[3];
+        cross(normal, tangent, bitangent);
+        tangent[3] = dot(bitangent, &vDirections[3 * vertex]) < 0.0f ? -1.0f : 1.0f;
+    }
+}
+
+static void generateVertexAttributes(MeshData& mesh) {
+    generateNormals(mesh);
+
+    if (!mesh.uvs.empty()) {
+        generateTangents(mesh);
+    }
+}
+
+struct MeshSplit {
+    const MeshData*       mesh = nullptr;
+    std::vector<float>    centroids; // Three per triangle
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> vertexMarks; // Last pass that saw each vertex, saves clearing a set per pass
+    std::vector<uint32_t> vertexRemap;
+    uint32_t              mark = 0;
+};
+
+struct CentroidLess {
+    const float* centroids = nullptr;
+    uint32_t     axis      = 0;
+
+    bool operator()(const uint32_t a, const uint32_t b) const { return centroids[3 * a + axis] < centroids[3 * b + axis]; }
+};
+
+static uint32_t countVertices(MeshSplit& split, const size_t first, const size_t last) {
+    ++split.mark;
+
+    uint32_t vertexCount = 0;
+    for (size_t i = first; i < last; ++i) {
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            uint32_t vertex = split.mesh->indices[3 * split.triangles[i] + corner];
+            if (split.vertexMarks[vertex] != split.mark) {
+                split.vertexMarks[vertex] = split.mark;
+                ++vertexCount;
+            }
+        }
+    }
+
+    return vertexCount;
+}
+
+static void appendVertex(MeshData& chunk, const MeshData& mesh, const size_t vertex) {
+    chunk.vertices.insert(chunk.vertices.end(), &mesh.vertices[3 * vertex], &mesh.vertices[3 * vertex] + 3);
+    chunk.normals.insert(chunk.normals.end(), &mesh.normals[3 * vertex], &mesh.normals[3 * vertex] + 3);
+
+    if (!mesh.uvs.empty()) {
+        chunk.uvs.insert(chunk.uvs.end(), &mesh.uvs[2 * vertex], &mesh.uvs[2 * vertex] + 2);
+    }
+
+    if (!mesh.tangents.empty()) {
+        chunk.tangents.insert(chunk.tangents.end(), &mesh.tangents[4 * vertex], &mesh.tangents[4 * vertex] + 4);
+    }
+}
+
+static void splitTriangles(MeshSplit& split, const size_t first, const size_t last, const uint32_t maxVertexCount, std::vector<MeshData>& chunks) {
+    if (countVertices(split, first, last) <= maxVertexCount) {
+        ++split.mark;
+
+        MeshData chunk   = {};
+        chunk.buildHints = split.mesh->buildHints;
+        chunk.indices.reserve(3 * (last - first));
+
+        for (size_t i = first; i < last; ++i) {
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                uint32_t vertex = split.mesh->indices[3 * split.triangles[i] + corner];
+                if (split.vertexMarks[vertex] != split.mark) {
+                    split.vertexMarks[vertex] = split.mark;
+                    split.vertexRemap[vertex] = static_cast<uint32_t>(chunk.vertices.size() / 3);
+                    appendVertex(chunk, *split.mesh, vertex);
+                }
+
+                chunk.indices.push_back(split.vertexRemap[vertex]);
+            }
+        }
+
+        chunks.push_back(std::move(chunk));
+        return;
+    }
+
+    float boundsMin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float boundsMax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (size_t i = first; i < last; ++i) {
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            boundsMin[axis] = std::min(boundsMin[axis], split.centroids[3 * split.triangles[i] + axis]);
+            boundsMax[axis] = std::max(boundsMax[axis], split.centroids[3 * split.triangles[i] + axis]);
+        }
+    }
+
+    uint32_t splitAxis = 0;
+    for (uint32_t axis = 1; axis < 3; ++axis) {
+        if (boundsMax[axis] - boundsMin[axis] > boundsMax[splitAxis] - boundsMin[splitAxis]) {
+            splitAxis = axis;
+        }
+    }
+
+    CentroidLess centroidLess = {};
+    centroidLess.centroids    = split.centroids.data();
+    centroidLess.axis         = splitAxis;
+
+    size_t middle = first + (last - first) / 2;
+    std::nth_element(split.triangles.begin() + first, split.triangles.begin() + middle, split.triangles.begin() + last, centroidLess);
+
+    splitTriangles(split, first, middle, maxVertexCount, chunks);
+    splitTriangles(split, middle, last, maxVertexCount, chunks);
+}
+
+std::vector<MeshData> splitMesh(const MeshData& mesh, const uint32_t maxVertexCount) {
+    PROFILE_ZONE("splitMesh");
+
+    assert(maxVertexCount >= 3);
+
+    size_t triangleCount = mesh.indices.size() / 3;
+
+    MeshSplit split = {};
+    split.mesh      = &mesh;
+    split.centroids.resize(3 * triangleCount);
+    split.triangles.resize(triangleCount);
+    split.vertexMarks.resize(mesh.vertices.size() / 3);
+    split.vertexRemap.resize(mesh.vertices.size() / 3);
+
+    for (size_t i = 0; i < triangleCount; ++i) {
+        split.triangles[i] = static_cast<uint32_t>(i);
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            float sum = 0.0f;
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                sum += mesh.vertices[3 * mesh.indices[3 * i + corner] + axis];
+            }
+
+            split.centroids[3 * i + axis] = sum / 3.0f;
+        }
+    }
+
+    std::vector<MeshData> chunks;
+    splitTriangles(split, 0, triangleCount, maxVertexCount, chunks);
+
+    return chunks;
+}
+
+static bool hasExtension(const char* path, const char* extension) {
+    size_t pathLength      = strlen(path);
+    size_t extensionLength = strlen(extension);
+    if (pathLength < extensionLength) {
+        return false;
+    }
+
+    for (size_t i = 0; i < extensionLength; ++i) {
+        if (tolower(path[pathLength - extensionLength + i]) != extension[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static MeshData importMesh(JobSystem& jobSystem, const MappedFile& sourceFile, const char* path) {
+    PROFILE_ZONE("importMesh");
+
+    MeshData mesh = {};
+    if (hasExtension(path, ".obj")) {
+        parseObj(jobSystem, sourceFile, mesh);
+    } else if (hasExtension(path, ".ply")) {
+        parsePly(jobSystem, sourceFile, mesh);
+    } else {
+        throw std::runtime_error(std::string("Unsupported mesh format of ") + path + "!");
+    }
+
+    if (mesh.indices.empty()) {
+        throw std::runtime_error(std::string("Mesh ") + path + " contains no triangles!");
+    }
+
+    mergeVertices(jobSystem, mesh);
+    generateVertexAttributes(mesh);
+
+    return mesh;
+}
+
+const bool isImportableMesh(const char* path) { return hasExtension(path, ".obj") || hasExtension(path, ".ply"); }
+
+MeshData importMesh(JobSystem& jobSystem, const char* path) {
+    MappedFile sourceFile(path);
+    return importMesh(jobSystem, sourceFile, path);
+}
+
+const std::string importMeshCached(JobSystem& jobSystem, const char* sourcePath, const bool splitMeshes) {
+    PROFILE_ZONE("importMeshCached");
+
+    MappedFile sourceFile(sourcePath);
+
+    char cacheFileName[32];
+    sprintf_s(cacheFileName, "%016llx.mesh", static_cast<unsigned long long>(hashSource(jobSystem, sourceFile, splitMeshes)));
+
+    std::string cachePath = (std::filesystem::path(MESH_CACHE_DIRECTORY) / cacheFileName).string();
+
+    std::error_code errorCode;
+    if (std::filesystem::exists(cachePath, errorCode)) {
+        printf("Using cached import %s of %s\n", cachePath.c_str(), sourcePath);
+        return cachePath;
+    }
+
+    std::chrono::high_resolution_clock::time_point importStartTime = std::chrono::high_resolution_clock::now();
+
+    std::vector<MeshData> meshes(1);
+    meshes[0] = importMesh(jobSystem, sourceFile, sourcePath);
+
+    size_t vertexCount   = meshes[0].vertices.size() / 3;
+    size_t triangleCount = meshes[0].indices.size() / 3;
+    if (splitMeshes && vertexCount > MESH_UINT16_MAX_VERTICES) {
+        meshes = splitMesh(meshes[0], MESH_UINT16_MAX_VERTICES);
+    }
+
+    std::chrono::high_resolution_clock::duration importTime = std::chrono::high_resolution_clock::now() - importStartTime;
+    printf("Imported %s in %.2fms: %zu vertices, %zu triangles, %zu meshes\n", sourcePath, std::chrono::duration<float, std::milli>(importTime).count(),
+           vertexCount, triangleCount, meshes.size());
+
+    // Written next to the final path and renamed, so an interrupted write never leaves a cache entry behind
+    std::filesystem::create_directories(MESH_CACHE_DIRECTORY, errorCode);
+
+    std::string temporaryPath = cachePath + ".tmp";
+    writeMeshFile(temporaryPath.c_str(), meshes);
+
+    std::filesystem::rename(temporaryPath, cachePath, errorCode);
+    if (errorCode) {
+        std::filesystem::remove(temporaryPath, errorCode);
+        throw std::runtime_error("Couldn't write mesh cache file " + cachePath + "!");
+    }
+
+    return cachePath;
+}
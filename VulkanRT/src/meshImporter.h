@@ -0,0 +1,26 @@
+#pragma once
+
+#include "common.h"
+
+#include "jobSystem.h"
+#include "meshFile.h"
+
+#include <string>
+#include <vector>
+
+// Wavefront OBJ and binary PLY files are imported into the mesh file format. Positions, texture coordinates and triangles are kept,
+// normals and tangents are generated.
+const bool isImportableMesh(const char* path);
+
+// Splits the source into chunks parsed on every thread of the job system, then merges vertices with identical positions and texture coordinates.
+// Smooth normals are generated for every mesh, tangents for meshes with texture coordinates.
+MeshData importMesh(JobSystem& jobSystem, const char* path);
+
+// Cuts a mesh and its vertex attributes into chunks of at most maxVertexCount vertices, so large meshes can keep 16 bit indices.
+// Triangles are split at the median centroid along the longest axis, which keeps every chunk spatially coherent and its bottom level
+// structure tight.
+std::vector<MeshData> splitMesh(const MeshData& mesh, const uint32_t maxVertexCount);
+
+// Returns the path of a mesh file with the imported contents of sourcePath, split into 16 bit chunks when splitMeshes is set.
+// Imports are cached by a hash of the source bytes, so only the first launch with a given source pays for parsing.
+const std::string importMeshCached(JobSystem& jobSystem, const char* sourcePath, const bool splitMeshes);
@@ -0,0 +1,104 @@
+#include "pipelineCache.h"
+
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE, as defined by the spec
+struct PipelineCacheHeader {
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+static std::vector<uint8_t> readPipelineCacheFile(const char* path) {
+    FILE* file;
+    fopen_s(&file, path, "rb");
+    if (!file) {
+        return {};
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    std::vector<uint8_t> data(length > 0 ? static_cast<size_t>(length) : 0);
+    if (fread(data.data(), 1, data.size(), file) != data.size()) {
+        data.clear();
+    }
+
+    fclose(file);
+
+    return data;
+}
+
+static bool pipelineCacheHeaderValid(const std::vector<uint8_t>& data, const VkPhysicalDeviceProperties& physicalDeviceProperties) {
+    if (data.size() < sizeof(PipelineCacheHeader)) {
+        return false;
+    }
+
+    PipelineCacheHeader header;
+    memcpy(&header, data.data(), sizeof(PipelineCacheHeader));
+
+    return header.headerSize >= sizeof(PipelineCacheHeader) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == physicalDeviceProperties.vendorID && header.deviceID == physicalDeviceProperties.deviceID &&
+           memcmp(header.pipelineCacheUUID, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache createPipelineCache(const VkDevice device, const VkPhysicalDeviceProperties& physicalDeviceProperties, const char* path, bool& loadedFromDisk) {
+    PROFILE_ZONE("createPipelineCache");
+
+    std::vector<uint8_t> initialData = readPipelineCacheFile(path);
+
+    loadedFromDisk = !initialData.empty() && pipelineCacheHeaderValid(initialData, physicalDeviceProperties);
+    if (!initialData.empty() && !loadedFromDisk) {
+        printf("Pipeline cache %s was created by a different device or driver, ignoring it\n", path);
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    pipelineCacheCreateInfo.initialDataSize           = loadedFromDisk ? initialData.size() : 0;
+    pipelineCacheCreateInfo.pInitialData              = loadedFromDisk ? initialData.data() : nullptr;
+
+    VkPipelineCache pipelineCache = 0;
+    VK_CHECK(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+
+    return pipelineCache;
+}
+
+void savePipelineCache(const VkDevice device, const VkPipelineCache pipelineCache, const char* path) {
+    PROFILE_ZONE("savePipelineCache");
+
+    size_t dataSize = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+
+    std::vector<uint8_t> data(dataSize);
+    VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()));
+
+    std::string temporaryPath = std::string(path) + ".tmp";
+
+    FILE* file;
+    fopen_s(&file, temporaryPath.c_str(), "wb");
+    if (!file) {
+        printf("Couldn't open %s, pipeline cache not saved\n", temporaryPath.c_str());
+        return;
+    }
+
+    bool written = fwrite(data.data(), 1, dataSize, file) == dataSize;
+    written      = fclose(file) == 0 && written;
+
+    std::error_code errorCode;
+    if (written) {
+        std::filesystem::rename(temporaryPath, path, errorCode);
+    }
+
+    if (!written || errorCode) {
+        printf("Couldn't write %s, pipeline cache not saved\n", path);
+        std::filesystem::remove(temporaryPath, errorCode);
+    }
+}
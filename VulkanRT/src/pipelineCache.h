@@ -0,0 +1,15 @@
+#pragma once
+
+#include "common.h"
+
+#pragma warning(push, 0)
+#define VK_ENABLE_BETA_EXTENSIONS
+#include "volk.h"
+#pragma warning(pop)
+
+// Creates the pipeline cache, seeded from the file at path if it was written by the same driver for the same device.
+// loadedFromDisk is set to whether any cached data was used.
+VkPipelineCache createPipelineCache(const VkDevice device, const VkPhysicalDeviceProperties& physicalDeviceProperties, const char* path, bool& loadedFromDisk);
+
+// Writes the cache to a temporary file first and renames it over path, so an interrupted write never leaves a truncated cache behind
+void savePipelineCache(const VkDevice device, const VkPipelineCache pipelineCache, const char* path);
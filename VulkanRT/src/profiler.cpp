@@ -0,0 +1,137 @@
+#include "profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Zones kept per thread, older ones are overwritten once a ring is full
+#define PROFILER_RING_SIZE 65'536
+
+// Track the GPU ranges are written to, CPU threads are numbered from 0 in the order they record their first zone
+#define GPU_TRACK UINT32_MAX
+
+struct ProfileEvent {
+    const char* name  = nullptr;
+    uint64_t    start = 0;
+    uint64_t    end   = 0;
+};
+
+struct ProfileRing {
+    std::vector<ProfileEvent> events;
+    uint64_t                  eventCount = 0; // Total recorded, the ring holds the last PROFILER_RING_SIZE of them
+    uint32_t                  track      = 0;
+};
+
+static std::atomic<bool> s_enabled(false);
+
+static const std::chrono::steady_clock::time_point s_epoch = std::chrono::steady_clock::now();
+
+static std::mutex                                s_ringsMutex;
+static std::vector<std::unique_ptr<ProfileRing>> s_rings;
+
+static thread_local ProfileRing* t_ring = nullptr;
+
+static ProfileRing* createRing(const uint32_t track) {
+    std::unique_ptr<ProfileRing> ring = std::make_unique<ProfileRing>();
+    ring->events.resize(PROFILER_RING_SIZE);
+    ring->track = track;
+
+    std::lock_guard<std::mutex> lock(s_ringsMutex);
+    s_rings.push_back(std::move(ring));
+
+    return s_rings.back().get();
+}
+
+static uint32_t getNextCpuTrack() {
+    static std::atomic<uint32_t> nextTrack(0);
+    return nextTrack++;
+}
+
+static void pushEvent(ProfileRing& ring, const char* name, const uint64_t start, const uint64_t end) {
+    ProfileEvent& event = ring.events[ring.eventCount % PROFILER_RING_SIZE];
+    event.name          = name;
+    event.start         = start;
+    event.end           = end;
+
+    ++ring.eventCount;
+}
+
+void setProfilingEnabled(const bool enabled) { s_enabled = enabled; }
+
+const bool isProfilingEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+const uint64_t getProfilerTime() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_epoch).count());
+}
+
+void recordCpuZone(const char* name, const uint64_t start, const uint64_t end) {
+    if (!t_ring) {
+        t_ring = createRing(getNextCpuTrack());
+    }
+
+    pushEvent(*t_ring, name, start, end);
+}
+
+void recordGpuZone(const char* name, const uint64_t start, const uint64_t end) {
+    // GPU results are only collected on the render thread, so the GPU ring needs no more synchronization than a thread's own
+    static ProfileRing* gpuRing = createRing(GPU_TRACK);
+
+    pushEvent(*gpuRing, name, start, end);
+}
+
+void writeChromeTrace(const char* path) {
+    FILE* file;
+    fopen_s(&file, path, "w");
+    if (!file) {
+        throw std::runtime_error(std::string("Couldn't open trace file ") + path + "!");
+    }
+
+    // Timestamps are in microseconds, CPU threads and the GPU are separate processes so Perfetto groups them apart
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}");
+
+    uint64_t writtenEventCount = 0;
+
+    std::lock_guard<std::mutex> lock(s_ringsMutex);
+    for (const std::unique_ptr<ProfileRing>& ring : s_rings) {
+        uint32_t pid = ring->track == GPU_TRACK ? 1 : 0;
+        uint32_t tid = ring->track == GPU_TRACK ? 0 : ring->track;
+
+        uint64_t firstEvent = ring->eventCount > PROFILER_RING_SIZE ? ring->eventCount - PROFILER_RING_SIZE : 0;
+        for (uint64_t i = firstEvent; i < ring->eventCount; ++i) {
+            const ProfileEvent& event = ring->events[i % PROFILER_RING_SIZE];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event.name, pid, tid,
+                    static_cast<double>(event.start) / 1'000.0, static_cast<double>(event.end - event.start) / 1'000.0);
+        }
+
+        writtenEventCount += ring->eventCount - firstEvent;
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Wrote %llu trace events to %s\n", writtenEventCount, path);
+}
+
+ProfileZone::ProfileZone(const char* name) : m_name(name), m_start(0), m_open(isProfilingEnabled()) {
+    if (m_open) {
+        m_start = getProfilerTime();
+    }
+}
+
+ProfileZone::~ProfileZone() { end(); }
+
+void ProfileZone::end() {
+    if (!m_open) {
+        return;
+    }
+
+    recordCpuZone(m_name, m_start, getProfilerTime());
+    m_open = false;
+}
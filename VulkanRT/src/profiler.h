@@ -0,0 +1,40 @@
+#pragma once
+
+#include "common.h"
+
+// Scoped CPU zones and GPU ranges on one timeline, exported as Chrome trace JSON that opens in Perfetto or chrome://tracing.
+// Every thread records into a ring buffer of its own, so zones never contend on a lock. Rings keep the most recent zones and silently
+// overwrite the oldest. While profiling is disabled a zone costs one branch and no clock reads.
+
+// Zone names are stored as pointers and have to outlive the profiler, string literals are the intended use
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b)       PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name)         ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+
+void       setProfilingEnabled(const bool enabled);
+const bool isProfilingEnabled();
+
+// Nanoseconds on a steady clock, the time base of every zone
+const uint64_t getProfilerTime();
+
+void recordCpuZone(const char* name, const uint64_t start, const uint64_t end);
+
+// GPU ranges go onto a track of their own, start and end have to be converted to profiler time already
+void recordGpuZone(const char* name, const uint64_t start, const uint64_t end);
+
+// Has to be called once the threads that recorded zones are done with them
+void writeChromeTrace(const char* path);
+
+class ProfileZone {
+  public:
+    ProfileZone(const char* name);
+    ~ProfileZone();
+
+    // Closes the zone before the end of its scope, later calls and the destructor do nothing
+    void end();
+
+  private:
+    const char* m_name;
+    uint64_t    m_start;
+    bool        m_open;
+};
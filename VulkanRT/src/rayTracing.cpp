@@ -1,103 +1,207 @@
 #include "rayTracing.h"
 
 #include "commandPools.h"
+#include "profiler.h"
 
+#include <algorithm>
 #include <array>
+#include <cstdio>
+#include <stdexcept>
 
-AccelerationStructure createBottomAccelerationStructure(const VkDevice device, const uint32_t vertexCount, const uint32_t primitiveCount,
-                                                        const VkDeviceAddress vertexBufferAddress, const VkDeviceAddress indexBufferAddress,
-                                                        const VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties, const VkQueue queue,
-                                                        const uint32_t queueFamilyIndex) {
+// Upper bound on the scratch memory of one build call, builds beyond it are recorded into further calls that reuse the same scratch pool
+#define SCRATCH_BUDGET 67'108'864 // 64MB
 
-    VkAccelerationStructureCreateGeometryTypeInfoKHR createGeometryTypeInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_GEOMETRY_TYPE_INFO_KHR};
-    createGeometryTypeInfo.geometryType                                     = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-    createGeometryTypeInfo.maxPrimitiveCount                                = primitiveCount;
-    createGeometryTypeInfo.indexType                                        = VK_INDEX_TYPE_UINT16;
-    createGeometryTypeInfo.maxVertexCount                                   = vertexCount;
-    createGeometryTypeInfo.vertexFormat                                     = VK_FORMAT_R32G32B32_SFLOAT;
-    createGeometryTypeInfo.allowsTransforms                                 = VK_FALSE;
+#define SCRATCH_MIN_ALIGNMENT 256
 
-    VkAccelerationStructureCreateInfoKHR createInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
-    createInfo.type                                 = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    createInfo.flags                                = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    createInfo.maxGeometryCount                     = 1;
-    createInfo.pGeometryInfos                       = &createGeometryTypeInfo;
+// Top level structures are refit every frame instances move, so they have to allow updates
+#define TOP_LEVEL_BUILD_FLAGS (VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR)
 
-    AccelerationStructure accelerationStructure = {};
-    VK_CHECK(vkCreateAccelerationStructureKHR(device, &createInfo, nullptr, &accelerationStructure.accelerationStructure));
+// Consecutive refits allowed before the top level structure is rebuilt from scratch to restore its quality
+#define TOP_LEVEL_REFIT_LIMIT 60
 
-    VkAccelerationStructureMemoryRequirementsInfoKHR objectMemoryRequirementsInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_KHR};
-    objectMemoryRequirementsInfo.type                                             = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_OBJECT_KHR;
-    objectMemoryRequirementsInfo.buildType                                        = VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR;
-    objectMemoryRequirementsInfo.accelerationStructure                            = accelerationStructure.accelerationStructure;
+static VkDeviceSize alignUp(const VkDeviceSize value, const VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
 
-    VkMemoryRequirements2 objectMemoryRequirements2 = {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
-    vkGetAccelerationStructureMemoryRequirementsKHR(device, &objectMemoryRequirementsInfo, &objectMemoryRequirements2);
+// Waits on a timeline value of its own instead of the whole device, so rendering on other queues keeps running.
+// The submission's timeline info, if it has one, gets the signal value added.
+static void submitAndWait(const VkDevice device, const VkQueue queue, const VkSubmitInfo& submitInfo) {
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    semaphoreTypeCreateInfo.semaphoreType             = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue              = 0;
 
-    uint32_t memoryType =
-        findMemoryType(physicalDeviceMemoryProperties, objectMemoryRequirements2.memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    semaphoreCreateInfo.pNext                 = &semaphoreTypeCreateInfo;
 
-    VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO};
-    memoryAllocateFlagsInfo.flags                     = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
 
-    VkMemoryAllocateInfo memoryAllocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    memoryAllocateInfo.allocationSize       = objectMemoryRequirements2.memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex      = memoryType;
-    memoryAllocateInfo.pNext                = &memoryAllocateFlagsInfo;
+    const uint64_t completedValue = 1;
 
-    VK_CHECK(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &accelerationStructure.memory));
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    if (submitInfo.pNext) {
+        timelineSemaphoreSubmitInfo = *static_cast<const VkTimelineSemaphoreSubmitInfo*>(submitInfo.pNext);
+    }
+    timelineSemaphoreSubmitInfo.signalSemaphoreValueCount = 1;
+    timelineSemaphoreSubmitInfo.pSignalSemaphoreValues    = &completedValue;
 
-    VkBindAccelerationStructureMemoryInfoKHR bindMemoryInfo = {VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_KHR};
-    bindMemoryInfo.accelerationStructure                    = accelerationStructure.accelerationStructure;
-    bindMemoryInfo.memory                                   = accelerationStructure.memory;
-    bindMemoryInfo.memoryOffset                             = 0;
+    VkSubmitInfo signallingSubmitInfo         = submitInfo;
+    signallingSubmitInfo.pNext                = &timelineSemaphoreSubmitInfo;
+    signallingSubmitInfo.signalSemaphoreCount = 1;
+    signallingSubmitInfo.pSignalSemaphores    = &semaphore;
 
-    VK_CHECK(vkBindAccelerationStructureMemoryKHR(device, 1, &bindMemoryInfo));
+    VK_CHECK(vkQueueSubmit(queue, 1, &signallingSubmitInfo, VK_NULL_HANDLE));
 
-    VkAccelerationStructureGeometryTrianglesDataKHR geometryTrianglesData = {};
-    geometryTrianglesData.vertexFormat                                    = VK_FORMAT_R32G32B32_SFLOAT;
-    geometryTrianglesData.vertexData.deviceAddress                        = vertexBufferAddress;
-    geometryTrianglesData.vertexStride                                    = 3 * sizeof(float);
-    geometryTrianglesData.indexType                                       = VK_INDEX_TYPE_UINT16;
-    geometryTrianglesData.indexData.deviceAddress                         = indexBufferAddress;
+    VkSemaphoreWaitInfo semaphoreWaitInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    semaphoreWaitInfo.semaphoreCount      = 1;
+    semaphoreWaitInfo.pSemaphores         = &semaphore;
+    semaphoreWaitInfo.pValues             = &completedValue;
 
-    VkAccelerationStructureGeometryKHR geometry   = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
-    geometry.flags                                = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-    geometry.geometry.triangles                   = geometryTrianglesData;
-    VkAccelerationStructureGeometryKHR* pGeometry = &geometry;
+    VK_CHECK(vkWaitSemaphores(device, &semaphoreWaitInfo, UINT64_MAX));
 
-    VkAccelerationStructureMemoryRequirementsInfoKHR scratchMemoryRequirementsInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_KHR};
-    scratchMemoryRequirementsInfo.type                                             = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_BUILD_SCRATCH_KHR;
-    scratchMemoryRequirementsInfo.buildType                                        = VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR;
-    scratchMemoryRequirementsInfo.accelerationStructure                            = accelerationStructure.accelerationStructure;
+    vkDestroySemaphore(device, semaphore, nullptr);
+}
 
-    VkMemoryRequirements2 scracthMemoryRequirements2 = {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
-    vkGetAccelerationStructureMemoryRequirementsKHR(device, &scratchMemoryRequirementsInfo, &scracthMemoryRequirements2);
+// Builds read uploaded data, so they wait on the uploader's timeline as well
+static void submitBuild(const VkDevice device, const VkQueue queue, const VkCommandBuffer commandBuffer, const Uploader& uploader) {
+    VkSemaphore          uploadSemaphore = uploader.getSemaphore();
+    VkPipelineStageFlags uploadWaitStage = VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR;
+    uint64_t             uploadWaitValue = uploader.getFlushedValue();
 
-    Buffer scratchBuffer = createBuffer(device, scracthMemoryRequirements2.memoryRequirements.size,
-                                        VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, physicalDeviceMemoryProperties,
-                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    timelineSemaphoreSubmitInfo.waitSemaphoreValueCount       = 1;
+    timelineSemaphoreSubmitInfo.pWaitSemaphoreValues          = &uploadWaitValue;
 
-    VkBufferDeviceAddressInfo scratchBufferDeviceAddressInfo = {VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
-    scratchBufferDeviceAddressInfo.buffer                    = scratchBuffer.buffer;
+    VkSubmitInfo submitInfo       = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.pNext              = &timelineSemaphoreSubmitInfo;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores    = &uploadSemaphore;
+    submitInfo.pWaitDstStageMask  = &uploadWaitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &commandBuffer;
 
-    VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
-    buildGeometryInfo.type                                        = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    buildGeometryInfo.flags                                       = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    buildGeometryInfo.update                                      = VK_FALSE;
-    buildGeometryInfo.srcAccelerationStructure                    = nullptr;
-    buildGeometryInfo.dstAccelerationStructure                    = accelerationStructure.accelerationStructure;
-    buildGeometryInfo.geometryArrayOfPointers                     = VK_FALSE;
-    buildGeometryInfo.geometryCount                               = 1;
-    buildGeometryInfo.ppGeometries                                = &pGeometry;
-    buildGeometryInfo.scratchData.deviceAddress                   = vkGetBufferDeviceAddress(device, &scratchBufferDeviceAddressInfo);
+    submitAndWait(device, queue, submitInfo);
+}
 
-    VkAccelerationStructureBuildOffsetInfoKHR buildOffsetInfo   = {};
-    buildOffsetInfo.primitiveCount                              = primitiveCount;
-    buildOffsetInfo.primitiveOffset                             = 0;
-    buildOffsetInfo.firstVertex                                 = 0;
-    buildOffsetInfo.transformOffset                             = 0;
-    VkAccelerationStructureBuildOffsetInfoKHR* pBuildOffsetInfo = &buildOffsetInfo;
+std::vector<AccelerationStructure> createBottomAccelerationStructures(const VkDevice device, const std::vector<BottomLevelGeometry>& geometries,
+                                                                      const bool allowCompaction, MemoryAllocator& memoryAllocator, Uploader& uploader,
+                                                                      const VkQueue queue, const uint32_t queueFamilyIndex) {
+    PROFILE_ZONE("createBottomAccelerationStructures");
+
+    const size_t geometryCount = geometries.size();
+
+    VkBuildAccelerationStructureFlagsKHR compactionFlags = allowCompaction ? VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR : 0;
+
+    std::vector<AccelerationStructure> accelerationStructures(geometryCount);
+    std::vector<VkDeviceSize>          scratchSizes(geometryCount);
+
+    VkDeviceSize scratchAlignment = SCRATCH_MIN_ALIGNMENT;
+
+    for (size_t i = 0; i < geometryCount; ++i) {
+        VkAccelerationStructureCreateGeometryTypeInfoKHR createGeometryTypeInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_GEOMETRY_TYPE_INFO_KHR};
+        createGeometryTypeInfo.geometryType                                     = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+        createGeometryTypeInfo.maxPrimitiveCount                                = geometries[i].primitiveCount;
+        createGeometryTypeInfo.indexType                                        = geometries[i].indexType;
+        createGeometryTypeInfo.maxVertexCount                                   = geometries[i].vertexCount;
+        createGeometryTypeInfo.vertexFormat                                     = geometries[i].vertexFormat;
+        createGeometryTypeInfo.allowsTransforms                                 = VK_FALSE;
+
+        VkAccelerationStructureCreateInfoKHR createInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
+        createInfo.type                                 = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        createInfo.flags                                = geometries[i].buildFlags | compactionFlags;
+        createInfo.maxGeometryCount                     = 1;
+        createInfo.pGeometryInfos                       = &createGeometryTypeInfo;
+
+        AccelerationStructure& accelerationStructure = accelerationStructures[i];
+        accelerationStructure.buildFlags             = createInfo.flags;
+        VK_CHECK(vkCreateAccelerationStructureKHR(device, &createInfo, nullptr, &accelerationStructure.accelerationStructure));
+
+        VkAccelerationStructureMemoryRequirementsInfoKHR memoryRequirementsInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_KHR};
+        memoryRequirementsInfo.type                                             = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_OBJECT_KHR;
+        memoryRequirementsInfo.buildType                                        = VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR;
+        memoryRequirementsInfo.accelerationStructure                            = accelerationStructure.accelerationStructure;
+
+        VkMemoryRequirements2 objectMemoryRequirements2 = {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+        vkGetAccelerationStructureMemoryRequirementsKHR(device, &memoryRequirementsInfo, &objectMemoryRequirements2);
+
+        accelerationStructure.allocation = memoryAllocator.allocate(objectMemoryRequirements2.memoryRequirements, MemoryUsage::AccelerationStructure);
+
+        VkBindAccelerationStructureMemoryInfoKHR bindMemoryInfo = {VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_KHR};
+        bindMemoryInfo.accelerationStructure                    = accelerationStructure.accelerationStructure;
+        bindMemoryInfo.memory                                   = accelerationStructure.allocation.memory;
+        bindMemoryInfo.memoryOffset                             = accelerationStructure.allocation.offset;
+
+        VK_CHECK(vkBindAccelerationStructureMemoryKHR(device, 1, &bindMemoryInfo));
+
+        memoryRequirementsInfo.type = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_BUILD_SCRATCH_KHR;
+
+        VkMemoryRequirements2 scratchMemoryRequirements2 = {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+        vkGetAccelerationStructureMemoryRequirementsKHR(device, &memoryRequirementsInfo, &scratchMemoryRequirements2);
+
+        scratchSizes[i]  = scratchMemoryRequirements2.memoryRequirements.size;
+        scratchAlignment = std::max(scratchAlignment, scratchMemoryRequirements2.memoryRequirements.alignment);
+    }
+
+    // Builds are split into groups whose scratch fits the budget, a build larger than the budget gets a group of its own.
+    // Every group reuses the same scratch pool, so groups are separated by a barrier.
+    std::vector<size_t>       groupStarts  = {0};
+    std::vector<VkDeviceSize> scratchOffsets(geometryCount);
+    VkDeviceSize              groupScratchSize = 0;
+    VkDeviceSize              scratchPoolSize  = 0;
+
+    for (size_t i = 0; i < geometryCount; ++i) {
+        VkDeviceSize alignedScratchSize = alignUp(scratchSizes[i], scratchAlignment);
+
+        if (groupScratchSize > 0 && groupScratchSize + alignedScratchSize > SCRATCH_BUDGET) {
+            groupStarts.push_back(i);
+            groupScratchSize = 0;
+        }
+
+        scratchOffsets[i] = groupScratchSize;
+        groupScratchSize += alignedScratchSize;
+        scratchPoolSize = std::max(scratchPoolSize, groupScratchSize);
+    }
+    groupStarts.push_back(geometryCount);
+
+    VkBufferUsageFlags scratchBufferUsageFlags = VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+    Buffer scratchBuffer = createBuffer(device, memoryAllocator, scratchPoolSize, scratchBufferUsageFlags, MemoryUsage::DeviceAddressBuffer);
+
+    std::vector<VkAccelerationStructureGeometryKHR>          accelerationStructureGeometries(geometryCount);
+    std::vector<VkAccelerationStructureGeometryKHR*>         pGeometries(geometryCount);
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos(geometryCount);
+    std::vector<VkAccelerationStructureBuildOffsetInfoKHR>   buildOffsetInfos(geometryCount);
+    std::vector<VkAccelerationStructureBuildOffsetInfoKHR*>  pBuildOffsetInfos(geometryCount);
+
+    for (size_t i = 0; i < geometryCount; ++i) {
+        VkAccelerationStructureGeometryTrianglesDataKHR geometryTrianglesData = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR};
+        geometryTrianglesData.vertexFormat                                    = geometries[i].vertexFormat;
+        geometryTrianglesData.vertexData.deviceAddress                        = geometries[i].vertexBufferAddress;
+        geometryTrianglesData.vertexStride                                    = geometries[i].vertexStride;
+        geometryTrianglesData.indexType                                       = geometries[i].indexType;
+        geometryTrianglesData.indexData.deviceAddress                         = geometries[i].indexBufferAddress;
+
+        accelerationStructureGeometries[i]                    = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
+        accelerationStructureGeometries[i].geometryType       = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+        accelerationStructureGeometries[i].geometry.triangles = geometryTrianglesData;
+        pGeometries[i]                                        = &accelerationStructureGeometries[i];
+
+        buildGeometryInfos[i]                           = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
+        buildGeometryInfos[i].type                      = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        buildGeometryInfos[i].flags                     = geometries[i].buildFlags | compactionFlags;
+        buildGeometryInfos[i].update                    = VK_FALSE;
+        buildGeometryInfos[i].srcAccelerationStructure  = VK_NULL_HANDLE;
+        buildGeometryInfos[i].dstAccelerationStructure  = accelerationStructures[i].accelerationStructure;
+        buildGeometryInfos[i].geometryArrayOfPointers   = VK_FALSE;
+        buildGeometryInfos[i].geometryCount             = 1;
+        buildGeometryInfos[i].ppGeometries              = &pGeometries[i];
+        buildGeometryInfos[i].scratchData.deviceAddress = scratchBuffer.deviceAddress + scratchOffsets[i];
+
+        buildOffsetInfos[i]                 = {};
+        buildOffsetInfos[i].primitiveCount  = geometries[i].primitiveCount;
+        buildOffsetInfos[i].primitiveOffset = 0;
+        buildOffsetInfos[i].firstVertex     = 0;
+        buildOffsetInfos[i].transformOffset = 0;
+        pBuildOffsetInfos[i]                = &buildOffsetInfos[i];
+    }
 
     VkCommandPool commandPool = createCommandPool(device, queueFamilyIndex);
 
@@ -110,45 +214,227 @@ AccelerationStructure createBottomAccelerationStructure(const VkDevice device, c
     VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer));
 
     VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    commandBufferBeginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
     VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
-    vkCmdBuildAccelerationStructureKHR(commandBuffer, 1, &buildGeometryInfo, &pBuildOffsetInfo);
+    uploader.recordAcquireBarriers(commandBuffer, queueFamilyIndex, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR);
+
+    for (size_t group = 0; group + 1 < groupStarts.size(); ++group) {
+        if (group > 0) {
+            VkMemoryBarrier scratchBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+            scratchBarrier.srcAccessMask   = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+            scratchBarrier.dstAccessMask   = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                 VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &scratchBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        size_t   groupStart     = groupStarts[group];
+        uint32_t groupBuildCount = static_cast<uint32_t>(groupStarts[group + 1] - groupStart);
+
+        vkCmdBuildAccelerationStructureKHR(commandBuffer, groupBuildCount, &buildGeometryInfos[groupStart], &pBuildOffsetInfos[groupStart]);
+    }
+
     VK_CHECK(vkEndCommandBuffer(commandBuffer));
 
+    submitBuild(device, queue, commandBuffer, uploader);
+
+    for (AccelerationStructure& accelerationStructure : accelerationStructures) {
+        VkAccelerationStructureDeviceAddressInfoKHR deviceAddressInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
+        deviceAddressInfo.accelerationStructure                       = accelerationStructure.accelerationStructure;
+        accelerationStructure.deviceAddress                           = vkGetAccelerationStructureDeviceAddressKHR(device, &deviceAddressInfo);
+    }
+
+    printf("Built %u bottom level acceleration structures in %u build calls with %.2fMB of scratch memory\n", static_cast<uint32_t>(geometryCount),
+           static_cast<uint32_t>(groupStarts.size() - 1), static_cast<double>(scratchPoolSize) / 1'048'576.0);
+
+    destroyBuffer(device, memoryAllocator, scratchBuffer);
+
+    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    vkDestroyCommandPool(device, commandPool, nullptr);
+
+    return accelerationStructures;
+}
+
+void compactBottomAccelerationStructures(const VkDevice device, std::vector<AccelerationStructure>& accelerationStructures, MemoryAllocator& memoryAllocator,
+                                         const VkQueue queue, const uint32_t queueFamilyIndex) {
+    PROFILE_ZONE("compactBottomAccelerationStructures");
+
+    const uint32_t accelerationStructureCount = static_cast<uint32_t>(accelerationStructures.size());
+    if (accelerationStructureCount == 0) {
+        return;
+    }
+
+    std::vector<VkAccelerationStructureKHR> handles(accelerationStructureCount);
+    for (uint32_t i = 0; i < accelerationStructureCount; ++i) {
+        handles[i] = accelerationStructures[i].accelerationStructure;
+    }
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    queryPoolCreateInfo.queryType             = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+    queryPoolCreateInfo.queryCount            = accelerationStructureCount;
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool));
+
+    VkCommandPool commandPool = createCommandPool(device, queueFamilyIndex);
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    commandBufferAllocateInfo.commandPool                 = commandPool;
+    commandBufferAllocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount          = 1;
+
+    VkCommandBuffer commandBuffer = 0;
+    VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer));
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    commandBufferBeginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
     VkSubmitInfo submitInfo       = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers    = &commandBuffer;
-    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, nullptr));
 
-    VkAccelerationStructureDeviceAddressInfoKHR deviceAddressInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
-    deviceAddressInfo.accelerationStructure                       = accelerationStructure.accelerationStructure;
-    accelerationStructure.deviceAddress                           = vkGetAccelerationStructureDeviceAddressKHR(device, &deviceAddressInfo);
+    // The builds were waited on, so their results can be queried right away
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+    vkCmdResetQueryPool(commandBuffer, queryPool, 0, accelerationStructureCount);
+    vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, accelerationStructureCount, handles.data(),
+                                                  VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, 0);
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+    submitAndWait(device, queue, submitInfo);
 
-    vkDeviceWaitIdle(device);
+    std::vector<VkDeviceSize> compactedSizes(accelerationStructureCount);
+    VK_CHECK(vkGetQueryPoolResults(device, queryPool, 0, accelerationStructureCount, sizeof(VkDeviceSize) * compactedSizes.size(), compactedSizes.data(),
+                                   sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
 
-    vkFreeMemory(device, scratchBuffer.memory, nullptr);
-    vkDestroyBuffer(device, scratchBuffer.buffer, nullptr);
+    std::vector<AccelerationStructure> compactedAccelerationStructures(accelerationStructureCount);
+    for (uint32_t i = 0; i < accelerationStructureCount; ++i) {
+        VkAccelerationStructureCreateInfoKHR createInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
+        createInfo.compactedSize                        = compactedSizes[i];
+        createInfo.type                                 = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        createInfo.flags                                = accelerationStructures[i].buildFlags;
+        createInfo.maxGeometryCount                     = 0; // Has to be zero for the target of a compacting copy
+
+        AccelerationStructure& compactedAccelerationStructure = compactedAccelerationStructures[i];
+        compactedAccelerationStructure.buildFlags             = createInfo.flags;
+        VK_CHECK(vkCreateAccelerationStructureKHR(device, &createInfo, nullptr, &compactedAccelerationStructure.accelerationStructure));
+
+        VkAccelerationStructureMemoryRequirementsInfoKHR memoryRequirementsInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_KHR};
+        memoryRequirementsInfo.type                                             = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_OBJECT_KHR;
+        memoryRequirementsInfo.buildType                                        = VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR;
+        memoryRequirementsInfo.accelerationStructure                            = compactedAccelerationStructure.accelerationStructure;
+
+        VkMemoryRequirements2 memoryRequirements2 = {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+        vkGetAccelerationStructureMemoryRequirementsKHR(device, &memoryRequirementsInfo, &memoryRequirements2);
+
+        compactedAccelerationStructure.allocation = memoryAllocator.allocate(memoryRequirements2.memoryRequirements, MemoryUsage::AccelerationStructure);
+
+        VkBindAccelerationStructureMemoryInfoKHR bindMemoryInfo = {VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_KHR};
+        bindMemoryInfo.accelerationStructure                    = compactedAccelerationStructure.accelerationStructure;
+        bindMemoryInfo.memory                                   = compactedAccelerationStructure.allocation.memory;
+        bindMemoryInfo.memoryOffset                             = compactedAccelerationStructure.allocation.offset;
+
+        VK_CHECK(vkBindAccelerationStructureMemoryKHR(device, 1, &bindMemoryInfo));
+    }
+
+    VK_CHECK(vkResetCommandPool(device, commandPool, 0));
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+
+    for (uint32_t i = 0; i < accelerationStructureCount; ++i) {
+        VkCopyAccelerationStructureInfoKHR copyInfo = {VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR};
+        copyInfo.src                                = accelerationStructures[i].accelerationStructure;
+        copyInfo.dst                                = compactedAccelerationStructures[i].accelerationStructure;
+        copyInfo.mode                               = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+
+        vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+    }
+
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+    submitAndWait(device, queue, submitInfo);
+
+    VkDeviceSize originalTotal  = 0;
+    VkDeviceSize compactedTotal = 0;
+    for (uint32_t i = 0; i < accelerationStructureCount; ++i) {
+        AccelerationStructure& compactedAccelerationStructure = compactedAccelerationStructures[i];
+
+        VkAccelerationStructureDeviceAddressInfoKHR deviceAddressInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
+        deviceAddressInfo.accelerationStructure                       = compactedAccelerationStructure.accelerationStructure;
+        compactedAccelerationStructure.deviceAddress                  = vkGetAccelerationStructureDeviceAddressKHR(device, &deviceAddressInfo);
+
+        VkDeviceSize originalSize  = accelerationStructures[i].allocation.size;
+        VkDeviceSize compactedSize = compactedAccelerationStructure.allocation.size;
+        originalTotal += originalSize;
+        compactedTotal += compactedSize;
+
+        printf("    BLAS %u: %.2fKB -> %.2fKB, saved %.2fKB\n", i, static_cast<double>(originalSize) / 1'024.0, static_cast<double>(compactedSize) / 1'024.0,
+               static_cast<double>(originalSize - compactedSize) / 1'024.0);
+
+        destroyAccelerationStructure(device, memoryAllocator, accelerationStructures[i]);
+        accelerationStructures[i] = compactedAccelerationStructure;
+    }
+
+    printf("Compacted %u bottom level acceleration structures from %.2fMB to %.2fMB, saved %.2fMB\n", accelerationStructureCount,
+           static_cast<double>(originalTotal) / 1'048'576.0, static_cast<double>(compactedTotal) / 1'048'576.0,
+           static_cast<double>(originalTotal - compactedTotal) / 1'048'576.0);
 
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
     vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyQueryPool(device, queryPool, nullptr);
+}
+
+static void writeTopLevelInstances(const std::vector<TopLevelInstance>& instances,
+                                   const std::vector<AccelerationStructure>& bottomLevelAccelerationStructures, Buffer& instanceBuffer) {
+    VkAccelerationStructureInstanceKHR* mappedInstances = reinterpret_cast<VkAccelerationStructureInstanceKHR*>(instanceBuffer.allocation.mappedData);
+
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const TopLevelInstance& instance = instances[i];
+
+        VkAccelerationStructureInstanceKHR instanceData     = {};
+        instanceData.transform                              = instance.transform;
+        instanceData.instanceCustomIndex                    = instance.customIndex & 0xFFFFFF;
+        instanceData.mask                                   = instance.mask;
+        instanceData.instanceShaderBindingTableRecordOffset = instance.shaderBindingTableOffset & 0xFFFFFF;
+        instanceData.flags                                  = static_cast<uint8_t>(instance.flags);
+        instanceData.accelerationStructureReference         = bottomLevelAccelerationStructures[instance.bottomLevelIndex].deviceAddress;
+
+        // Assembled on the stack first, so the bitfields don't turn into reads of write combined memory
+        mappedInstances[i] = instanceData;
+    }
+}
+
+static VkDeviceSize getScratchSize(const VkDevice device, const VkAccelerationStructureKHR accelerationStructure,
+                                   const VkAccelerationStructureMemoryRequirementsTypeKHR type) {
+    VkAccelerationStructureMemoryRequirementsInfoKHR scratchMemoryRequirementsInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_KHR};
+    scratchMemoryRequirementsInfo.type                                             = type;
+    scratchMemoryRequirementsInfo.buildType                                        = VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR;
+    scratchMemoryRequirementsInfo.accelerationStructure                            = accelerationStructure;
+
+    VkMemoryRequirements2 scratchMemoryRequirements2 = {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+    vkGetAccelerationStructureMemoryRequirementsKHR(device, &scratchMemoryRequirementsInfo, &scratchMemoryRequirements2);
 
-    return accelerationStructure;
+    return scratchMemoryRequirements2.memoryRequirements.size;
 }
 
-AccelerationStructure createTopAccelerationStructure(const VkDevice device, const AccelerationStructure bottomLevelAccelerationStructure,
-                                                     const VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties, const VkQueue queue,
-                                                     const uint32_t queueFamilyIndex) {
+TopLevelAccelerationStructure createTopAccelerationStructure(const VkDevice device, const uint32_t maxInstanceCount, const uint32_t frameCount,
+                                                             MemoryAllocator& memoryAllocator) {
+    PROFILE_ZONE("createTopAccelerationStructure");
+
     VkAccelerationStructureCreateGeometryTypeInfoKHR createGeometryTypeInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_GEOMETRY_TYPE_INFO_KHR};
     createGeometryTypeInfo.geometryType                                     = VK_GEOMETRY_TYPE_INSTANCES_KHR;
-    createGeometryTypeInfo.maxPrimitiveCount                                = 1;
-    createGeometryTypeInfo.allowsTransforms                                 = VK_FALSE;
+    createGeometryTypeInfo.maxPrimitiveCount                                = maxInstanceCount;
+    createGeometryTypeInfo.allowsTransforms                                 = VK_TRUE;
 
     VkAccelerationStructureCreateInfoKHR createInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
     createInfo.type                                 = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-    createInfo.flags                                = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+    createInfo.flags                                = TOP_LEVEL_BUILD_FLAGS;
     createInfo.maxGeometryCount                     = 1;
     createInfo.pGeometryInfos                       = &createGeometryTypeInfo;
 
-    AccelerationStructure accelerationStructure;
+    TopLevelAccelerationStructure topLevelAccelerationStructure = {};
+    topLevelAccelerationStructure.maxInstanceCount              = maxInstanceCount;
+
+    AccelerationStructure& accelerationStructure = topLevelAccelerationStructure.accelerationStructure;
     VK_CHECK(vkCreateAccelerationStructureKHR(device, &createInfo, nullptr, &accelerationStructure.accelerationStructure));
 
     VkAccelerationStructureMemoryRequirementsInfoKHR objectMemoryRequirementsInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_KHR};
@@ -159,62 +445,74 @@ AccelerationStructure createTopAccelerationStructure(const VkDevice device, cons
     VkMemoryRequirements2 objectMemoryRequirements2 = {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
     vkGetAccelerationStructureMemoryRequirementsKHR(device, &objectMemoryRequirementsInfo, &objectMemoryRequirements2);
 
-    uint32_t memoryType =
-        findMemoryType(physicalDeviceMemoryProperties, objectMemoryRequirements2.memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO};
-    memoryAllocateFlagsInfo.flags                     = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
-
-    VkMemoryAllocateInfo memoryAllocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    memoryAllocateInfo.allocationSize       = objectMemoryRequirements2.memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex      = memoryType;
-    memoryAllocateInfo.pNext                = &memoryAllocateFlagsInfo;
-
-    VK_CHECK(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &accelerationStructure.memory));
+    accelerationStructure.allocation = memoryAllocator.allocate(objectMemoryRequirements2.memoryRequirements, MemoryUsage::AccelerationStructure);
 
     VkBindAccelerationStructureMemoryInfoKHR bindMemoryInfo = {VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_KHR};
     bindMemoryInfo.accelerationStructure                    = accelerationStructure.accelerationStructure;
-    bindMemoryInfo.memory                                   = accelerationStructure.memory;
-    bindMemoryInfo.memoryOffset                             = 0;
+    bindMemoryInfo.memory                                   = accelerationStructure.allocation.memory;
+    bindMemoryInfo.memoryOffset                             = accelerationStructure.allocation.offset;
 
     VK_CHECK(vkBindAccelerationStructureMemoryKHR(device, 1, &bindMemoryInfo));
 
-    // clang-format off
-    VkTransformMatrixKHR transformationMatrix = {
-        1.0f, 0.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f
-    };
-    // clang-format on
-
-    VkAccelerationStructureInstanceKHR instance;
-    instance.transform                              = transformationMatrix;
-    instance.instanceCustomIndex                    = 0;
-    instance.mask                                   = 0xFF;
-    instance.instanceShaderBindingTableRecordOffset = 0;
-    instance.flags                                  = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-    instance.accelerationStructureReference         = bottomLevelAccelerationStructure.deviceAddress;
-
-    accelerationStructure.instanceBuffer =
-        createBuffer(device, sizeof(VkAccelerationStructureInstanceKHR),
-                                         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                                         physicalDeviceMemoryProperties, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
-
-    std::vector<VkAccelerationStructureInstanceKHR> instances = {instance};
+    VkAccelerationStructureDeviceAddressInfoKHR deviceAddressInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
+    deviceAddressInfo.accelerationStructure                       = accelerationStructure.accelerationStructure;
+    accelerationStructure.deviceAddress                           = vkGetAccelerationStructureDeviceAddressKHR(device, &deviceAddressInfo);
+
+    addTopAccelerationStructureFrames(device, memoryAllocator, topLevelAccelerationStructure, frameCount);
 
-    VkCommandPool commandPool = createCommandPool(device, queueFamilyIndex);
+    VkDeviceSize buildScratchSize =
+        getScratchSize(device, accelerationStructure.accelerationStructure, VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_BUILD_SCRATCH_KHR);
+    VkDeviceSize updateScratchSize =
+        getScratchSize(device, accelerationStructure.accelerationStructure, VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_UPDATE_SCRATCH_KHR);
+
+    topLevelAccelerationStructure.scratchBuffer =
+        createBuffer(device, memoryAllocator, std::max(buildScratchSize, updateScratchSize),
+                     VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, MemoryUsage::DeviceAddressBuffer);
+
+    return topLevelAccelerationStructure;
+}
+
+// Builds read the instances straight from host visible memory, there is no staging copy to wait on
+void addTopAccelerationStructureFrames(const VkDevice device, MemoryAllocator& memoryAllocator, TopLevelAccelerationStructure& topLevelAccelerationStructure,
+                                       const uint32_t frameCount) {
+    std::vector<Buffer>& instanceBuffers = topLevelAccelerationStructure.instanceBuffers;
+    while (instanceBuffers.size() < frameCount) {
+        instanceBuffers.push_back(createBuffer(device, memoryAllocator,
+                                               sizeof(VkAccelerationStructureInstanceKHR) * std::max(topLevelAccelerationStructure.maxInstanceCount, 1u),
+                                               VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, MemoryUsage::MappedDeviceAddressBuffer));
+    }
+}
+
+void recordTopAccelerationStructureUpdate(const VkCommandBuffer commandBuffer, const std::vector<TopLevelInstance>& instances,
+                                          const std::vector<AccelerationStructure>& bottomLevelAccelerationStructures,
+                                          TopLevelAccelerationStructure& topLevelAccelerationStructure, const uint32_t frameIndex) {
+    PROFILE_ZONE("recordTopAccelerationStructureUpdate");
 
-    Buffer stagingBuffer = createBuffer(device, sizeof(VkAccelerationStructureInstanceKHR), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, physicalDeviceMemoryProperties,
-                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    const uint32_t instanceCount = static_cast<uint32_t>(instances.size());
+    if (instanceCount > topLevelAccelerationStructure.maxInstanceCount) {
+        throw std::runtime_error("Instance count exceeds the capacity of the top level acceleration structure!");
+    }
 
-    uploadToDeviceLocalBuffer(device, instances, stagingBuffer.buffer, stagingBuffer.memory, accelerationStructure.instanceBuffer.buffer, commandPool, queue);
+    Buffer& instanceBuffer = topLevelAccelerationStructure.instanceBuffers[frameIndex];
+    writeTopLevelInstances(instances, bottomLevelAccelerationStructures, instanceBuffer);
 
-    vkFreeMemory(device, stagingBuffer.memory, nullptr);
-    vkDestroyBuffer(device, stagingBuffer.buffer, nullptr);
+    // Refits keep the tree of the last full build and only grow its bounds, so trace performance drops the further instances move from where they were built
+    bool refit = topLevelAccelerationStructure.built && instanceCount == topLevelAccelerationStructure.instanceCount &&
+                 topLevelAccelerationStructure.refitCount < TOP_LEVEL_REFIT_LIMIT;
+
+    if (refit) {
+        ++topLevelAccelerationStructure.refitCount;
+    } else {
+        topLevelAccelerationStructure.instanceCount = instanceCount;
+        topLevelAccelerationStructure.refitCount    = 0;
+        topLevelAccelerationStructure.built         = true;
+    }
+
+    VkAccelerationStructureKHR accelerationStructure = topLevelAccelerationStructure.accelerationStructure.accelerationStructure;
 
     VkAccelerationStructureGeometryInstancesDataKHR geometryInstanceData = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR};
     geometryInstanceData.arrayOfPointers                                 = VK_FALSE;
-    geometryInstanceData.data.deviceAddress                              = accelerationStructure.instanceBuffer.deviceAddress;
+    geometryInstanceData.data.deviceAddress                              = instanceBuffer.deviceAddress;
 
     VkAccelerationStructureGeometryKHR geometry   = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
     geometry.geometryType                         = VK_GEOMETRY_TYPE_INSTANCES_KHR;
@@ -222,65 +520,57 @@ AccelerationStructure createTopAccelerationStructure(const VkDevice device, cons
     geometry.geometry.instances                   = geometryInstanceData;
     VkAccelerationStructureGeometryKHR* pGeometry = &geometry;
 
-    VkAccelerationStructureMemoryRequirementsInfoKHR scratchMemoryRequirementsInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_KHR};
-    scratchMemoryRequirementsInfo.type                                             = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_BUILD_SCRATCH_KHR;
-    scratchMemoryRequirementsInfo.buildType                                        = VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR;
-    scratchMemoryRequirementsInfo.accelerationStructure                            = accelerationStructure.accelerationStructure;
-
-    VkMemoryRequirements2 scracthMemoryRequirements2 = {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
-    vkGetAccelerationStructureMemoryRequirementsKHR(device, &scratchMemoryRequirementsInfo, &scracthMemoryRequirements2);
-
-    Buffer scratchBuffer = createBuffer(device, scracthMemoryRequirements2.memoryRequirements.size,
-                                        VK_BUFFER_USAGE_RAY_TRACING_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, physicalDeviceMemoryProperties,
-                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
-
+    // Refits happen in place, the structure is both the source and the destination
     VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
     buildGeometryInfo.type                                        = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-    buildGeometryInfo.flags                                       = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    buildGeometryInfo.update                                      = VK_FALSE;
-    buildGeometryInfo.srcAccelerationStructure                    = VK_NULL_HANDLE;
-    buildGeometryInfo.dstAccelerationStructure                    = accelerationStructure.accelerationStructure;
+    buildGeometryInfo.flags                                       = TOP_LEVEL_BUILD_FLAGS;
+    buildGeometryInfo.update                                      = refit ? VK_TRUE : VK_FALSE;
+    buildGeometryInfo.srcAccelerationStructure                    = refit ? accelerationStructure : VK_NULL_HANDLE;
+    buildGeometryInfo.dstAccelerationStructure                    = accelerationStructure;
     buildGeometryInfo.geometryArrayOfPointers                     = VK_FALSE;
     buildGeometryInfo.geometryCount                               = 1;
     buildGeometryInfo.ppGeometries                                = &pGeometry;
-    buildGeometryInfo.scratchData.deviceAddress                   = scratchBuffer.deviceAddress;
+    buildGeometryInfo.scratchData.deviceAddress                   = topLevelAccelerationStructure.scratchBuffer.deviceAddress;
 
     VkAccelerationStructureBuildOffsetInfoKHR buildOffsetInfo   = {};
-    buildOffsetInfo.primitiveCount                              = 1;
+    buildOffsetInfo.primitiveCount                              = instanceCount;
     buildOffsetInfo.primitiveOffset                             = 0;
     buildOffsetInfo.firstVertex                                 = 0;
     buildOffsetInfo.transformOffset                             = 0;
     VkAccelerationStructureBuildOffsetInfoKHR* pBuildOffsetInfo = &buildOffsetInfo;
 
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
-    commandBufferAllocateInfo.commandPool                 = commandPool;
-    commandBufferAllocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount          = 1;
+    // Previous frames may still be tracing against the structure, and their builds wrote the shared scratch buffer
+    VkMemoryBarrier beforeBuildBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    beforeBuildBarrier.srcAccessMask   = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    beforeBuildBarrier.dstAccessMask   = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
 
-    VkCommandBuffer commandBuffer = 0;
-    VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer));
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &beforeBuildBarrier, 0, nullptr, 0, nullptr);
 
-    VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
     vkCmdBuildAccelerationStructureKHR(commandBuffer, 1, &buildGeometryInfo, &pBuildOffsetInfo);
-    VK_CHECK(vkEndCommandBuffer(commandBuffer));
 
-    VkSubmitInfo submitInfo       = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers    = &commandBuffer;
-    VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, nullptr));
+    VkMemoryBarrier afterBuildBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    afterBuildBarrier.srcAccessMask   = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    afterBuildBarrier.dstAccessMask   = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
 
-    VkAccelerationStructureDeviceAddressInfoKHR deviceAddressInfo = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
-    deviceAddressInfo.accelerationStructure                       = accelerationStructure.accelerationStructure;
-    accelerationStructure.deviceAddress                           = vkGetAccelerationStructureDeviceAddressKHR(device, &deviceAddressInfo);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1,
+                         &afterBuildBarrier, 0, nullptr, 0, nullptr);
+}
 
-    vkDeviceWaitIdle(device);
+void destroyAccelerationStructure(const VkDevice device, MemoryAllocator& memoryAllocator, AccelerationStructure& accelerationStructure) {
+    vkDestroyAccelerationStructureKHR(device, accelerationStructure.accelerationStructure, nullptr);
+    memoryAllocator.deallocate(accelerationStructure.allocation);
 
-    vkFreeMemory(device, scratchBuffer.memory, nullptr);
-    vkDestroyBuffer(device, scratchBuffer.buffer, nullptr);
+    accelerationStructure = {};
+}
 
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-    vkDestroyCommandPool(device, commandPool, nullptr);
+void destroyTopAccelerationStructure(const VkDevice device, MemoryAllocator& memoryAllocator, TopLevelAccelerationStructure& topLevelAccelerationStructure) {
+    for (Buffer& instanceBuffer : topLevelAccelerationStructure.instanceBuffers) {
+        destroyBuffer(device, memoryAllocator, instanceBuffer);
+    }
+
+    destroyBuffer(device, memoryAllocator, topLevelAccelerationStructure.scratchBuffer);
+    destroyAccelerationStructure(device, memoryAllocator, topLevelAccelerationStructure.accelerationStructure);
 
-    return accelerationStructure;
+    topLevelAccelerationStructure = {};
 }
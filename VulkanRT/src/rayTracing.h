@@ -3,24 +3,78 @@
 #include "common.h"
 
 #include "resources.h"
+#include "uploader.h"
 
 #pragma warning(push, 0)
 #define VK_ENABLE_BETA_EXTENSIONS
 #include "volk.h"
 #pragma warning(pop)
 
+#include <vector>
+
 struct AccelerationStructure {
-    VkAccelerationStructureKHR accelerationStructure = VK_NULL_HANDLE;
-    VkDeviceMemory             memory                = VK_NULL_HANDLE;
-    VkDeviceAddress            deviceAddress         = VK_NULL_HANDLE;
-    Buffer                     instanceBuffer        = {};
+    VkAccelerationStructureKHR           accelerationStructure = VK_NULL_HANDLE;
+    Allocation                           allocation            = {};
+    VkDeviceAddress                      deviceAddress         = VK_NULL_HANDLE;
+    VkBuildAccelerationStructureFlagsKHR buildFlags            = 0; // Created with, compacted copies keep them
+};
+
+struct BottomLevelGeometry {
+    uint32_t                             vertexCount         = 0;
+    uint32_t                             primitiveCount      = 0;
+    VkDeviceAddress                      vertexBufferAddress = 0;
+    VkDeviceAddress                      indexBufferAddress  = 0;
+    VkFormat                             vertexFormat        = VK_FORMAT_R32G32B32_SFLOAT;
+    VkDeviceSize                         vertexStride        = 3 * sizeof(float);
+    VkIndexType                          indexType           = VK_INDEX_TYPE_UINT16;
+    VkBuildAccelerationStructureFlagsKHR buildFlags          = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+};
+
+// Builds are submitted to queue after waiting for everything flushed by uploader, the queue may belong to a dedicated compute family.
+// All bottom level structures are built from one submission with a shared scratch pool and waited on through a single timeline value.
+std::vector<AccelerationStructure> createBottomAccelerationStructures(const VkDevice device, const std::vector<BottomLevelGeometry>& geometries,
+                                                                      const bool allowCompaction, MemoryAllocator& memoryAllocator, Uploader& uploader,
+                                                                      const VkQueue queue, const uint32_t queueFamilyIndex);
+
+// Replaces every structure with a right-sized copy with the same build flags and frees the originals, they have to be built with allowCompaction
+void compactBottomAccelerationStructures(const VkDevice device, std::vector<AccelerationStructure>& accelerationStructures, MemoryAllocator& memoryAllocator,
+                                         const VkQueue queue, const uint32_t queueFamilyIndex);
+
+struct TopLevelInstance {
+    uint32_t                   bottomLevelIndex         = 0; // Index into the bottom level structures the instance buffer is written from
+    VkTransformMatrixKHR       transform                = {{{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}}}; // Row major 3x4
+    uint32_t                   customIndex              = 0; // 24 bits, gl_InstanceCustomIndexEXT
+    uint8_t                    mask                     = 0xFF;
+    uint32_t                   shaderBindingTableOffset = 0; // 24 bits
+    VkGeometryInstanceFlagsKHR flags                    = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+};
+
+// Instance data is written by the host into one buffer per frame in flight, so a frame never overwrites instances a previous frame's build still reads
+struct TopLevelAccelerationStructure {
+    AccelerationStructure accelerationStructure = {};
+    std::vector<Buffer>   instanceBuffers;           // Persistently mapped, indexed by frame
+    Buffer                scratchBuffer    = {};     // Sized for both full builds and refits, shared by every frame
+    uint32_t              maxInstanceCount = 0;
+    uint32_t              instanceCount    = 0;      // Instance count of the last full build, refits can't change it
+    uint32_t              refitCount       = 0;      // Refits since the last full build
+    bool                  built            = false;
 };
 
-AccelerationStructure createBottomAccelerationStructure(const VkDevice device, const uint32_t vertexCount, const uint32_t primitiveCount,
-                                                        const VkDeviceAddress vertexBufferAddress, const VkDeviceAddress indexBufferAddress,
-                                                        const VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties, const VkQueue queue,
-                                                        const uint32_t queueFamilyIndex);
+// Only allocates the structure, the first recordTopAccelerationStructureUpdate records its initial build.
+// Any number of instances can reference the same bottom level structure, which keeps memory and build time flat as instance counts grow.
+TopLevelAccelerationStructure createTopAccelerationStructure(const VkDevice device, const uint32_t maxInstanceCount, const uint32_t frameCount,
+                                                             MemoryAllocator& memoryAllocator);
+
+// Creates the instance buffers of frames up to frameCount, for render targets added after creation
+void addTopAccelerationStructureFrames(const VkDevice device, MemoryAllocator& memoryAllocator, TopLevelAccelerationStructure& topLevelAccelerationStructure,
+                                       const uint32_t frameCount);
+
+// Writes the instances into the buffer of frameIndex and records a refit of the structure into commandBuffer, or a full rebuild when the instance count
+// changed or too many refits have piled up. Barriers against the previous frame's traces and this frame's traces are recorded as well.
+void recordTopAccelerationStructureUpdate(const VkCommandBuffer commandBuffer, const std::vector<TopLevelInstance>& instances,
+                                          const std::vector<AccelerationStructure>& bottomLevelAccelerationStructures,
+                                          TopLevelAccelerationStructure& topLevelAccelerationStructure, const uint32_t frameIndex);
+
+void destroyAccelerationStructure(const VkDevice device, MemoryAllocator& memoryAllocator, AccelerationStructure& accelerationStructure);
 
-AccelerationStructure createTopAccelerationStructure(const VkDevice device, const AccelerationStructure bottomLevelAccelerationStructure,
-                                                     const VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties, const VkQueue queue,
-                                                     const uint32_t queueFamilyIndex);
+void destroyTopAccelerationStructure(const VkDevice device, MemoryAllocator& memoryAllocator, TopLevelAccelerationStructure& topLevelAccelerationStructure);
@@ -1,7 +1,5 @@
 #include "resources.h"
 
-#include <stdexcept>
-
 VkImage createImage(const VkDevice device, const VkExtent2D imageSize, const VkImageUsageFlags imageUsageFlags, const VkFormat imageFormat) {
     VkImageCreateInfo imageCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
     imageCreateInfo.imageType         = VK_IMAGE_TYPE_2D;
@@ -90,34 +88,51 @@ VkImageMemoryBarrier createImageMemoryBarrier(const VkImage image, const VkImage
     return barrier;
 }
 
-VkBuffer createBuffer(const VkDevice device, const VkDeviceSize bufferSize, const VkBufferUsageFlags bufferUsageFlags) {
+Allocation allocateImageMemory(const VkDevice device, MemoryAllocator& memoryAllocator, const VkImage image) {
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+    Allocation allocation = memoryAllocator.allocate(memoryRequirements, MemoryUsage::Image);
+    VK_CHECK(vkBindImageMemory(device, image, allocation.memory, allocation.offset));
+
+    return allocation;
+}
+
+VkBuffer createBuffer(const VkDevice device, const VkDeviceSize bufferSize, const VkBufferUsageFlags bufferUsageFlags,
+                      const std::vector<uint32_t>& queueFamilyIndices) {
     VkBufferCreateInfo bufferCreateInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
     bufferCreateInfo.size               = bufferSize;
     bufferCreateInfo.usage              = bufferUsageFlags;
     bufferCreateInfo.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
 
+    // Buffers used by several queue families skip ownership transfers, queueFamilyIndices has to be free of duplicates
+    if (queueFamilyIndices.size() > 1) {
+        bufferCreateInfo.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+        bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+        bufferCreateInfo.pQueueFamilyIndices   = queueFamilyIndices.data();
+    }
+
     VkBuffer buffer = 0;
     VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer));
 
     return buffer;
 }
 
-Buffer createBuffer(const VkDevice device, const VkDeviceSize bufferSize, const VkBufferUsageFlags bufferUsageFlags,
-                    const VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties, const VkMemoryPropertyFlags memoryPropertyFlags,
-                    const VkMemoryAllocateFlags memoryAllocateFlags) {
+Buffer createBuffer(const VkDevice device, MemoryAllocator& memoryAllocator, const VkDeviceSize bufferSize, const VkBufferUsageFlags bufferUsageFlags,
+                    const MemoryUsage memoryUsage, const std::vector<uint32_t>& queueFamilyIndices) {
 
     Buffer buffer;
-    buffer.buffer = createBuffer(device, bufferSize, bufferUsageFlags);
+    buffer.buffer = createBuffer(device, bufferSize, bufferUsageFlags, queueFamilyIndices);
 
     VkMemoryRequirements memoryRequirements = {};
     vkGetBufferMemoryRequirements(device, buffer.buffer, &memoryRequirements);
 
-    buffer.memory = allocateVulkanObjectMemory(device, memoryRequirements, physicalDeviceMemoryProperties, memoryPropertyFlags, memoryAllocateFlags);
-    vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0);
+    buffer.allocation = memoryAllocator.allocate(memoryRequirements, memoryUsage);
+    VK_CHECK(vkBindBufferMemory(device, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset));
 
-    if (memoryPropertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT && memoryAllocateFlags & VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT) {
+    if (bufferUsageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
         VkBufferDeviceAddressInfo deviceAddressInfo = {VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
-        deviceAddressInfo.buffer = buffer.buffer;
+        deviceAddressInfo.buffer                    = buffer.buffer;
 
         buffer.deviceAddress = vkGetBufferDeviceAddress(device, &deviceAddressInfo);
     }
@@ -125,44 +140,9 @@ Buffer createBuffer(const VkDevice device, const VkDeviceSize bufferSize, const
     return buffer;
 }
 
-uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties, const uint32_t memoryTypeBits,
-                        const VkMemoryPropertyFlags memoryPropertyFlags) {
-    uint32_t memoryType = UINT32_MAX;
-    for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; ++i) {
-        bool memoryIsOfRequiredType        = memoryTypeBits & (1 << i);
-        bool memoryHasDesiredPropertyFlags = (physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & memoryPropertyFlags) == memoryPropertyFlags;
-
-        if (memoryIsOfRequiredType && memoryHasDesiredPropertyFlags) {
-            memoryType = i;
-            break;
-        }
-    }
-
-    if (memoryType == UINT32_MAX) {
-        throw std::runtime_error("Couldn't find memory type for depth image!");
-    }
-
-    return memoryType;
-}
-
-VkDeviceMemory allocateVulkanObjectMemory(const VkDevice device, const VkMemoryRequirements& memoryRequirements,
-                                          const VkPhysicalDeviceMemoryProperties& physicalDeviceMemoryProperties,
-                                          const VkMemoryPropertyFlags memoryPropertyFlags, const VkMemoryAllocateFlags memoryAllocateFlags) {
-
-    uint32_t memoryType = findMemoryType(physicalDeviceMemoryProperties, memoryRequirements.memoryTypeBits, memoryPropertyFlags);
-
-    VkMemoryAllocateInfo memoryAllocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    memoryAllocateInfo.allocationSize       = memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex      = memoryType;
-
-    VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO};
-    if (memoryAllocateFlags != 0) {
-        memoryAllocateFlagsInfo.flags = memoryAllocateFlags;
-        memoryAllocateInfo.pNext      = &memoryAllocateFlagsInfo;
-    }
-
-    VkDeviceMemory memory = 0;
-    VK_CHECK(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &memory));
+void destroyBuffer(const VkDevice device, MemoryAllocator& memoryAllocator, Buffer& buffer) {
+    vkDestroyBuffer(device, buffer.buffer, nullptr);
+    memoryAllocator.deallocate(buffer.allocation);
 
-    return memory;
+    buffer = {};
 }
@@ -0,0 +1,92 @@
+#include "scene.h"
+
+#include "meshImporter.h"
+#include "profiler.h"
+
+#include <stdexcept>
+
+// Every face has vertices of its own, so the normals stay flat
+// clang-format off
+static const float cubeVertices[] = {
+        0.5, -0.5, -0.5, 0.5, -0.5, 0.5, -0.5, -0.5, -0.5, -0.5, -0.5, 0.5,
+        0.5, -0.5, 0.5, 0.5, 0.5, 0.5, -0.5, -0.5, 0.5, -0.5, 0.5, 0.5,
+        0.5, 0.5, 0.5, 0.5, 0.5, -0.5, -0.5, 0.5, 0.5, -0.5, 0.5, -0.5,
+        0.5, 0.5, -0.5, 0.5, -0.5, -0.5, -0.5, 0.5, -0.5, -0.5, -0.5, -0.5,
+        -0.5, -0.5, -0.5, -0.5, -0.5, 0.5, -0.5, 0.5, -0.5, -0.5, 0.5, 0.5,
+        0.5, 0.5, -0.5, 0.5, 0.5, 0.5, 0.5, -0.5, -0.5, 0.5, -0.5, 0.5
+};
+// clang-format on
+
+// clang-format off
+static const float cubeNormals[] = {
+        0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0,
+        0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1,
+        0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0,
+        0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1,
+        -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0,
+        1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0
+};
+// clang-format on
+
+// clang-format off
+static const uint16_t cubeIndices[] = {
+        0, 1, 2, 2, 1, 3,
+        4, 5, 6, 6, 5, 7,
+        8, 9, 10, 10, 9, 11,
+        12, 13, 14, 14, 13, 15,
+        16, 17, 18, 18, 17, 19,
+        20, 21, 22, 22, 21, 23
+};
+// clang-format on
+
+Scene::Scene(JobSystem& jobSystem, const std::string& meshFile, const bool splitMeshes) {
+    if (meshFile.empty()) {
+        // The cube is described the same way as a mesh from a file, so the renderers don't care where the geometry came from
+        m_cubeEntry             = {};
+        m_cubeEntry.vertexCount = static_cast<uint32_t>(sizeof(cubeVertices) / MESH_VERTEX_STRIDE);
+        m_cubeEntry.indexCount  = static_cast<uint32_t>(sizeof(cubeIndices) / sizeof(uint16_t));
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            m_cubeEntry.boundsMin[axis] = -0.5f;
+            m_cubeEntry.boundsMax[axis] = 0.5f;
+        }
+
+        m_meshViews               = std::vector<MeshView>(1);
+        m_meshViews[0].entry      = &m_cubeEntry;
+        m_meshViews[0].vertices   = cubeVertices;
+        m_meshViews[0].indices    = cubeIndices;
+        m_meshViews[0].normals    = cubeNormals;
+        m_meshViews[0].vertexSize = sizeof(cubeVertices);
+        m_meshViews[0].indexSize  = sizeof(cubeIndices);
+        return;
+    }
+
+    PROFILE_ZONE("loadMeshFile");
+
+    // Imported meshes are loaded from the cache the import went to, parsing is skipped when the source was imported before
+    std::string meshFilePath = meshFile;
+    if (isImportableMesh(meshFilePath.c_str())) {
+        meshFilePath = importMeshCached(jobSystem, meshFilePath.c_str(), splitMeshes);
+    }
+
+    m_meshFile = std::make_unique<MeshFile>(meshFilePath.c_str());
+    if (m_meshFile->getMeshCount() == 0) {
+        throw std::runtime_error("Mesh file " + meshFile + " contains no meshes!");
+    }
+
+    m_meshViews = std::vector<MeshView>(m_meshFile->getMeshCount());
+    for (uint32_t i = 0; i < m_meshFile->getMeshCount(); ++i) {
+        m_meshViews[i] = m_meshFile->getMesh(i);
+    }
+}
+
+const std::vector<MeshView>& Scene::getMeshViews() const { return m_meshViews; }
+
+const bool Scene::usesUint32Indices() const {
+    for (const MeshView& meshView : m_meshViews) {
+        if (meshView.entry->indexType == MESH_INDEX_TYPE_UINT32) {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "common.h"
+
+#include "jobSystem.h"
+#include "meshFile.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#define INSTANCE_ROTATION_SPEED 0.5f           // Radians per second
+#define HEADLESS_FRAME_TIME     (1.0f / 60.0f) // Seconds, headless runs animate at a fixed step so they stay comparable
+
+// The geometry every renderer draws: the meshes of a mesh file, imported first if needed, or the built in cube without one.
+// Each mesh is an instance of its own, rotated around the y axis when instances are animated.
+class Scene {
+  public:
+    // Imports run their parallel phases on jobSystem
+    Scene(JobSystem& jobSystem, const std::string& meshFile, const bool splitMeshes);
+
+    // The views point into the mesh file mapping, they're only valid as long as the scene is
+    const std::vector<MeshView>& getMeshViews() const;
+
+    // Renderers widen every mesh to 32 bit indices as soon as one of them needs them
+    const bool usesUint32Indices() const;
+
+  private:
+    std::unique_ptr<MeshFile> m_meshFile;
+    MeshFileEntry             m_cubeEntry;
+    std::vector<MeshView>     m_meshViews;
+};
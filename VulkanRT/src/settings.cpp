@@ -0,0 +1,139 @@
+#include "settings.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+static const char* getArgumentValue(const int argc, const char* const argv[], int& index) {
+    if (index + 1 >= argc) {
+        throw std::runtime_error(std::string("Missing value for command line argument ") + argv[index] + "!");
+    }
+
+    return argv[++index];
+}
+
+static uint32_t parseUnsigned(const char* value) {
+    char*         end    = nullptr;
+    unsigned long result = strtoul(value, &end, 10);
+    if (end == value || *end != '\0') {
+        throw std::runtime_error(std::string("Invalid numeric command line value ") + value + "!");
+    }
+
+    return static_cast<uint32_t>(result);
+}
+
+static float parseFloat(const char* value) {
+    char* end    = nullptr;
+    float result = strtof(value, &end);
+    if (end == value || *end != '\0') {
+        throw std::runtime_error(std::string("Invalid numeric command line value ") + value + "!");
+    }
+
+    return result;
+}
+
+static PresentMode parsePresentMode(const char* value) {
+    if (strcmp(value, "immediate") == 0) {
+        return PresentMode::Immediate;
+    } else if (strcmp(value, "mailbox") == 0) {
+        return PresentMode::Mailbox;
+    } else if (strcmp(value, "fifo-relaxed") == 0) {
+        return PresentMode::FifoRelaxed;
+    } else if (strcmp(value, "fifo") == 0) {
+        return PresentMode::Fifo;
+    }
+
+    throw std::runtime_error(std::string("Unknown present mode ") + value + ", expected immediate, mailbox, fifo-relaxed or fifo!");
+}
+
+Settings parseCommandLine(const int argc, const char* const argv[]) {
+    Settings settings;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* argument = argv[i];
+
+        if (strcmp(argument, "--headless") == 0) {
+            settings.headless = true;
+        } else if (strcmp(argument, "--raster") == 0) {
+            settings.rayTracing = false;
+        } else if (strcmp(argument, "--width") == 0) {
+            settings.width = parseUnsigned(getArgumentValue(argc, argv, i));
+        } else if (strcmp(argument, "--height") == 0) {
+            settings.height = parseUnsigned(getArgumentValue(argc, argv, i));
+        } else if (strcmp(argument, "--frames") == 0) {
+            settings.frameCount = parseUnsigned(getArgumentValue(argc, argv, i));
+        } else if (strcmp(argument, "--camera-path") == 0) {
+            settings.cameraPathFile = getArgumentValue(argc, argv, i);
+        } else if (strcmp(argument, "--timings") == 0) {
+            settings.timingsFile = getArgumentValue(argc, argv, i);
+        } else if (strcmp(argument, "--mesh") == 0) {
+            settings.meshFile = getArgumentValue(argc, argv, i);
+        } else if (strcmp(argument, "--split-meshes") == 0) {
+            settings.splitMeshes = true;
+        } else if (strcmp(argument, "--quantize") == 0) {
+            settings.quantizeVertices = true;
+        } else if (strcmp(argument, "--trace") == 0) {
+            settings.traceFile = getArgumentValue(argc, argv, i);
+        } else if (strcmp(argument, "--compact") == 0) {
+            settings.compactAccelerationStructures = true;
+        } else if (strcmp(argument, "--frames-in-flight") == 0) {
+            settings.framesInFlight = parseUnsigned(getArgumentValue(argc, argv, i));
+        } else if (strcmp(argument, "--present-mode") == 0) {
+            settings.presentMode = parsePresentMode(getArgumentValue(argc, argv, i));
+        } else if (strcmp(argument, "--swapchain-images") == 0) {
+            settings.swapchainImageCount = parseUnsigned(getArgumentValue(argc, argv, i));
+        } else if (strcmp(argument, "--jit-input") == 0) {
+            settings.justInTimeInput = true;
+        } else if (strcmp(argument, "--reuse-command-buffers") == 0) {
+            settings.reuseCommandBuffers = true;
+        } else if (strcmp(argument, "--animate") == 0) {
+            settings.animateInstances = true;
+        } else if (strcmp(argument, "--bvh-report") == 0) {
+            settings.bvhReport = true;
+        } else if (strcmp(argument, "--cpu") == 0) {
+            settings.cpuRayTracing = true;
+        } else if (strcmp(argument, "--cpu-threads") == 0) {
+            settings.cpuThreadCount = parseUnsigned(getArgumentValue(argc, argv, i));
+        } else if (strcmp(argument, "--validate") == 0) {
+            settings.validate = true;
+        } else if (strcmp(argument, "--validate-poses") == 0) {
+            settings.validationPoseCount = parseUnsigned(getArgumentValue(argc, argv, i));
+        } else if (strcmp(argument, "--pixel-tolerance") == 0) {
+            settings.validationPixelTolerance = parseUnsigned(getArgumentValue(argc, argv, i));
+        } else if (strcmp(argument, "--max-mismatch") == 0) {
+            settings.validationMaxMismatch = parseFloat(getArgumentValue(argc, argv, i));
+        } else if (strcmp(argument, "--min-psnr") == 0) {
+            settings.validationMinPsnr = parseFloat(getArgumentValue(argc, argv, i));
+        } else {
+            throw std::runtime_error(std::string("Unknown command line argument ") + argument + "!");
+        }
+    }
+
+    if (settings.width == 0 || settings.height == 0) {
+        throw std::runtime_error("Render resolution must be non-zero!");
+    }
+
+    if (settings.framesInFlight < MIN_FRAMES_IN_FLIGHT || settings.framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+        throw std::runtime_error("Frames in flight must be between " + std::to_string(MIN_FRAMES_IN_FLIGHT) + " and " +
+                                 std::to_string(MAX_FRAMES_IN_FLIGHT) + "!");
+    }
+
+    if (settings.bvhReport && settings.meshFile.empty()) {
+        throw std::runtime_error("BVH report needs a mesh file!");
+    }
+
+    // Validation compares ray traced frames read back from offscreen images
+    if (settings.validate) {
+        if (!settings.rayTracing) {
+            throw std::runtime_error("Validation compares ray traced output and can't run with --raster!");
+        }
+
+        if (settings.validationPoseCount == 0) {
+            throw std::runtime_error("Validation needs at least one pose!");
+        }
+
+        settings.headless = true;
+    }
+
+    return settings;
+}
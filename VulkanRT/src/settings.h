@@ -0,0 +1,79 @@
+#pragma once
+
+#include "common.h"
+
+#include <string>
+
+#define MIN_FRAMES_IN_FLIGHT 1
+#define MAX_FRAMES_IN_FLIGHT 4
+
+// Immediate and FIFO relaxed tear, mailbox and FIFO don't. Mailbox and immediate never block on the display.
+enum class PresentMode { Immediate, Mailbox, FifoRelaxed, Fifo };
+
+struct Settings {
+    uint32_t width  = 1280;
+    uint32_t height = 720;
+
+    // Renders into offscreen images instead of a window and exits after frameCount frames
+    bool        headless   = false;
+    bool        rayTracing = true;
+    uint32_t    frameCount = 1000;
+    std::string cameraPathFile;
+    std::string timingsFile = "timings.csv";
+
+    // Binary mesh file, or OBJ or PLY file to import, to render instead of the built in cube
+    std::string meshFile;
+
+    // Splits imported meshes too large for 16 bit indices into chunks that fit them
+    bool splitMeshes = false;
+
+    // Uploads 16 bit positions and octahedral normals instead of float positions, and reports the error against the float source
+    bool quantizeVertices = false;
+
+    // Chrome trace JSON of CPU zones and GPU passes is written here on exit, profiling stays disabled without it
+    std::string traceFile;
+
+    // Compacts bottom level acceleration structures after they are built, trading load time for memory
+    bool compactAccelerationStructures = false;
+
+    // Frames recorded ahead of the GPU, fewer lower the input latency and more keep the GPU busier. Headless runs render into an
+    // offscreen image per frame in flight.
+    uint32_t framesInFlight = 2;
+
+    // Falls back to the closest supported mode, immediate to mailbox and every mode to FIFO, which is always supported
+    PresentMode presentMode = PresentMode::Immediate;
+
+    // Swapchain images to ask for, clamped to what the surface supports. Zero asks for one more than the surface needs.
+    uint32_t swapchainImageCount = 0;
+
+    // Sleeps before input is sampled for as long as finished frames have been waiting to be presented, so that the input is as recent as
+    // possible when it reaches the screen. It needs VK_KHR_present_wait to know when frames are presented.
+    bool justInTimeInput = false;
+
+    // Submits the command buffer of every render target again as it is instead of recording it every frame, the camera is read from a
+    // uniform buffer either way. Command buffers are only recorded again after the swapchain changed, the renderer was switched or the
+    // instances moved.
+    bool reuseCommandBuffers = false;
+
+    // Spins the ray traced instances every frame, which refits the top level acceleration structure each frame
+    bool animateInstances = false;
+
+    // Builds CPU BVHs for the mesh file and prints their quality and build throughput, then exits without touching the GPU
+    bool bvhReport = false;
+
+    // Ray traces the headless camera path on the CPU instead of the GPU and prints the throughput for every thread count it runs with.
+    // Without cpuThreadCount it runs with 1, 2, 4 and so on threads up to the core count.
+    bool     cpuRayTracing  = false;
+    uint32_t cpuThreadCount = 0;
+
+    // Renders poses spread over the headless camera path on the GPU and compares every one against the CPU ray tracer, then exits.
+    // Pixels with any channel further than validationPixelTolerance from the reference count as mismatched. A pose fails when more than
+    // validationMaxMismatch percent of its pixels are mismatched or its PSNR is below validationMinPsnr, failed poses are written out as images.
+    bool     validate                 = false;
+    uint32_t validationPoseCount      = 8;
+    uint32_t validationPixelTolerance = 2;
+    float    validationMaxMismatch    = 0.1f;
+    float    validationMinPsnr        = 40.0f;
+};
+
+Settings parseCommandLine(const int argc, const char* const argv[]);
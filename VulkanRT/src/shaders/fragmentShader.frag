@@ -2,18 +2,16 @@
 
 #extension GL_ARB_separate_shader_objects : require
 
-layout(location = 0) in vec3 worldPos;
+layout(location = 0) in vec3 vertexNormal;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    vec3 dFdxPos = dFdx(worldPos);
-    vec3 dFdyPos = dFdy(worldPos);
-
-    vec3 normal = normalize(cross(dFdxPos, dFdyPos));
+    // Interpolated normals are shorter than unit length between vertices
+    vec3 normal = normalize(vertexNormal);
 
     normal.y = -normal.y;
 
     vec3 color = (normal + 3) * 0.25 * abs(normal);
     outColor = vec4(color, 1.0);
-}
\ No newline at end of file
+}
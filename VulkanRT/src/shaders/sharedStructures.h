@@ -6,12 +6,26 @@
 #define GLM_FORCE_XYZW_ONLY
 #include "glm/fwd.hpp"
 #include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
 #pragma warning(pop)
 
 #define mat4 glm::mat4
+#define vec3 glm::vec3
+#define uint uint32_t
 #endif
 
-struct RasterPushData {
+// Where a mesh starts in the shared vertex and index buffers, its indices are relative to firstVertex.
+// Quantized positions are dequantized with position * positionScale + positionOffset, float meshes use an identity transform.
+struct MeshInfo {
+    uint firstVertex;
+    uint firstIndex;
+    uint indexCount;
+
+    vec3 positionScale;
+    vec3 positionOffset;
+};
+
+struct RasterCameraData {
     mat4 cameraTransformation;
 
     // Perspective parameters for reverse z
@@ -20,12 +34,21 @@ struct RasterPushData {
     float near;
 };
 
-struct RayTracingPushData {
+struct RayTracingCameraData {
     mat4 cameraTransformationInverse;
 
     float oneOverTanOfHalfFov;
 };
 
+// A uniform buffer per render target, rewritten by the host every frame, so recorded command buffers stay valid while the camera moves.
+// Read with scalar layout, the members are packed the same as on the CPU.
+struct CameraData {
+    RasterCameraData     raster;
+    RayTracingCameraData rayTracing;
+};
+
 #ifdef CPP_SHADER_STRUCTURE
 #undef mat4
+#undef vec3
+#undef uint
 #endif
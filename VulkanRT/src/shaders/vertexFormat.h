@@ -0,0 +1,69 @@
+// Vertex fetching shared by the raster and hit shaders. VERTEX_FORMAT_QUANTIZED selects 16 bit SNORM positions and octahedral normals,
+// INDEX_TYPE_UINT32 selects 32 bit indices. Requires GL_EXT_scalar_block_layout, GL_EXT_shader_16bit_storage and sharedStructures.h.
+
+layout(set = 0, binding = 0, scalar) readonly buffer Vertices {
+#ifdef VERTEX_FORMAT_QUANTIZED
+    uvec2 vertices[];
+#else
+    float vertices[];
+#endif
+};
+
+layout(set = 0, binding = 1) readonly buffer Indices {
+#ifdef INDEX_TYPE_UINT32
+    uint indices[];
+#else
+    uint16_t indices[];
+#endif
+};
+
+layout(set = 0, binding = 4, scalar) readonly buffer Meshes {
+    MeshInfo meshes[];
+};
+
+layout(set = 0, binding = 5, scalar) readonly buffer Normals {
+#ifdef VERTEX_FORMAT_QUANTIZED
+    uint normals[];
+#else
+    float normals[];
+#endif
+};
+
+// Returns the index of the vertex in the shared vertex buffer
+uint getIndex(MeshInfo mesh, uint index) {
+    return mesh.firstVertex + uint(indices[index]);
+}
+
+// Positions are returned in mesh space, quantized ones are dequantized with the mesh's transform
+vec3 getPosition(MeshInfo mesh, uint vertex) {
+#ifdef VERTEX_FORMAT_QUANTIZED
+    uvec2 packedPosition = vertices[vertex];
+    vec3 position = vec3(unpackSnorm2x16(packedPosition.x), unpackSnorm2x16(packedPosition.y).x);
+    return position * mesh.positionScale + mesh.positionOffset;
+#else
+    return vec3(vertices[vertex * 3], vertices[vertex * 3 + 1], vertices[vertex * 3 + 2]);
+#endif
+}
+
+#ifdef VERTEX_FORMAT_QUANTIZED
+// Unfolds the octahedron back onto the unit sphere, the inverse of encodeOctahedral in vertexQuantization.cpp
+vec3 decodeOctahedral(uint encoded) {
+    vec2 folded = unpackSnorm2x16(encoded);
+    vec3 normal = vec3(folded, 1.0 - abs(folded.x) - abs(folded.y));
+
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+
+    return normalize(normal);
+}
+#endif
+
+// Smooth normals precomputed at import, in mesh space
+vec3 getNormal(uint vertex) {
+#ifdef VERTEX_FORMAT_QUANTIZED
+    return decodeOctahedral(normals[vertex]);
+#else
+    return vec3(normals[vertex * 3], normals[vertex * 3 + 1], normals[vertex * 3 + 2]);
+#endif
+}
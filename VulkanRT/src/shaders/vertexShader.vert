@@ -6,35 +6,27 @@
 
 #include "sharedStructures.h"
 
-layout(set = 0, binding = 0, scalar) readonly buffer Vertices {
-    float vertices[];
-};
-
-layout(set = 0, binding = 1) readonly buffer Indices {
-    uint16_t indices[];
-};
+// Draws are issued with the mesh index as their first instance
+#include "vertexFormat.h"
 
-layout(location = 0) out vec3 worldPos;
+layout(location = 0) out vec3 normal;
 
-layout(push_constant) uniform PushConstants {
-	RasterPushData pd;
-} pc;
+layout(set = 0, binding = 6, scalar) uniform Camera {
+	CameraData camera;
+};
 
 void main() {
-    ivec3 indices = ivec3((int(indices[gl_VertexIndex]) * 3) + 0,
-                          (int(indices[gl_VertexIndex]) * 3) + 1,
-                          (int(indices[gl_VertexIndex]) * 3) + 2);
+    MeshInfo mesh = meshes[gl_InstanceIndex];
+    uint index = getIndex(mesh, gl_VertexIndex);
 
-    vec3 vertex = vec3(vertices[indices.x],
-                       vertices[indices.y],
-                       vertices[indices.z]);
+    vec3 vertex = getPosition(mesh, index);
 
-    worldPos = vertex;
+    normal = getNormal(index);
 
-    gl_Position = vec4(vertex, 1.0) * pc.pd.cameraTransformation;
+    gl_Position = vec4(vertex, 1.0) * camera.raster.cameraTransformation;
 
-    gl_Position.x *= pc.pd.oneOverTanOfHalfFov * pc.pd.oneOverAspectRatio;
-    gl_Position.y *= pc.pd.oneOverTanOfHalfFov;
+    gl_Position.x *= camera.raster.oneOverTanOfHalfFov * camera.raster.oneOverAspectRatio;
+    gl_Position.y *= camera.raster.oneOverTanOfHalfFov;
     gl_Position.w = -gl_Position.z; 
-    gl_Position.z = pc.pd.near;
+    gl_Position.z = camera.raster.near;
 }
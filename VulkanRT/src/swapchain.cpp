@@ -5,13 +5,26 @@
 #include "glfw3.h"
 #pragma warning(pop)
 
+#include <algorithm>
+#include <cstdio>
 #include <stdexcept>
 
-VkExtent2D Swapchain::update() {
-    for (VkImageView& imageView : m_swapchainImageViews) {
-        vkDestroyImageView(m_device, imageView, nullptr);
+static const char* getPresentModeName(const VkPresentModeKHR presentMode) {
+    switch (presentMode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "mailbox";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "FIFO relaxed";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "FIFO";
+    default:
+        return "unknown";
     }
+}
 
+VkExtent2D Swapchain::update() {
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
     VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physicalDevice, m_surface, &surfaceCapabilities));
 
@@ -20,12 +33,12 @@ VkExtent2D Swapchain::update() {
     m_swapchainCreateInfo.imageExtent  = m_surfaceExtent;
     m_swapchainCreateInfo.oldSwapchain = m_swapchain;
 
-    VkSwapchainKHR newSwapchain = VK_NULL_HANDLE;
-    VK_CHECK(vkCreateSwapchainKHR(m_device, &m_swapchainCreateInfo, nullptr, &newSwapchain));
-    vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
-
-    m_swapchain = newSwapchain;
+    VK_CHECK(vkCreateSwapchainKHR(m_device, &m_swapchainCreateInfo, nullptr, &m_swapchain));
 
+    // The image count can differ from the old swapchain's, the render targets are resized to it
+    VK_CHECK(vkGetSwapchainImagesKHR(m_device, m_swapchain, &m_swapchainImageCount, nullptr));
+    m_swapchainImages.resize(m_swapchainImageCount);
+    m_swapchainImageViews.resize(m_swapchainImageCount);
     VK_CHECK(vkGetSwapchainImagesKHR(m_device, m_swapchain, &m_swapchainImageCount, m_swapchainImages.data()));
 
     for (size_t i = 0; i < m_swapchainImageCount; ++i) {
@@ -37,8 +50,10 @@ VkExtent2D Swapchain::update() {
 }
 
 Swapchain::Swapchain(GLFWwindow* window, const VkSurfaceKHR& surface, const VkPhysicalDevice& physicalDevice, const VkDevice& device,
-                     const uint32_t& queueFamilyIndex, const VkSurfaceFormatKHR& surfaceFormat)
-    : m_window(window), m_surface(surface), m_physicalDevice(physicalDevice), m_device(device), m_surfaceFormat(surfaceFormat) {
+                     const uint32_t& queueFamilyIndex, const VkSurfaceFormatKHR& surfaceFormat, const VkPresentModeKHR& preferredPresentMode,
+                     const uint32_t& preferredImageCount)
+    : m_window(window), m_surface(surface), m_physicalDevice(physicalDevice), m_device(device), m_surfaceFormat(surfaceFormat),
+      m_preferredPresentMode(preferredPresentMode) {
 
     if (!surfaceFormatSupported()) {
         throw std::runtime_error("Requested surface format not supported!");
@@ -47,15 +62,19 @@ Swapchain::Swapchain(GLFWwindow* window, const VkSurfaceKHR& surface, const VkPh
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
     VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physicalDevice, m_surface, &surfaceCapabilities));
 
-    setSwapchainImageCount(surfaceCapabilities);
+    setSwapchainImageCount(surfaceCapabilities, preferredImageCount);
     setSurfaceExtent(surfaceCapabilities);
-    getPresentMode();
+    m_presentMode = pickPresentMode();
 
     createSwapchain(queueFamilyIndex);
 
+    // The implementation may create more images than asked for
+    VK_CHECK(vkGetSwapchainImagesKHR(m_device, m_swapchain, &m_swapchainImageCount, nullptr));
     m_swapchainImages = std::vector<VkImage>(m_swapchainImageCount);
     VK_CHECK(vkGetSwapchainImagesKHR(m_device, m_swapchain, &m_swapchainImageCount, m_swapchainImages.data()));
 
+    printf("Present mode: %s, %u swapchain images\n", getPresentModeName(m_presentMode), m_swapchainImageCount);
+
     createSwapchainImageViews();
 }
 
@@ -72,6 +91,7 @@ const VkSwapchainKHR&           Swapchain::get() const { return m_swapchain; }
 const std::vector<VkImage>&     Swapchain::getImages() const { return m_swapchainImages; }
 const std::vector<VkImageView>& Swapchain::getImageViews() const { return m_swapchainImageViews; }
 const uint32_t&                 Swapchain::getImageCounts() const { return m_swapchainImageCount; }
+const VkPresentModeKHR&         Swapchain::getPresentMode() const { return m_presentMode; }
 
 const bool Swapchain::surfaceFormatSupported() const {
     uint32_t surfaceFormatsCount;
@@ -89,14 +109,16 @@ const bool Swapchain::surfaceFormatSupported() const {
     return false;
 }
 
-void Swapchain::setSwapchainImageCount(const VkSurfaceCapabilitiesKHR& surfaceCapabilities) {
+// Fewer images queue fewer frames for the display, which lowers latency with FIFO, while mailbox needs a spare image to replace
+void Swapchain::setSwapchainImageCount(const VkSurfaceCapabilitiesKHR& surfaceCapabilities, const uint32_t& preferredImageCount) {
     if (surfaceCapabilities.maxImageCount < 2 && surfaceCapabilities.maxImageCount != 0) {
         throw std::runtime_error("Couldn't get enough swapchain images!");
     }
 
-    m_swapchainImageCount = surfaceCapabilities.minImageCount + 1;
-    if (surfaceCapabilities.maxImageCount > 0 && m_swapchainImageCount > surfaceCapabilities.maxImageCount) {
-        m_swapchainImageCount = surfaceCapabilities.minImageCount;
+    m_swapchainImageCount = preferredImageCount > 0 ? preferredImageCount : surfaceCapabilities.minImageCount + 1;
+    m_swapchainImageCount = std::max(m_swapchainImageCount, std::max(surfaceCapabilities.minImageCount, 2u));
+    if (surfaceCapabilities.maxImageCount > 0) {
+        m_swapchainImageCount = std::min(m_swapchainImageCount, surfaceCapabilities.maxImageCount);
     }
 }
 
@@ -111,19 +133,27 @@ void Swapchain::setSurfaceExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabili
     m_surfaceExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
 }
 
-const VkPresentModeKHR Swapchain::getPresentMode() const {
+// Immediate falls back to mailbox, the next lowest latency without blocking on the display, before FIFO. Mailbox and FIFO relaxed are
+// asked for to avoid tearing or stutter, so they only fall back to FIFO, which every surface supports.
+const VkPresentModeKHR Swapchain::pickPresentMode() const {
     uint32_t presentModesCount;
     VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(m_physicalDevice, m_surface, &presentModesCount, 0));
 
     std::vector<VkPresentModeKHR> presentModes(presentModesCount);
     VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(m_physicalDevice, m_surface, &presentModesCount, presentModes.data()));
 
-    bool immediatePresentModeSupported = false;
-    for (VkPresentModeKHR presentMode : presentModes) {
-        immediatePresentModeSupported = immediatePresentModeSupported || presentMode == VK_PRESENT_MODE_IMMEDIATE_KHR;
+    std::vector<VkPresentModeKHR> candidates = {m_preferredPresentMode};
+    if (m_preferredPresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+        candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+    }
+
+    for (VkPresentModeKHR candidate : candidates) {
+        if (std::find(presentModes.begin(), presentModes.end(), candidate) != presentModes.end()) {
+            return candidate;
+        }
     }
 
-    return immediatePresentModeSupported ? VK_PRESENT_MODE_IMMEDIATE_KHR : VK_PRESENT_MODE_FIFO_KHR;
+    return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 void Swapchain::createSwapchain(const uint32_t& queueFamilyIndex) {
@@ -132,7 +162,7 @@ void Swapchain::createSwapchain(const uint32_t& queueFamilyIndex) {
     m_swapchainCreateInfo.queueFamilyIndexCount = 1;
     m_swapchainCreateInfo.pQueueFamilyIndices   = &queueFamilyIndex;
     m_swapchainCreateInfo.preTransform          = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-    m_swapchainCreateInfo.presentMode           = getPresentMode();
+    m_swapchainCreateInfo.presentMode           = m_presentMode;
     m_swapchainCreateInfo.imageUsage            = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
     m_swapchainCreateInfo.imageFormat           = m_surfaceFormat.format;
     m_swapchainCreateInfo.imageColorSpace       = m_surfaceFormat.colorSpace;
@@ -13,10 +13,14 @@ struct GLFWwindow;
 
 class Swapchain {
   public:
+    // Creates a swapchain for the current surface extent from the old one, its image count may differ. The old swapchain and its image views
+    // are left alive for the frames still using them, they have to be retired before the update and destroyed once those frames have completed.
     VkExtent2D update();
 
+    // preferredImageCount of zero asks for one image more than the surface needs
     Swapchain(GLFWwindow* window, const VkSurfaceKHR& surface, const VkPhysicalDevice& physicalDevice, const VkDevice& device,
-              const uint32_t& queueFamilyIndex, const VkSurfaceFormatKHR& surfaceFormat);
+              const uint32_t& queueFamilyIndex, const VkSurfaceFormatKHR& surfaceFormat, const VkPresentModeKHR& preferredPresentMode,
+              const uint32_t& preferredImageCount);
 
     ~Swapchain();
 
@@ -26,6 +30,7 @@ class Swapchain {
     const std::vector<VkImage>&     getImages() const;
     const std::vector<VkImageView>& getImageViews() const;
     const uint32_t&                 getImageCounts() const;
+    const VkPresentModeKHR&         getPresentMode() const;
 
   private:
     GLFWwindow* m_window = nullptr;
@@ -38,6 +43,8 @@ class Swapchain {
     VkSwapchainCreateInfoKHR m_swapchainCreateInfo          = {VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR};
     VkImageViewCreateInfo    m_swapchainImageViewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
     const VkSurfaceFormatKHR m_surfaceFormat;
+    const VkPresentModeKHR   m_preferredPresentMode;
+    VkPresentModeKHR         m_presentMode = VK_PRESENT_MODE_FIFO_KHR;
     VkExtent2D               m_surfaceExtent;
 
     uint32_t m_swapchainImageCount = UINT32_MAX;
@@ -47,10 +54,10 @@ class Swapchain {
 
     const bool surfaceFormatSupported() const;
 
-    void setSwapchainImageCount(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
+    void setSwapchainImageCount(const VkSurfaceCapabilitiesKHR& surfaceCapabilities, const uint32_t& preferredImageCount);
     void setSurfaceExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
 
-    const VkPresentModeKHR getPresentMode() const;
+    const VkPresentModeKHR pickPresentMode() const;
 
     void createSwapchain(const uint32_t& queueFamilyIndex);
     void createSwapchainImageViews();
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "common.h"
+
+#include "jobSystem.h"
+
+#include <algorithm>
+#include <vector>
+
+// One task per thread of the job system, fewer when they would end up smaller than minimumTaskSize
+inline uint32_t getTaskCount(const JobSystem& jobSystem, const uint64_t size, const uint64_t minimumTaskSize) {
+    return static_cast<uint32_t>(std::clamp(size / minimumTaskSize, uint64_t(1), uint64_t(jobSystem.getThreadCount())));
+}
+
+template <typename Task> struct TaskJob {
+    void (*function)(Task&) = nullptr;
+    Task* task              = nullptr;
+};
+
+template <typename Task> void runTaskJob(void* data) {
+    TaskJob<Task>& job = *static_cast<TaskJob<Task>*>(data);
+    job.function(*job.task);
+}
+
+// Runs the first task on the calling thread and queues every other one on the job system. Waiting runs queued jobs as well,
+// so tasks can be run from within jobs and nested task loops share the threads instead of adding their own.
+template <typename Task> void runTasks(JobSystem& jobSystem, void (*function)(Task&), std::vector<Task>& tasks) {
+    std::vector<TaskJob<Task>> jobs(tasks.size());
+    JobCounter                 counter;
+
+    for (size_t i = 1; i < tasks.size(); ++i) {
+        jobs[i].function = function;
+        jobs[i].task     = &tasks[i];
+        jobSystem.run(runTaskJob<Task>, &jobs[i], counter);
+    }
+
+    if (!tasks.empty()) {
+        function(tasks[0]);
+    }
+
+    jobSystem.wait(counter);
+}
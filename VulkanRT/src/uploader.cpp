@@ -0,0 +1,252 @@
+#include "uploader.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define UPLOAD_RING_SIZE 33'554'432 // 32MB
+
+// Upper bound on the size of a single copy, so wrapping around the end of the ring never wastes more than half of it
+#define UPLOAD_CHUNK_SIZE (UPLOAD_RING_SIZE / 2)
+
+#define UPLOAD_BATCH_COUNT 4
+#define UPLOAD_ALIGNMENT 16
+
+Uploader::Uploader(const VkDevice& device, MemoryAllocator& memoryAllocator, const VkQueue& queue, const uint32_t& queueFamilyIndex)
+    : m_device(device), m_memoryAllocator(memoryAllocator), m_queue(queue), m_queueFamilyIndex(queueFamilyIndex) {
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    commandPoolCreateInfo.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolCreateInfo.queueFamilyIndex        = queueFamilyIndex;
+
+    VK_CHECK(vkCreateCommandPool(m_device, &commandPoolCreateInfo, nullptr, &m_commandPool));
+
+    m_batches.resize(UPLOAD_BATCH_COUNT);
+
+    std::vector<VkCommandBuffer> commandBuffers(UPLOAD_BATCH_COUNT);
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    commandBufferAllocateInfo.commandPool                 = m_commandPool;
+    commandBufferAllocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount          = UPLOAD_BATCH_COUNT;
+
+    VK_CHECK(vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, commandBuffers.data()));
+
+    for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; ++i) {
+        m_batches[i].commandBuffer = commandBuffers[i];
+        m_freeBatches.push_back(UPLOAD_BATCH_COUNT - 1 - i);
+    }
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    semaphoreTypeCreateInfo.semaphoreType             = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue              = 0;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    semaphoreCreateInfo.pNext                 = &semaphoreTypeCreateInfo;
+
+    VK_CHECK(vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_semaphore));
+
+    m_ringBuffer = createBuffer(m_device, m_memoryAllocator, UPLOAD_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Staging);
+}
+
+Uploader::~Uploader() {
+    wait();
+
+    vkDestroySemaphore(m_device, m_semaphore, nullptr);
+    vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+    destroyBuffer(m_device, m_memoryAllocator, m_ringBuffer);
+}
+
+void Uploader::upload(const void* data, const VkDeviceSize size, const VkBuffer dstBuffer, const VkDeviceSize dstOffset,
+                      const uint32_t dstQueueFamilyIndex) {
+    const uint8_t* source = reinterpret_cast<const uint8_t*>(data);
+
+    VkDeviceSize uploaded = 0;
+    while (uploaded < size) {
+        VkDeviceSize chunkSize  = std::min<VkDeviceSize>(size - uploaded, UPLOAD_CHUNK_SIZE);
+        VkDeviceSize ringOffset = reserve(chunkSize);
+
+        memcpy(reinterpret_cast<uint8_t*>(m_ringBuffer.allocation.mappedData) + ringOffset, source + uploaded, static_cast<size_t>(chunkSize));
+
+        VkBufferCopy bufferCopy = {};
+        bufferCopy.srcOffset    = ringOffset;
+        bufferCopy.dstOffset    = dstOffset + uploaded;
+        bufferCopy.size         = chunkSize;
+
+        vkCmdCopyBuffer(m_batches[getRecordingBatch()].commandBuffer, m_ringBuffer.buffer, dstBuffer, 1, &bufferCopy);
+
+        uploaded += chunkSize;
+    }
+
+    if (dstQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED && dstQueueFamilyIndex != m_queueFamilyIndex) {
+        VkBufferMemoryBarrier releaseBarrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        releaseBarrier.srcAccessMask         = VK_ACCESS_TRANSFER_WRITE_BIT;
+        releaseBarrier.dstAccessMask         = 0;
+        releaseBarrier.srcQueueFamilyIndex   = m_queueFamilyIndex;
+        releaseBarrier.dstQueueFamilyIndex   = dstQueueFamilyIndex;
+        releaseBarrier.buffer                = dstBuffer;
+        releaseBarrier.offset                = dstOffset;
+        releaseBarrier.size                  = size;
+
+        m_releaseBarriers.push_back(releaseBarrier);
+    }
+}
+
+void Uploader::flush() {
+    PROFILE_ZONE("Uploader::flush");
+
+    if (m_recordingBatch == UINT32_MAX) {
+        return;
+    }
+
+    Batch& batch = m_batches[m_recordingBatch];
+
+    // Barriers order against everything submitted later to the same queue, so consumers don't need to know about the uploader
+    VkMemoryBarrier memoryBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    memoryBarrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask   = VK_ACCESS_MEMORY_READ_BIT;
+
+    vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    if (!m_releaseBarriers.empty()) {
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                             static_cast<uint32_t>(m_releaseBarriers.size()), m_releaseBarriers.data(), 0, nullptr);
+
+        m_acquireBarriers.insert(m_acquireBarriers.end(), m_releaseBarriers.begin(), m_releaseBarriers.end());
+        m_releaseBarriers.clear();
+    }
+
+    VK_CHECK(vkEndCommandBuffer(batch.commandBuffer));
+
+    ++m_flushedValue;
+
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    timelineSemaphoreSubmitInfo.signalSemaphoreValueCount     = 1;
+    timelineSemaphoreSubmitInfo.pSignalSemaphoreValues        = &m_flushedValue;
+
+    VkSubmitInfo submitInfo         = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.pNext                = &timelineSemaphoreSubmitInfo;
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &batch.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores    = &m_semaphore;
+
+    VK_CHECK(vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+    batch.semaphoreValue = m_flushedValue;
+    batch.ringEnd        = m_head;
+    m_submittedBatches.push_back(m_recordingBatch);
+    m_recordingBatch = UINT32_MAX;
+}
+
+const bool Uploader::recordAcquireBarriers(const VkCommandBuffer commandBuffer, const uint32_t queueFamilyIndex, const VkPipelineStageFlags dstStageMask) {
+    std::vector<VkBufferMemoryBarrier> acquireBarriers;
+
+    std::vector<VkBufferMemoryBarrier>::iterator barrier = m_acquireBarriers.begin();
+    while (barrier != m_acquireBarriers.end()) {
+        if (barrier->dstQueueFamilyIndex != queueFamilyIndex) {
+            ++barrier;
+            continue;
+        }
+
+        // Access masks of the acquire have to cover the first use, not the copy
+        barrier->srcAccessMask = 0;
+        barrier->dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        acquireBarriers.push_back(*barrier);
+
+        barrier = m_acquireBarriers.erase(barrier);
+    }
+
+    if (acquireBarriers.empty()) {
+        return false;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, nullptr, static_cast<uint32_t>(acquireBarriers.size()),
+                         acquireBarriers.data(), 0, nullptr);
+
+    return true;
+}
+
+void Uploader::wait() {
+    PROFILE_ZONE("Uploader::wait");
+
+    flush();
+
+    while (reclaimOldestBatch()) {
+    }
+
+    m_tail = m_head;
+}
+
+const VkSemaphore Uploader::getSemaphore() const { return m_semaphore; }
+
+const uint64_t Uploader::getFlushedValue() const { return m_flushedValue; }
+
+const VkDeviceSize Uploader::reserve(const VkDeviceSize size) {
+    VkDeviceSize alignedHead = (m_head + UPLOAD_ALIGNMENT - 1) / UPLOAD_ALIGNMENT * UPLOAD_ALIGNMENT;
+
+    // A copy never straddles the end of the ring, skip the leftover space instead
+    if (alignedHead % UPLOAD_RING_SIZE + size > UPLOAD_RING_SIZE) {
+        alignedHead += UPLOAD_RING_SIZE - alignedHead % UPLOAD_RING_SIZE;
+    }
+
+    while (alignedHead + size - m_tail > UPLOAD_RING_SIZE) {
+        // The space is held by the batch being recorded, it has to be submitted before it can be waited on
+        if (m_submittedBatches.empty() && m_recordingBatch != UINT32_MAX) {
+            flush();
+        }
+
+        if (!reclaimOldestBatch()) {
+            // Nothing is in flight, so the whole ring is free
+            m_tail = alignedHead;
+        }
+    }
+
+    m_head = alignedHead + size;
+
+    return alignedHead % UPLOAD_RING_SIZE;
+}
+
+const bool Uploader::reclaimOldestBatch() {
+    if (m_submittedBatches.empty()) {
+        return false;
+    }
+
+    uint32_t batchIndex = m_submittedBatches.front();
+    m_submittedBatches.pop_front();
+
+    Batch& batch = m_batches[batchIndex];
+
+    VkSemaphoreWaitInfo semaphoreWaitInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    semaphoreWaitInfo.semaphoreCount      = 1;
+    semaphoreWaitInfo.pSemaphores         = &m_semaphore;
+    semaphoreWaitInfo.pValues             = &batch.semaphoreValue;
+
+    VK_CHECK(vkWaitSemaphores(m_device, &semaphoreWaitInfo, UINT64_MAX));
+
+    m_tail = batch.ringEnd;
+    m_freeBatches.push_back(batchIndex);
+
+    return true;
+}
+
+const uint32_t Uploader::getRecordingBatch() {
+    if (m_recordingBatch != UINT32_MAX) {
+        return m_recordingBatch;
+    }
+
+    if (m_freeBatches.empty()) {
+        reclaimOldestBatch();
+    }
+
+    m_recordingBatch = m_freeBatches.back();
+    m_freeBatches.pop_back();
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    commandBufferBeginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VK_CHECK(vkBeginCommandBuffer(m_batches[m_recordingBatch].commandBuffer, &commandBufferBeginInfo));
+
+    return m_recordingBatch;
+}
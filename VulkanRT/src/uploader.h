@@ -0,0 +1,84 @@
+#pragma once
+
+#include "common.h"
+
+#include "memoryAllocator.h"
+#include "resources.h"
+
+#pragma warning(push, 0)
+#define VK_ENABLE_BETA_EXTENSIONS
+#include "volk.h"
+#pragma warning(pop)
+
+#include <deque>
+#include <vector>
+
+// Streams data into device local buffers through a persistently mapped staging ring.
+// Copies are batched into one command buffer until flush() or until the ring runs out of space,
+// ring space is reclaimed by waiting on the timeline values of the oldest batches, never on the whole device.
+// Every submitted batch signals the next value of a timeline semaphore, which is also what work on other queues waits on.
+class Uploader {
+  public:
+    Uploader(const VkDevice& device, MemoryAllocator& memoryAllocator, const VkQueue& queue, const uint32_t& queueFamilyIndex);
+
+    ~Uploader();
+
+    // Uploads larger than half of the ring are split into several copies.
+    // Exclusive buffers used by another queue family need that family as dstQueueFamilyIndex, ownership is released to it on flush
+    // and has to be acquired with recordAcquireBarriers. Concurrent buffers leave it as VK_QUEUE_FAMILY_IGNORED.
+    void upload(const void* data, const VkDeviceSize size, const VkBuffer dstBuffer, const VkDeviceSize dstOffset = 0,
+                const uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+
+    template <typename T>
+    void upload(const std::vector<T>& data, const VkBuffer dstBuffer, const VkDeviceSize dstOffset = 0,
+                const uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED) {
+        upload(data.data(), sizeof(T) * data.size(), dstBuffer, dstOffset, dstQueueFamilyIndex);
+    }
+
+    // Submits the recorded copies, they are complete once the semaphore reaches getFlushedValue()
+    void flush();
+
+    // Records the acquire half of every ownership transfer released to queueFamilyIndex so far,
+    // the submission containing commandBuffer has to wait on the semaphore for getFlushedValue().
+    // Returns whether any were recorded, a command buffer acquiring ownership can't be submitted again.
+    const bool recordAcquireBarriers(const VkCommandBuffer commandBuffer, const uint32_t queueFamilyIndex, const VkPipelineStageFlags dstStageMask);
+
+    // Submits the recorded copies and blocks until all of them have completed
+    void wait();
+
+    const VkSemaphore getSemaphore() const;
+    const uint64_t    getFlushedValue() const;
+
+  private:
+    struct Batch {
+        VkCommandBuffer commandBuffer  = VK_NULL_HANDLE;
+        uint64_t        semaphoreValue = 0; // Signalled once the batch has completed
+        VkDeviceSize    ringEnd        = 0; // Ring head at submission, everything before it is free once the batch has completed
+    };
+
+    const VkDevice   m_device;
+    MemoryAllocator& m_memoryAllocator;
+    const VkQueue    m_queue;
+    const uint32_t   m_queueFamilyIndex;
+
+    VkCommandPool m_commandPool  = VK_NULL_HANDLE;
+    VkSemaphore   m_semaphore    = VK_NULL_HANDLE;
+    uint64_t      m_flushedValue = 0;
+    Buffer        m_ringBuffer   = {};
+
+    // Monotonically increasing byte positions, taken modulo the ring size when used as offsets
+    VkDeviceSize m_head = 0;
+    VkDeviceSize m_tail = 0;
+
+    std::vector<Batch>    m_batches;
+    std::deque<uint32_t>  m_submittedBatches; // Oldest first
+    std::vector<uint32_t> m_freeBatches;
+    uint32_t              m_recordingBatch = UINT32_MAX;
+
+    std::vector<VkBufferMemoryBarrier> m_releaseBarriers; // Recorded into the batch being recorded when it's flushed
+    std::vector<VkBufferMemoryBarrier> m_acquireBarriers; // Released, but not yet acquired by the destination family
+
+    const VkDeviceSize reserve(const VkDeviceSize size);
+    const bool         reclaimOldestBatch();
+    const uint32_t     getRecordingBatch();
+};
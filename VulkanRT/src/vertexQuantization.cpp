@@ -0,0 +1,125 @@
+#include "vertexQuantization.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#define SNORM16_MAX         32'767
+#define MIN_POSITION_SCALE  1e-6f // Keeps flat meshes from dividing by zero
+#define RADIANS_TO_DEGREES  57.29578f
+
+static int16_t encodeSnorm16(const float value) {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * SNORM16_MAX));
+}
+
+// Matches SNORM decoding on the GPU, both -32768 and -32767 map to -1
+static float decodeSnorm16(const int16_t value) { return std::max(static_cast<float>(value) / SNORM16_MAX, -1.0f); }
+
+static void normalize(float vector[3]) {
+    float length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+    if (length > 0.0f) {
+        vector[0] /= length;
+        vector[1] /= length;
+        vector[2] /= length;
+    } else {
+        vector[0] = 0.0f;
+        vector[1] = 0.0f;
+        vector[2] = 1.0f;
+    }
+}
+
+// Projects the unit sphere onto an octahedron and unfolds the lower half over the corners of the upper one
+static uint32_t encodeOctahedral(const float normal[3]) {
+    float sum = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+    float x   = normal[0] / sum;
+    float y   = normal[1] / sum;
+
+    if (normal[2] < 0.0f) {
+        float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x             = foldedX;
+        y             = foldedY;
+    }
+
+    return static_cast<uint16_t>(encodeSnorm16(x)) | static_cast<uint32_t>(static_cast<uint16_t>(encodeSnorm16(y))) << 16;
+}
+
+// Same as decodeOctahedral in vertexFormat.h
+static void decodeOctahedral(const uint32_t encoded, float normal[3]) {
+    normal[0] = decodeSnorm16(static_cast<int16_t>(encoded & 0xFFFF));
+    normal[1] = decodeSnorm16(static_cast<int16_t>(encoded >> 16));
+    normal[2] = 1.0f - std::abs(normal[0]) - std::abs(normal[1]);
+
+    float fold = std::max(-normal[2], 0.0f);
+    normal[0] += normal[0] >= 0.0f ? -fold : fold;
+    normal[1] += normal[1] >= 0.0f ? -fold : fold;
+
+    normalize(normal);
+}
+
+QuantizedMesh quantizeMesh(const MeshView& meshView, QuantizationError& error) {
+    PROFILE_ZONE("quantizeMesh");
+
+    const MeshFileEntry& entry    = *meshView.entry;
+    const float*         vertices = reinterpret_cast<const float*>(meshView.vertices);
+
+    QuantizedMesh quantizedMesh = {};
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        quantizedMesh.positionOffset[axis] = 0.5f * (entry.boundsMin[axis] + entry.boundsMax[axis]);
+        quantizedMesh.positionScale[axis]  = std::max(0.5f * (entry.boundsMax[axis] - entry.boundsMin[axis]), MIN_POSITION_SCALE);
+    }
+
+    quantizedMesh.positions.resize(4 * static_cast<size_t>(entry.vertexCount));
+    for (uint32_t vertex = 0; vertex < entry.vertexCount; ++vertex) {
+        float squaredError = 0.0f;
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            float   position = vertices[3 * vertex + axis];
+            int16_t encoded  = encodeSnorm16((position - quantizedMesh.positionOffset[axis]) / quantizedMesh.positionScale[axis]);
+
+            float decoded = decodeSnorm16(encoded) * quantizedMesh.positionScale[axis] + quantizedMesh.positionOffset[axis];
+            squaredError += (decoded - position) * (decoded - position);
+
+            quantizedMesh.positions[4 * vertex + axis] = encoded;
+        }
+
+        float positionError = std::sqrt(squaredError);
+        error.positionErrorSum += positionError;
+        error.maxPositionError = std::max(error.maxPositionError, positionError);
+    }
+
+    const float* normals = reinterpret_cast<const float*>(meshView.normals);
+
+    quantizedMesh.normals.resize(entry.vertexCount);
+    for (uint32_t vertex = 0; vertex < entry.vertexCount; ++vertex) {
+        const float* normal = &normals[3 * vertex];
+
+        quantizedMesh.normals[vertex] = encodeOctahedral(normal);
+
+        float decoded[3];
+        decodeOctahedral(quantizedMesh.normals[vertex], decoded);
+
+        float cosine      = std::clamp(normal[0] * decoded[0] + normal[1] * decoded[1] + normal[2] * decoded[2], -1.0f, 1.0f);
+        float normalError = std::acos(cosine) * RADIANS_TO_DEGREES;
+        error.normalErrorSum += normalError;
+        error.maxNormalError = std::max(error.maxNormalError, normalError);
+    }
+
+    error.vertexCount += entry.vertexCount;
+
+    return quantizedMesh;
+}
+
+void printQuantizationReport(const QuantizationError& error) {
+    if (error.vertexCount == 0) {
+        return;
+    }
+
+    const double megabytes = static_cast<double>(error.vertexCount) / (1024.0 * 1024.0);
+    printf("Quantized %llu vertices: positions %.2fMB instead of %.2fMB, normals %.2fMB instead of %.2fMB\n",
+           static_cast<unsigned long long>(error.vertexCount), megabytes * QUANTIZED_POSITION_STRIDE, megabytes * MESH_VERTEX_STRIDE,
+           megabytes * QUANTIZED_NORMAL_STRIDE, megabytes * MESH_NORMAL_STRIDE);
+    printf("    Position error: mean %g, max %g\n", error.positionErrorSum / static_cast<double>(error.vertexCount), error.maxPositionError);
+    printf("    Normal error:   mean %.4f deg, max %.4f deg\n", error.normalErrorSum / static_cast<double>(error.vertexCount), error.maxNormalError);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "common.h"
+
+#include "meshFile.h"
+
+#include <vector>
+
+// 16 bit SNORM positions relative to the mesh bounds. Four components, so the stream can feed R16G16B16A16_SNORM builds directly, w is unused.
+#define QUANTIZED_POSITION_STRIDE (4 * sizeof(int16_t))
+
+// Octahedral normals, two 16 bit SNORM components packed into a uint with x in the low half
+#define QUANTIZED_NORMAL_STRIDE sizeof(uint32_t)
+
+struct QuantizedMesh {
+    std::vector<int16_t>  positions;
+    std::vector<uint32_t> normals;
+    float                 positionScale[3]  = {}; // Dequantized position is position * scale + offset
+    float                 positionOffset[3] = {};
+};
+
+// Accumulated over every quantized mesh, position errors are in mesh units and normal errors in degrees
+struct QuantizationError {
+    double   positionErrorSum = 0.0;
+    float    maxPositionError = 0.0f;
+    double   normalErrorSum   = 0.0;
+    float    maxNormalError   = 0.0f;
+    uint64_t vertexCount      = 0;
+};
+
+// Both streams are decoded again to measure their error against the float positions and normals of the mesh
+QuantizedMesh quantizeMesh(const MeshView& meshView, QuantizationError& error);
+
+void printQuantizationReport(const QuantizationError& error);